@@ -0,0 +1,912 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+#include <basis/assert.h>
+
+namespace taco
+{
+    enum class channel_status
+    {
+        ok,
+        would_block,    ///< Full to send to, or empty to receive from
+        closed          ///< Closed to send to, or closed and empty to receive from
+    };
+
+    /// The case of a select that completed, ok is false if it did so because its channel was closed
+    struct select_result
+    {
+        size_t      index;
+        bool        ok;
+    };
+
+    namespace internal
+    {
+        struct channel_base;
+        struct channel_waiter;
+
+        /// A fiber waiting on a channel, one per channel it waits on
+        struct channel_wait_node
+        {
+            channel_base *          channel;
+            bool                    send;       ///< Waiting for room rather than a value
+            size_t                  index;
+            channel_waiter *        waiter;
+            channel_wait_node *     prev;
+            channel_wait_node *     next;
+            bool                    linked;
+        };
+
+        /// Suspends until one of the nodes' channels notifies it, or ready(context) is true once
+        /// they are all registered. Returns the index of the node that was notified, or count
+        size_t ChannelWait(channel_wait_node * nodes, size_t count, bool (*ready)(void *), void * context);
+
+        // Backs off while another thread finishes what it claimed a moment ago
+        inline void ChannelSnooze(uint32_t & step)
+        {
+            if (step++ < 6)
+            {
+                for (uint32_t i=0; i<(1u << step); i++)
+                {
+                    std::atomic_signal_fence(std::memory_order_seq_cst);
+                }
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        /// Waiting senders and receivers, only ever looked at when someone may have to wait
+        struct channel_base
+        {
+            std::mutex                  waitMutex;
+            channel_wait_node *         waiting[2] {};          ///< Receivers, senders
+            channel_wait_node *         waitingTail[2] {};
+            std::atomic<uint32_t>       waitCount[2] {};
+
+            channel_base() = default;
+            channel_base(const channel_base &) = delete;
+            channel_base & operator = (const channel_base &) = delete;
+
+            void notify_receivers(size_t count)
+            {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (waitCount[0].load(std::memory_order_relaxed))
+                {
+                    notify(false, count);
+                }
+            }
+
+            void notify_senders(size_t count)
+            {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (waitCount[1].load(std::memory_order_relaxed))
+                {
+                    notify(true, count);
+                }
+            }
+
+            /// Wakes up to count waiters on one side
+            void notify(bool senders, size_t count);
+        };
+
+        /// Fixed capacity MPMC ring (Vyukov's), each cell's sequence number says whose turn it is:
+        /// 2*pos when free for the send at pos, 2*pos+1 once it holds that value (doubled so a
+        /// capacity of 1 works). The tail's top bit marks it closed, so no send can slip in after close
+        template<class TYPE>
+        class channel_ring
+        {
+            static constexpr uint64_t closed_bit = uint64_t(1) << 63;
+
+            struct cell
+            {
+                std::atomic<uint64_t>   sequence;
+                alignas(TYPE) unsigned char bytes[sizeof(TYPE)];
+            };
+
+        public:
+            explicit channel_ring(size_t capacity)
+            :   m_cells(new cell[capacity]), m_capacity(capacity)
+            {
+                BASIS_ASSERT(capacity > 0);
+                for (size_t i=0; i<capacity; i++)
+                {
+                    m_cells[i].sequence.store(2 * i, std::memory_order_relaxed);
+                }
+            }
+
+            ~channel_ring()
+            {
+                uint64_t tail = m_tail.load(std::memory_order_relaxed) & ~closed_bit;
+                for (uint64_t i=m_head.load(std::memory_order_relaxed); i!=tail; i++)
+                {
+                    value(m_cells[i % m_capacity])->~TYPE();
+                }
+                delete [] m_cells;
+            }
+
+            template<class VALUE>
+            channel_status push(VALUE && v)
+            {
+                uint64_t pos = m_tail.load(std::memory_order_relaxed);
+                for (;;)
+                {
+                    if (pos & closed_bit)
+                    {
+                        return channel_status::closed;
+                    }
+
+                    cell & c = m_cells[pos % m_capacity];
+                    int64_t diff = int64_t(c.sequence.load(std::memory_order_acquire) - 2 * pos);
+                    if (diff == 0)
+                    {
+                        if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                            new (c.bytes) TYPE(std::forward<VALUE>(v));
+                            c.sequence.store(2 * pos + 1, std::memory_order_release);
+                            return channel_status::ok;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        // Still holding the value from a lap ago
+                        uint64_t now = m_tail.load(std::memory_order_relaxed);
+                        if (now == pos)
+                        {
+                            return channel_status::would_block;
+                        }
+                        pos = now;
+                    }
+                    else
+                    {
+                        pos = m_tail.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            channel_status pop(TYPE & out)
+            {
+                uint32_t step = 0;
+                uint64_t pos = m_head.load(std::memory_order_relaxed);
+                for (;;)
+                {
+                    cell & c = m_cells[pos % m_capacity];
+                    int64_t diff = int64_t(c.sequence.load(std::memory_order_acquire) - (2 * pos + 1));
+                    if (diff == 0)
+                    {
+                        if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                            TYPE * v = value(c);
+                            out = std::move(*v);
+                            v->~TYPE();
+                            c.sequence.store(2 * (pos + m_capacity), std::memory_order_release);
+                            return channel_status::ok;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        uint64_t tail = m_tail.load(std::memory_order_seq_cst);
+                        if ((tail & ~closed_bit) == pos)
+                        {
+                            return (tail & closed_bit) ? channel_status::closed : channel_status::would_block;
+                        }
+                        if ((tail & ~closed_bit) > pos)
+                        {
+                            // Claimed by a sender that hasn't finished writing it yet
+                            ChannelSnooze(step);
+                        }
+                        pos = m_head.load(std::memory_order_relaxed);
+                    }
+                    else
+                    {
+                        pos = m_head.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            bool close()
+            {
+                return !(m_tail.fetch_or(closed_bit, std::memory_order_seq_cst) & closed_bit);
+            }
+
+            bool readable() const
+            {
+                uint64_t tail = m_tail.load(std::memory_order_seq_cst);
+                return (tail & closed_bit) || (tail & ~closed_bit) != m_head.load(std::memory_order_seq_cst);
+            }
+
+            bool writable() const
+            {
+                uint64_t tail = m_tail.load(std::memory_order_seq_cst);
+                return (tail & closed_bit) || (tail & ~closed_bit) - m_head.load(std::memory_order_seq_cst) < m_capacity;
+            }
+
+            bool closed() const
+            {
+                return (m_tail.load(std::memory_order_acquire) & closed_bit) != 0;
+            }
+
+        private:
+            static TYPE * value(cell & c)
+            {
+                return std::launder((TYPE *) c.bytes);
+            }
+
+            cell *                              m_cells;
+            size_t                              m_capacity;
+            alignas(64) std::atomic<uint64_t>   m_head { 0 };
+            alignas(64) std::atomic<uint64_t>   m_tail { 0 };
+        };
+
+        /// Unbounded MPMC queue as a linked list of fixed size blocks, the same scheme as the
+        /// crossbeam list channel. Indices count up by 2 so bit 0 is free to mark: on the tail that
+        /// it is closed, on the head that it isn't in the same block as the tail. The last index of
+        /// each block is never used, whoever reaches it is installing the next block. A block is
+        /// freed by the last reader to finish with it
+        template<class TYPE>
+        class channel_list
+        {
+            static constexpr uint64_t lap = 32;
+            static constexpr uint64_t block_cap = lap - 1;
+            static constexpr uint64_t shift = 1;
+            static constexpr uint64_t mark_bit = 1;
+
+            enum : uint32_t
+            {
+                slot_write      = 1,
+                slot_read       = 2,
+                slot_destroy    = 4
+            };
+
+            struct slot
+            {
+                alignas(TYPE) unsigned char bytes[sizeof(TYPE)];
+                std::atomic<uint32_t>   state { 0 };
+            };
+
+            struct block
+            {
+                std::atomic<block *>    next { nullptr };
+                slot                    slots[block_cap];
+
+                block * wait_next()
+                {
+                    uint32_t step = 0;
+                    for (;;)
+                    {
+                        block * n = next.load(std::memory_order_acquire);
+                        if (n)
+                        {
+                            return n;
+                        }
+                        ChannelSnooze(step);
+                    }
+                }
+
+                // Frees b, unless a reader is still to finish with one of its slots from start on,
+                // then that reader does
+                static void destroy(block * b, uint64_t start)
+                {
+                    for (uint64_t i=start; i<block_cap-1; i++)
+                    {
+                        slot & s = b->slots[i];
+                        if (!(s.state.load(std::memory_order_acquire) & slot_read) &&
+                            !(s.state.fetch_or(slot_destroy, std::memory_order_acq_rel) & slot_read))
+                        {
+                            return;
+                        }
+                    }
+                    delete b;
+                }
+            };
+
+        public:
+            channel_list() = default;
+
+            ~channel_list()
+            {
+                uint64_t head = m_headIndex.load(std::memory_order_relaxed) & ~mark_bit;
+                uint64_t tail = m_tailIndex.load(std::memory_order_relaxed) & ~mark_bit;
+                block * b = m_headBlock.load(std::memory_order_relaxed);
+                for (; head != tail; head += uint64_t(1) << shift)
+                {
+                    uint64_t offset = (head >> shift) % lap;
+                    if (offset < block_cap)
+                    {
+                        value(b->slots[offset])->~TYPE();
+                    }
+                    else
+                    {
+                        block * next = b->next.load(std::memory_order_relaxed);
+                        delete b;
+                        b = next;
+                    }
+                }
+                delete b;
+            }
+
+            template<class VALUE>
+            channel_status push(VALUE && v)
+            {
+                uint32_t step = 0;
+                uint64_t tail = m_tailIndex.load(std::memory_order_acquire);
+                block * b = m_tailBlock.load(std::memory_order_acquire);
+                block * next = nullptr;
+
+                for (;;)
+                {
+                    if (tail & mark_bit)
+                    {
+                        delete next;
+                        return channel_status::closed;
+                    }
+
+                    uint64_t offset = (tail >> shift) % lap;
+                    if (offset == block_cap)
+                    {
+                        // Someone is installing the next block
+                        ChannelSnooze(step);
+                        tail = m_tailIndex.load(std::memory_order_acquire);
+                        b = m_tailBlock.load(std::memory_order_acquire);
+                        continue;
+                    }
+
+                    if (offset + 1 == block_cap && !next)
+                    {
+                        next = new block();
+                    }
+
+                    if (!b)
+                    {
+                        // The very first value
+                        block * first = new block();
+                        block * expected = nullptr;
+                        if (m_tailBlock.compare_exchange_strong(expected, first, std::memory_order_release))
+                        {
+                            m_headBlock.store(first, std::memory_order_release);
+                            b = first;
+                        }
+                        else
+                        {
+                            if (next)
+                            {
+                                delete first;
+                            }
+                            else
+                            {
+                                next = first;
+                            }
+                            tail = m_tailIndex.load(std::memory_order_acquire);
+                            b = m_tailBlock.load(std::memory_order_acquire);
+                            continue;
+                        }
+                    }
+
+                    uint64_t newTail = tail + (uint64_t(1) << shift);
+                    if (m_tailIndex.compare_exchange_weak(tail, newTail, std::memory_order_seq_cst, std::memory_order_acquire))
+                    {
+                        if (offset + 1 == block_cap)
+                        {
+                            m_tailBlock.store(next, std::memory_order_release);
+                            m_tailIndex.fetch_add(uint64_t(1) << shift, std::memory_order_release);
+                            b->next.store(next, std::memory_order_release);
+                            next = nullptr;
+                        }
+
+                        slot & s = b->slots[offset];
+                        new (s.bytes) TYPE(std::forward<VALUE>(v));
+                        s.state.fetch_or(slot_write, std::memory_order_release);
+                        delete next;
+                        return channel_status::ok;
+                    }
+                    b = m_tailBlock.load(std::memory_order_acquire);
+                }
+            }
+
+            channel_status pop(TYPE & out)
+            {
+                uint32_t step = 0;
+                uint64_t head = m_headIndex.load(std::memory_order_acquire);
+                block * b = m_headBlock.load(std::memory_order_acquire);
+
+                for (;;)
+                {
+                    uint64_t offset = (head >> shift) % lap;
+                    if (offset == block_cap)
+                    {
+                        // Someone is moving on to the next block
+                        ChannelSnooze(step);
+                        head = m_headIndex.load(std::memory_order_acquire);
+                        b = m_headBlock.load(std::memory_order_acquire);
+                        continue;
+                    }
+
+                    uint64_t newHead = head + (uint64_t(1) << shift);
+                    if (!(newHead & mark_bit))
+                    {
+                        std::atomic_thread_fence(std::memory_order_seq_cst);
+                        uint64_t tail = m_tailIndex.load(std::memory_order_relaxed);
+                        if ((head >> shift) == (tail >> shift))
+                        {
+                            return (tail & mark_bit) ? channel_status::closed : channel_status::would_block;
+                        }
+                        if ((head >> shift) / lap != (tail >> shift) / lap)
+                        {
+                            newHead |= mark_bit;
+                        }
+                    }
+
+                    if (!b)
+                    {
+                        // The first block is still being installed
+                        ChannelSnooze(step);
+                        head = m_headIndex.load(std::memory_order_acquire);
+                        b = m_headBlock.load(std::memory_order_acquire);
+                        continue;
+                    }
+
+                    if (m_headIndex.compare_exchange_weak(head, newHead, std::memory_order_seq_cst, std::memory_order_acquire))
+                    {
+                        if (offset + 1 == block_cap)
+                        {
+                            block * next = b->wait_next();
+                            uint64_t nextIndex = (newHead & ~mark_bit) + (uint64_t(1) << shift);
+                            if (next->next.load(std::memory_order_relaxed))
+                            {
+                                nextIndex |= mark_bit;
+                            }
+                            m_headBlock.store(next, std::memory_order_release);
+                            m_headIndex.store(nextIndex, std::memory_order_release);
+                        }
+
+                        slot & s = b->slots[offset];
+                        uint32_t wait = 0;
+                        while (!(s.state.load(std::memory_order_acquire) & slot_write))
+                        {
+                            ChannelSnooze(wait);
+                        }
+
+                        TYPE * v = value(s);
+                        out = std::move(*v);
+                        v->~TYPE();
+
+                        if (offset + 1 == block_cap)
+                        {
+                            block::destroy(b, 0);
+                        }
+                        else if (s.state.fetch_or(slot_read, std::memory_order_acq_rel) & slot_destroy)
+                        {
+                            block::destroy(b, offset + 1);
+                        }
+                        return channel_status::ok;
+                    }
+                    b = m_headBlock.load(std::memory_order_acquire);
+                }
+            }
+
+            bool close()
+            {
+                return !(m_tailIndex.fetch_or(mark_bit, std::memory_order_seq_cst) & mark_bit);
+            }
+
+            bool readable() const
+            {
+                uint64_t tail = m_tailIndex.load(std::memory_order_seq_cst);
+                return (tail & mark_bit) || (tail >> shift) != (m_headIndex.load(std::memory_order_seq_cst) >> shift);
+            }
+
+            bool writable() const
+            {
+                return true;
+            }
+
+            bool closed() const
+            {
+                return (m_tailIndex.load(std::memory_order_acquire) & mark_bit) != 0;
+            }
+
+        private:
+            static TYPE * value(slot & s)
+            {
+                return std::launder((TYPE *) s.bytes);
+            }
+
+            alignas(64) std::atomic<uint64_t>   m_headIndex { 0 };
+            std::atomic<block *>                m_headBlock { nullptr };
+            alignas(64) std::atomic<uint64_t>   m_tailIndex { 0 };
+            std::atomic<block *>                m_tailBlock { nullptr };
+        };
+    }
+
+    /// @brief Multi-producer, multi-consumer queue between tasks
+    /// Unbounded, or bounded to a fixed capacity. Sending and receiving are lock free as long as
+    /// neither side has to wait; a task only suspends when sending to a full channel or receiving
+    /// from an empty one, and is resumed by whoever makes room or sends. Closing a channel fails
+    /// any sends from then on and wakes everyone waiting, receivers still get what was left in it
+    template<class TYPE>
+    class channel
+    {
+    public:
+        /// Unbounded
+        channel()
+        :   m_ring(nullptr)
+        {}
+
+        /// Bounded, capacity must be at least 1
+        explicit channel(size_t capacity)
+        :   m_ring(new internal::channel_ring<TYPE>(capacity))
+        {}
+
+        ~channel()
+        {
+            delete m_ring;
+        }
+
+        channel(const channel &) = delete;
+        channel & operator = (const channel &) = delete;
+
+        /// Waits while the channel is full, returns false if it is closed
+        bool send(const TYPE & value)
+        {
+            return send_value(value);
+        }
+
+        bool send(TYPE && value)
+        {
+            return send_value(std::move(value));
+        }
+
+        /// Sends [first, last) in order, waiting for room as needed. Returns how many were sent,
+        /// fewer than all of them only if the channel was closed
+        template<class ITERATOR>
+        size_t send(ITERATOR first, ITERATOR last)
+        {
+            size_t sent = 0;
+            size_t pending = 0;
+            for (; first != last; ++first)
+            {
+                channel_status status = push(*first);
+                if (status == channel_status::would_block)
+                {
+                    // Let receivers at what we have so far before waiting on them
+                    m_base.notify_receivers(pending);
+                    pending = 0;
+                    status = wait_push(*first);
+                }
+                if (status != channel_status::ok)
+                {
+                    break;
+                }
+                sent++;
+                pending++;
+            }
+            if (pending)
+            {
+                m_base.notify_receivers(pending);
+            }
+            return sent;
+        }
+
+        channel_status try_send(const TYPE & value)
+        {
+            return try_send_value(value);
+        }
+
+        channel_status try_send(TYPE && value)
+        {
+            return try_send_value(std::move(value));
+        }
+
+        /// Waits while the channel is empty, returns false once it is closed and empty
+        bool receive(TYPE & dest)
+        {
+            channel_status status = pop(dest);
+            if (status == channel_status::would_block)
+            {
+                status = wait_pop(dest);
+            }
+            if (status == channel_status::ok)
+            {
+                notify_senders(1);
+                return true;
+            }
+            return false;
+        }
+
+        /// Waits for at least one value, then takes up to count of those ready without waiting
+        /// again. Returns how many, 0 once the channel is closed and empty
+        size_t receive(TYPE * dest, size_t count)
+        {
+            if (count == 0 || !receive(dest[0]))
+            {
+                return 0;
+            }
+
+            size_t received = 1;
+            while (received < count && pop(dest[received]) == channel_status::ok)
+            {
+                received++;
+            }
+            if (received > 1)
+            {
+                notify_senders(received - 1);
+            }
+            return received;
+        }
+
+        channel_status try_receive(TYPE & dest)
+        {
+            channel_status status = pop(dest);
+            if (status == channel_status::ok)
+            {
+                notify_senders(1);
+            }
+            return status;
+        }
+
+        /// Returns false if it was already closed
+        bool close()
+        {
+            bool closed = m_ring ? m_ring->close() : m_list.close();
+            if (closed)
+            {
+                m_base.notify_receivers(SIZE_MAX);
+                m_base.notify_senders(SIZE_MAX);
+            }
+            return closed;
+        }
+
+        bool closed() const
+        {
+            return m_ring ? m_ring->closed() : m_list.closed();
+        }
+
+        /// Whether a receive wouldn't wait (the channel has a value or is closed)
+        bool readable() const
+        {
+            return m_ring ? m_ring->readable() : m_list.readable();
+        }
+
+        /// Whether a send wouldn't wait (the channel has room or is closed)
+        bool writable() const
+        {
+            return m_ring ? m_ring->writable() : m_list.writable();
+        }
+
+        internal::channel_base & base()
+        {
+            return m_base;
+        }
+
+    private:
+        template<class VALUE>
+        channel_status push(VALUE && value)
+        {
+            return m_ring ? m_ring->push(std::forward<VALUE>(value)) : m_list.push(std::forward<VALUE>(value));
+        }
+
+        channel_status pop(TYPE & dest)
+        {
+            return m_ring ? m_ring->pop(dest) : m_list.pop(dest);
+        }
+
+        void notify_senders(size_t count)
+        {
+            // Nobody ever waits to send to an unbounded channel
+            if (m_ring)
+            {
+                m_base.notify_senders(count);
+            }
+        }
+
+        template<class VALUE>
+        channel_status try_send_value(VALUE && value)
+        {
+            channel_status status = push(std::forward<VALUE>(value));
+            if (status == channel_status::ok)
+            {
+                m_base.notify_receivers(1);
+            }
+            return status;
+        }
+
+        template<class VALUE>
+        bool send_value(VALUE && value)
+        {
+            channel_status status = push(std::forward<VALUE>(value));
+            if (status == channel_status::would_block)
+            {
+                status = wait_push(std::forward<VALUE>(value));
+            }
+            if (status == channel_status::ok)
+            {
+                m_base.notify_receivers(1);
+                return true;
+            }
+            return false;
+        }
+
+        template<class VALUE>
+        channel_status wait_push(VALUE && value)
+        {
+            for (;;)
+            {
+                internal::channel_wait_node node = { &m_base, true };
+                internal::ChannelWait(&node, 1, [](void * self) -> bool {
+                    return ((channel *) self)->writable();
+                }, this);
+
+                channel_status status = push(std::forward<VALUE>(value));
+                if (status != channel_status::would_block)
+                {
+                    return status;
+                }
+            }
+        }
+
+        channel_status wait_pop(TYPE & dest)
+        {
+            for (;;)
+            {
+                internal::channel_wait_node node = { &m_base, false };
+                internal::ChannelWait(&node, 1, [](void * self) -> bool {
+                    return ((channel *) self)->readable();
+                }, this);
+
+                channel_status status = pop(dest);
+                if (status != channel_status::would_block)
+                {
+                    return status;
+                }
+            }
+        }
+
+        internal::channel_base              m_base;
+        internal::channel_ring<TYPE> *      m_ring;
+        internal::channel_list<TYPE>        m_list;
+    };
+
+    /// select case receiving in to dest
+    template<class TYPE>
+    struct receive_case
+    {
+        channel<TYPE> &     ch;
+        TYPE &              dest;
+
+        static constexpr bool sending = false;
+
+        channel_status attempt()
+        {
+            return ch.try_receive(dest);
+        }
+
+        bool ready() const
+        {
+            return ch.readable();
+        }
+    };
+
+    /// select case sending value, which is only moved from if it is the one sent
+    template<class TYPE>
+    struct send_case
+    {
+        channel<TYPE> &     ch;
+        TYPE &              value;
+
+        static constexpr bool sending = true;
+
+        channel_status attempt()
+        {
+            return ch.try_send(std::move(value));
+        }
+
+        bool ready() const
+        {
+            return ch.writable();
+        }
+    };
+
+    template<class TYPE>
+    receive_case<TYPE> receive_from(channel<TYPE> & ch, TYPE & dest)
+    {
+        return receive_case<TYPE> { ch, dest };
+    }
+
+    template<class TYPE>
+    send_case<TYPE> send_to(channel<TYPE> & ch, TYPE & value)
+    {
+        return send_case<TYPE> { ch, value };
+    }
+
+    namespace internal
+    {
+        template<class TUPLE, size_t... INDICES>
+        bool SelectAttempt(TUPLE & cases, select_result & result, std::index_sequence<INDICES...>)
+        {
+            // In order, stopping at the first that completes
+            return ((result.index = INDICES, [&]() -> bool {
+                channel_status status = std::get<INDICES>(cases).attempt();
+                result.ok = status == channel_status::ok;
+                return status != channel_status::would_block;
+            }()) || ...);
+        }
+
+        template<class TUPLE, size_t... INDICES>
+        bool SelectReady(void * context, std::index_sequence<INDICES...>)
+        {
+            TUPLE & cases = *(TUPLE *) context;
+            return (std::get<INDICES>(cases).ready() || ...);
+        }
+
+        template<class TUPLE, size_t... INDICES>
+        void SelectNodes(TUPLE & cases, channel_wait_node * nodes, std::index_sequence<INDICES...>)
+        {
+            ((nodes[INDICES] = { &std::get<INDICES>(cases).ch.base(), std::tuple_element<INDICES, TUPLE>::type::sending, INDICES }), ...);
+        }
+    }
+
+    /// Waits until one of cases (receive_from, send_to) can complete and completes it, trying
+    /// them in order. A case whose channel is closed completes as well, without ok
+    template<class... CASES>
+    select_result select(CASES... cases)
+    {
+        typedef std::tuple<CASES...> tuple_type;
+        typedef std::index_sequence_for<CASES...> indices;
+        static constexpr size_t count = sizeof...(CASES);
+
+        tuple_type all(cases...);
+        internal::channel_wait_node nodes[count];
+        size_t woken = count;
+        select_result result = { count, false };
+
+        while (!internal::SelectAttempt(all, result, indices()))
+        {
+            internal::SelectNodes(all, nodes, indices());
+            woken = internal::ChannelWait(nodes, count, [](void * context) -> bool {
+                return internal::SelectReady<tuple_type>(context, indices());
+            }, &all);
+        }
+
+        if (woken < count && woken != result.index)
+        {
+            // Woken by a channel we didn't take from, so pass it on to the next in line
+            internal::channel_wait_node & node = nodes[woken];
+            if (node.send)
+            {
+                node.channel->notify_senders(1);
+            }
+            else
+            {
+                node.channel->notify_receivers(1);
+            }
+        }
+        return result;
+    }
+
+    /// Like select, but returns straight away with index SIZE_MAX if no case can complete
+    template<class... CASES>
+    select_result try_select(CASES... cases)
+    {
+        std::tuple<CASES...> all(cases...);
+        select_result result = { SIZE_MAX, false };
+        if (!internal::SelectAttempt(all, result, std::index_sequence_for<CASES...>()))
+        {
+            result = { SIZE_MAX, false };
+        }
+        return result;
+    }
+}
@@ -7,13 +7,16 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <deque>
 #include "mutex.h"
 
 namespace taco
 {
-    struct fiber;
+    struct fiber_waiter;
     class condition
     {
     public:
@@ -25,11 +28,28 @@ namespace taco
         {
             _wait([&]() -> void {
                 lock.unlock();
-            });
+            }, std::chrono::steady_clock::time_point::max());
 
             lock.lock();
         }
 
+        template<class LOCK_TYPE>
+        std::cv_status wait_until(LOCK_TYPE & lock, std::chrono::steady_clock::time_point time)
+        {
+            bool notified = _wait([&]() -> void {
+                lock.unlock();
+            }, time);
+
+            lock.lock();
+            return notified ? std::cv_status::no_timeout : std::cv_status::timeout;
+        }
+
+        template<class LOCK_TYPE, class REP, class PERIOD>
+        std::cv_status wait_for(LOCK_TYPE & lock, const std::chrono::duration<REP, PERIOD> & duration)
+        {
+            return wait_until(lock, std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+        }
+
         void notify_one();
         void notify_all();
 
@@ -37,9 +57,9 @@ namespace taco
         condition(const condition &);
         condition & operator = (const condition & );
 
-        void _wait(std::function<void()> on_suspend);
+        bool _wait(std::function<void()> on_suspend, std::chrono::steady_clock::time_point time);
 
-        std::deque<fiber *>        m_waiting;
+        std::deque<fiber_waiter *> m_waiting;
         mutex                      m_mutex;
     };
 }
@@ -7,12 +7,13 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 
 #pragma once
 
+#include <chrono>
 #include <deque>
 #include "mutex.h"
 
 namespace taco
 {
-    struct fiber;
+    struct fiber_waiter;
     class event
     {
     public:
@@ -20,6 +21,13 @@ namespace taco
         ~event();
         
         void wait();
+        /// Waits until the event is signaled or time is reached, returns false on timeout
+        bool wait_until(std::chrono::steady_clock::time_point time);
+        template<class REP, class PERIOD>
+        bool wait_for(const std::chrono::duration<REP, PERIOD> & duration)
+        {
+            return wait_until(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+        }
         void signal();
         void reset();
 
@@ -32,7 +40,7 @@ namespace taco
         event(const event &) = delete;
         event & operator = (const event & ) = delete;
 
-        std::deque<fiber *>        m_waiting;
+        std::deque<fiber_waiter *> m_waiting;
         mutex                      m_mutex;
         std::atomic<bool>          m_ready;
     };
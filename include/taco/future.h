@@ -7,51 +7,240 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
-#include <future>
-#include <taco/event.h>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <basis/assert.h>
+#include "taco_core.h"
 
 namespace taco
 {
     namespace internal
     {
+        /// Future states and continuations come from per thread pools of a few size classes,
+        /// anything bigger (or over aligned) from the heap
+        void *  AllocFutureBlock    (size_t size, size_t align);
+        void    FreeFutureBlock     (void * block, size_t size, size_t align);
+
+        /// Runs once a future is ready, on whichever thread made it so (or the one adding it if
+        /// it already was). Invoked with false it is just destroyed, when the future never is
+        struct continuation
+        {
+            continuation *  next;
+            void         (* fn)(continuation * self, bool invoke);
+        };
+
+        template<class F>
+        struct continuation_node : continuation
+        {
+            template<class G>
+            explicit continuation_node(G && f)
+            :   closure(std::forward<G>(f))
+            {
+                next = nullptr;
+                fn = &run;
+            }
+
+            static void run(continuation * self, bool invoke)
+            {
+                continuation_node * node = (continuation_node *) self;
+                if (invoke)
+                {
+                    node->closure();
+                }
+                node->~continuation_node();
+                FreeFutureBlock(node, sizeof(continuation_node), alignof(continuation_node));
+            }
+
+            F closure;
+        };
+
+        /// What a future<TYPE> and whoever completes it share, one allocation holding the
+        /// reference count, the state word and the value. The state word is the head of the
+        /// list of continuations (and waiting fibers) until the value is stored, then the ready
+        /// and value bits - so checking on a future never takes a lock
+        struct future_state
+        {
+            static constexpr uintptr_t ready_bit = 1;
+            static constexpr uintptr_t value_bit = 2;
+
+            std::atomic<uintptr_t>      state { 0 };
+            std::atomic<uint32_t>       refs { 1 };
+            /// The task that completes it while it may still be run inline, see RunFutureTask
+            std::atomic<void *>         task { nullptr };
+
+            future_state() = default;
+            future_state(const future_state &) = delete;
+            future_state & operator = (const future_state &) = delete;
+
+            ~future_state()
+            {
+                if (void * t = task.load(std::memory_order_relaxed))
+                {
+                    ReleaseFutureTask(t);
+                }
+
+                // Only if it was never completed (eg its task was dropped at Shutdown)
+                uintptr_t word = state.load(std::memory_order_relaxed);
+                continuation * list = (word & ready_bit) ? nullptr : (continuation *) word;
+                while (list)
+                {
+                    continuation * next = list->next;
+                    list->fn(list, false);
+                    list = next;
+                }
+            }
+
+            bool is_ready() const
+            {
+                return (state.load(std::memory_order_acquire) & ready_bit) != 0;
+            }
+
+            bool has_value() const
+            {
+                return (state.load(std::memory_order_acquire) & value_bit) != 0;
+            }
+
+            /// Invokes node once the value is ready, straight away if it already is
+            void add(continuation * node)
+            {
+                uintptr_t word = state.load(std::memory_order_acquire);
+                do
+                {
+                    if (word & ready_bit)
+                    {
+                        node->fn(node, true);
+                        return;
+                    }
+                    node->next = (continuation *) word;
+                } while (!state.compare_exchange_weak(word, uintptr_t(node), std::memory_order_acq_rel, std::memory_order_acquire));
+            }
+
+            /// Runs fn once the value is ready
+            template<class F>
+            void on_ready(F && fn)
+            {
+                typedef continuation_node<typename std::decay<F>::type> node_type;
+                void * block = AllocFutureBlock(sizeof(node_type), alignof(node_type));
+                add(new (block) node_type(std::forward<F>(fn)));
+            }
+
+            /// Called once the value has been stored
+            void complete()
+            {
+                uintptr_t word = state.exchange(ready_bit | value_bit, std::memory_order_acq_rel);
+                BASIS_ASSERT(!(word & ready_bit));
+
+                if (task.load(std::memory_order_relaxed))
+                {
+                    // Nothing left to run inline
+                    if (void * t = task.exchange(nullptr, std::memory_order_acq_rel))
+                    {
+                        ReleaseFutureTask(t);
+                    }
+                }
+
+                // Pushed on to the front, run in the order they were added
+                continuation * list = (continuation *) word;
+                continuation * ordered = nullptr;
+                while (list)
+                {
+                    continuation * next = list->next;
+                    list->next = ordered;
+                    ordered = list;
+                    list = next;
+                }
+                while (ordered)
+                {
+                    continuation * next = ordered->next;
+                    ordered->fn(ordered, true);
+                    ordered = next;
+                }
+            }
+        };
+
+        /// Suspends the current fiber until state is ready
+        void    WaitFuture          (future_state * state);
+
         template<class TYPE>
-        struct future_data
+        struct future_data : future_state
         {
-            event     ready;
-            TYPE      data;
+            alignas(TYPE) unsigned char storage[sizeof(TYPE)];
+
+            ~future_data()
+            {
+                if (has_value())
+                {
+                    get().~TYPE();
+                }
+            }
+
+            const TYPE & get() const
+            {
+                return *std::launder((const TYPE *) storage);
+            }
+
+            TYPE & get()
+            {
+                return *std::launder((TYPE *) storage);
+            }
 
             TYPE value() const
             {
-                return data;
+                return get();
+            }
+
+            template<class VALUE>
+            void set(VALUE && value)
+            {
+                new (storage) TYPE(std::forward<VALUE>(value));
+                complete();
             }
         };
 
         template<>
-        struct future_data<void>
+        struct future_data<void> : future_state
         {
-            event ready;
-
             void value() const
             {}
+
+            void set()
+            {
+                complete();
+            }
         };
 
-        template<class RTYPE>
-        struct future_executor
+        template<class TYPE>
+        future_data<TYPE> * NewFutureData()
         {
-            template<class F>
-            future_executor(future_data<RTYPE> * r, const F & fn)
+            void * block = AllocFutureBlock(sizeof(future_data<TYPE>), alignof(future_data<TYPE>));
+            return new (block) future_data<TYPE>();
+        }
+
+        template<class TYPE>
+        void ReleaseFutureData(future_data<TYPE> * data)
+        {
+            if (data->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
             {
-                r->data = std::move(fn());
-                r->ready.signal();
+                data->~future_data<TYPE>();
+                FreeFutureBlock(data, sizeof(future_data<TYPE>), alignof(future_data<TYPE>));
             }
+        }
 
-            template<class F, class... ARG_TYPES>
-            future_executor(future_data<RTYPE> * r, const F & fn, ARG_TYPES... parameters)
+        template<class RTYPE>
+        struct future_executor
+        {
+            template<class F>
+            future_executor(future_data<RTYPE> * r, F & fn)
             {
-                r->data = std::move(fn(parameters...));
-                r->ready.signal();        
+                r->set(fn());
             }
         };
 
@@ -59,34 +248,86 @@ namespace taco
         struct future_executor<void>
         {
             template<class F>
-            future_executor(future_data<void> * r, const F & fn)
+            future_executor(future_data<void> * r, F & fn)
             {
                 fn();
-                r->ready.signal();
+                r->set();
             }
+        };
 
-            template<class F, class... ARG_TYPES>
-            future_executor(future_data<void> * r, const F & fn, ARG_TYPES... parameters)
-            {
-                fn(parameters...);
-                r->ready.signal();
-            }
+        // fn's result when given what a future<TYPE> holds
+        template<class TYPE, class F>
+        struct continuation_result
+        {
+            typedef typename std::invoke_result<F &, TYPE>::type type;
+        };
+
+        template<class F>
+        struct continuation_result<void, F>
+        {
+            typedef typename std::invoke_result<F &>::type type;
         };
     };
 
     template<class TYPE>
     struct future
-    {    
+    {
+        future()
+        :   box(nullptr)
+        {}
+
+        /// Takes over the reference held by data
+        explicit future(internal::future_data<TYPE> * data)
+        :   box(data)
+        {}
+
+        future(const future & other)
+        :   box(other.box)
+        {
+            if (box)
+            {
+                box->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        future(future && other) noexcept
+        :   box(other.box)
+        {
+            other.box = nullptr;
+        }
+
+        ~future()
+        {
+            if (box)
+            {
+                internal::ReleaseFutureData(box);
+            }
+        }
+
+        future & operator = (future other) noexcept
+        {
+            std::swap(box, other.box);
+            return *this;
+        }
+
         TYPE await() const
         {
             BASIS_ASSERT(box);
-            box->ready.wait();
+            if (!box->is_ready())
+            {
+                // If nobody has started the task yet it runs right here, otherwise we wait for it
+                void * task = box->task.load(std::memory_order_relaxed) ? box->task.exchange(nullptr, std::memory_order_acq_rel) : nullptr;
+                if (!(task && internal::RunFutureTask(task)) || !box->is_ready())
+                {
+                    internal::WaitFuture(box);
+                }
+            }
             return box->value();
         }
 
         bool ready() const
         {
-            return box && box->ready;
+            return box && box->is_ready();
         }
 
         operator TYPE () const
@@ -94,20 +335,201 @@ namespace taco
             return await();
         }
 
-        std::shared_ptr<internal::future_data<TYPE>> box;
+        /// Schedules fn, given the value (or nothing for future<void>), as a task of its own once
+        /// the value is ready. Nothing waits in the meantime, so chains of continuations don't
+        /// hold on to a suspended task (and its stack) per step
+        template<class F>
+        auto then(F fn) const -> future<typename internal::continuation_result<TYPE, F>::type>
+        {
+            typedef typename internal::continuation_result<TYPE, F>::type rtype;
+            BASIS_ASSERT(box);
+
+            future<rtype> r(internal::NewFutureData<rtype>());
+            future<TYPE> source = *this;
+            box->on_ready([source, r, fn = std::move(fn)]() mutable -> void {
+                Schedule([source = std::move(source), r = std::move(r), fn = std::move(fn)]() mutable -> void {
+                    if constexpr (std::is_void_v<TYPE>)
+                    {
+                        internal::future_executor<rtype>(r.box, fn);
+                    }
+                    else
+                    {
+                        auto call = [&]() -> rtype {
+                            return fn(source.box->get());
+                        };
+                        internal::future_executor<rtype>(r.box, call);
+                    }
+                });
+            });
+            return r;
+        }
+
+        internal::future_data<TYPE> * box;
+    };
+
+    /// The futures given to when_any, and which of them became ready first
+    template<class SEQUENCE>
+    struct when_any_result
+    {
+        size_t      index;
+        SEQUENCE    futures;
     };
+
+    namespace internal
+    {
+        // Counts down the futures given to when_all that aren't ready yet
+        template<class SEQUENCE>
+        struct when_all_state
+        {
+            std::atomic<size_t>     remaining;
+            SEQUENCE                futures;
+            future<SEQUENCE>        result;
+        };
+
+        template<class SEQUENCE>
+        struct when_any_state
+        {
+            std::atomic<bool>                       done;
+            SEQUENCE                                futures;
+            future<when_any_result<SEQUENCE>>       result;
+        };
+
+        template<class SEQUENCE, class FOREACH>
+        future<SEQUENCE> when_all(SEQUENCE && futures, size_t count, FOREACH && foreach)
+        {
+            future<SEQUENCE> result(NewFutureData<SEQUENCE>());
+            if (count == 0)
+            {
+                result.box->set(std::move(futures));
+                return result;
+            }
+
+            // One extra count held while continuations are being added, so the futures can't be
+            // handed out while we still walk them
+            auto state = std::make_shared<when_all_state<SEQUENCE>>();
+            state->remaining = count + 1;
+            state->futures = std::move(futures);
+            state->result = result;
+            auto arrive = [state]() -> void {
+                if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    state->result.box->set(std::move(state->futures));
+                }
+            };
+            foreach(state->futures, [&](future_state * input) -> void {
+                input->on_ready(arrive);
+            });
+            arrive();
+            return result;
+        }
+
+        template<class SEQUENCE, class FOREACH>
+        future<when_any_result<SEQUENCE>> when_any(SEQUENCE && futures, size_t count, FOREACH && foreach)
+        {
+            future<when_any_result<SEQUENCE>> result(NewFutureData<when_any_result<SEQUENCE>>());
+            if (count == 0)
+            {
+                result.box->set(when_any_result<SEQUENCE>{ SIZE_MAX, std::move(futures) });
+                return result;
+            }
+
+            auto state = std::make_shared<when_any_state<SEQUENCE>>();
+            state->done = false;
+            state->futures = std::move(futures);
+            state->result = result;
+            size_t index = 0;
+            foreach(state->futures, [&](future_state * input) -> void {
+                input->on_ready([state, index]() -> void {
+                    if (!state->done.exchange(true, std::memory_order_acq_rel))
+                    {
+                        state->result.box->set(when_any_result<SEQUENCE>{ index, state->futures });
+                    }
+                });
+                index++;
+            });
+            return result;
+        }
+    }
+
+    /// Ready once every one of futures is, with the futures themselves (all ready) as its value
+    template<class TYPE>
+    future<std::vector<future<TYPE>>> when_all(std::vector<future<TYPE>> futures)
+    {
+        size_t count = futures.size();
+        return internal::when_all(std::move(futures), count, [](std::vector<future<TYPE>> & all, auto && fn) -> void {
+            for (future<TYPE> & f : all)
+            {
+                fn(f.box);
+            }
+        });
+    }
+
+    template<class... TYPES>
+    future<std::tuple<future<TYPES>...>> when_all(future<TYPES>... futures)
+    {
+        return internal::when_all(std::make_tuple(std::move(futures)...), sizeof...(TYPES), [](std::tuple<future<TYPES>...> & all, auto && fn) -> void {
+            std::apply([&](future<TYPES> &... f) -> void {
+                (fn(f.box), ...);
+            }, all);
+        });
+    }
+
+    /// Ready as soon as any one of futures is, with the futures and the index of that one as its
+    /// value (SIZE_MAX if there were none)
+    template<class TYPE>
+    future<when_any_result<std::vector<future<TYPE>>>> when_any(std::vector<future<TYPE>> futures)
+    {
+        size_t count = futures.size();
+        return internal::when_any(std::move(futures), count, [](std::vector<future<TYPE>> & all, auto && fn) -> void {
+            for (future<TYPE> & f : all)
+            {
+                fn(f.box);
+            }
+        });
+    }
+
+    template<class... TYPES>
+    future<when_any_result<std::tuple<future<TYPES>...>>> when_any(future<TYPES>... futures)
+    {
+        return internal::when_any(std::make_tuple(std::move(futures)...), sizeof...(TYPES), [](std::tuple<future<TYPES>...> & all, auto && fn) -> void {
+            std::apply([&](future<TYPES> &... f) -> void {
+                (fn(f.box), ...);
+            }, all);
+        });
+    }
     
+    namespace internal
+    {
+        template<class F>
+        auto StartFuture(task_name name, F fn, task_priority priority, task_deadline deadline, uint32_t threadid) -> future<decltype(fn())>
+        {
+            typedef decltype(fn()) rtype;
+            future<rtype> r(NewFutureData<rtype>());
+            ScheduleFutureClosure(name, [r, fn = std::move(fn)]() mutable -> void {
+                future_executor<rtype>(r.box, fn);
+            }, stack_size::standard, priority, deadline, threadid, &r.box->task);
+            return r;
+        }
+    }
+
+    /// Runs fn as a task, returning a future for its result. A task that hasn't started by the time
+    /// its future is awaited is run inline by whoever awaits it, unless it is bound to a thread
+    template<class F>
+    auto Start(task_name name, F fn, uint32_t threadid = constants::invalid_thread_id) -> future<decltype(fn())>
+    {
+        return internal::StartFuture(name, std::move(fn), task_priority::normal, task_deadline(), threadid);
+    }
+
+    template<class F>
+    auto Start(task_name name, F fn, task_priority priority, uint32_t threadid = constants::invalid_thread_id) -> future<decltype(fn())>
+    {
+        return internal::StartFuture(name, std::move(fn), priority, task_deadline(), threadid);
+    }
+
     template<class F>
-    auto Start(const char * name, F fn, uint32_t threadid = constants::invalid_thread_id) -> future<decltype(fn())>
+    auto Start(task_name name, F fn, task_deadline deadline, uint32_t threadid = constants::invalid_thread_id) -> future<decltype(fn())>
     {
-        typedef decltype(fn()) rtype;
-        future<rtype> r = { std::make_shared<internal::future_data<rtype>>() };
-
-        Schedule(name, [=]() -> void {
-            internal::future_executor<rtype>(r.box.get(), fn);
-        }, threadid);
-        
-        return r;
+        return internal::StartFuture(name, std::move(fn), task_priority::high, deadline, threadid);
     }
 
     template<class F>
@@ -115,4 +537,16 @@ namespace taco
     {
         return Start(nullptr, fn, threadid);
     }
+
+    template<class F>
+    auto Start(F fn, task_priority priority, uint32_t threadid = constants::invalid_thread_id) -> future<decltype(fn())>
+    {
+        return Start(nullptr, fn, priority, threadid);
+    }
+
+    template<class F>
+    auto Start(F fn, task_deadline deadline, uint32_t threadid = constants::invalid_thread_id) -> future<decltype(fn())>
+    {
+        return Start(nullptr, fn, deadline, threadid);
+    }
 }
@@ -7,48 +7,195 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
 #include <utility>
 #include <type_traits>
-#include <taco/event.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <basis/assert.h>
+#include "taco_core.h"
 
 namespace taco
 {
+    /// How many values a generator may produce ahead of its reader. With none (the default)
+    /// each YieldValue waits for the value to be read
+    struct generator_buffer
+    {
+        uint32_t    capacity;
+    };
+
     namespace internal
     {
+        /// A ring shared by one producing task and one reader, each side only ever waits on the
+        /// other when the ring is full (or, unbuffered, holding a value) or empty
+        struct generator_base
+        {
+            explicit generator_base(uint32_t capacity)
+            :   capacity(std::max<uint32_t>(capacity, 1)), lockstep(capacity == 0)
+            {}
+
+            generator_base(const generator_base &) = delete;
+            generator_base & operator = (const generator_base &) = delete;
+
+            std::atomic<uint64_t>   head { 0 };         ///< Next value to read, only the reader moves it
+            std::atomic<uint64_t>   tail { 0 };         ///< Next value to write, only the producer moves it
+            const uint32_t          capacity;
+            const bool              lockstep;
+            std::atomic<bool>       complete { false };
+            std::atomic<void *>     reader { nullptr }; ///< Fiber waiting for a value, if any
+            std::atomic<void *>     writer { nullptr }; ///< Fiber waiting for room, if any
+
+            bool readable() const
+            {
+                return tail.load(std::memory_order_seq_cst) != head.load(std::memory_order_relaxed) ||
+                    complete.load(std::memory_order_seq_cst);
+            }
+
+            // Unbuffered the producer waits for each value to be taken before going on
+            bool writable() const
+            {
+                uint64_t used = tail.load(std::memory_order_relaxed) - head.load(std::memory_order_seq_cst);
+                return lockstep ? used == 0 : used < capacity;
+            }
+
+            void wait_readable();
+            void wait_writable();
+
+            void wake_reader()
+            {
+                if (reader.load(std::memory_order_seq_cst))
+                {
+                    wake(reader);
+                }
+            }
+
+            void wake_writer()
+            {
+                if (writer.load(std::memory_order_seq_cst))
+                {
+                    wake(writer);
+                }
+            }
+
+            static void wake(std::atomic<void *> & waiter);
+        };
+
         template<class TYPE>
-        struct generator_state
+        struct generator_state : generator_base
         {
-            event         evtWrite;
-            event         evtRead;
-            TYPE          data;
-            bool          complete;
+            struct slot
+            {
+                alignas(TYPE) unsigned char bytes[sizeof(TYPE)];
+            };
+
+            explicit generator_state(uint32_t capacity)
+            :   generator_base(capacity), slots(new slot[this->capacity])
+            {}
+
+            ~generator_state()
+            {
+                for (uint64_t i=head.load(std::memory_order_relaxed); i!=tail.load(std::memory_order_relaxed); i++)
+                {
+                    at(i)->~TYPE();
+                }
+            }
+
+            TYPE * at(uint64_t index)
+            {
+                return std::launder((TYPE *) slots[index % capacity].bytes);
+            }
+
+            /// Constructs the next value straight in to the ring
+            template<class... ARG_TYPES>
+            void emplace(ARG_TYPES &&... args)
+            {
+                if (!writable())
+                {
+                    wait_writable();
+                }
+
+                uint64_t index = tail.load(std::memory_order_relaxed);
+                new (slots[index % capacity].bytes) TYPE(std::forward<ARG_TYPES>(args)...);
+                tail.store(index + 1, std::memory_order_seq_cst);
+                wake_reader();
+
+                if (lockstep)
+                {
+                    wait_writable();
+                }
+            }
+
+            /// Hands up to max values to fn where they sit, returns how many (0 once complete)
+            template<class F>
+            size_t consume(F && fn, size_t max)
+            {
+                if (!readable())
+                {
+                    wait_readable();
+                }
+
+                uint64_t first = head.load(std::memory_order_relaxed);
+                uint64_t count = std::min<uint64_t>(tail.load(std::memory_order_acquire) - first, max);
+                for (uint64_t i=first; i<first+count; i++)
+                {
+                    TYPE * value = at(i);
+                    fn(*value);
+                    value->~TYPE();
+                }
+
+                if (count > 0)
+                {
+                    head.store(first + count, std::memory_order_seq_cst);
+                    wake_writer();
+                }
+                return size_t(count);
+            }
+
+            std::unique_ptr<slot[]>     slots;
+            TYPE                        data;       ///< What the generator returned
         };
     };
 
     template<class TYPE>
     struct generator
     {
+        /// Reads the next value, or once there are no more the one the generator returned (and
+        /// returns false)
         bool read(TYPE & dest) const
         {
             BASIS_ASSERT(state);
-            if (state->complete)
+            if (state->consume([&](TYPE & value) -> void { dest = std::move(value); }, 1) == 0)
             {
                 dest = std::move(state->data);
                 return false;
             }
+            return true;
+        }
 
-            state->evtWrite.wait();
-            state->evtWrite.reset();
-
-            dest = std::move(state->data);
-            state->evtRead.signal();
+        /// Reads up to count values in to dest, waiting only if none are ready yet. Returns how
+        /// many were read, 0 once there are no more (the returned value is then left to read)
+        size_t read(TYPE * dest, size_t count) const
+        {
+            BASIS_ASSERT(state);
+            return state->consume([&](TYPE & value) -> void { *dest++ = std::move(value); }, count);
+        }
 
-            return true;
+        /// Like read, but calls fn with each value where it sits rather than moving it out
+        template<class F>
+        size_t consume(F fn, size_t max = SIZE_MAX) const
+        {
+            BASIS_ASSERT(state);
+            return state->consume(fn, max);
         }
 
+        /// Whether everything but the returned value has been read
         bool completed() const
         {
-            return state->complete;
+            return state->complete.load(std::memory_order_acquire) &&
+                state->head.load(std::memory_order_relaxed) == state->tail.load(std::memory_order_acquire);
         }
 
         operator TYPE () const
@@ -63,38 +210,54 @@ namespace taco
         std::shared_ptr<internal::generator_state<TYPE>> state;
     };
 
+    /// Passes data to the reader of the current generator, moved (or copied) straight in to
+    /// its buffer
     template<class TYPE>
     void YieldValue(TYPE && data)
     {
-        typedef typename std::remove_reference<TYPE>::type return_type;
+        typedef typename std::remove_cv<typename std::remove_reference<TYPE>::type>::type return_type;
 
         generator<return_type> * current = (generator<return_type> *)GetTaskLocalData();
+        current->state->emplace(std::forward<TYPE>(data));
+    }
 
-        current->state->data = std::forward<TYPE>(data);
-        current->state->evtWrite.signal();
-
-        current->state->evtRead.wait();
-        current->state->evtRead.reset();
+    /// Constructs the next value of the current generator in its buffer
+    template<class TYPE, class... ARG_TYPES>
+    void EmplaceValue(ARG_TYPES &&... args)
+    {
+        generator<TYPE> * current = (generator<TYPE> *)GetTaskLocalData();
+        current->state->emplace(std::forward<ARG_TYPES>(args)...);
     }
 
     template<class F>
-    auto StartGenerator(const char * name, F fn, uint32_t threadid = constants::invalid_thread_id) -> generator<decltype(fn())>
+    auto StartGenerator(task_name name, F fn, generator_buffer buffer, uint32_t threadid = constants::invalid_thread_id) -> generator<decltype(fn())>
     {
         typedef decltype(fn()) return_type;
 
-        generator<return_type> r = { std::make_shared<internal::generator_state<return_type>>() };
-        r.state->complete = false;
+        generator<return_type> r = { std::make_shared<internal::generator_state<return_type>>(buffer.capacity) };
 
         Schedule(name, [=]() mutable {
             SetTaskLocalData(&r);
             r.state->data = fn();
-            r.state->complete = true;
-            r.state->evtWrite.signal();
+            r.state->complete.store(true, std::memory_order_seq_cst);
+            r.state->wake_reader();
         }, threadid);
 
         return r;
     }
 
+    template<class F>
+    auto StartGenerator(task_name name, F fn, uint32_t threadid = constants::invalid_thread_id) -> generator<decltype(fn())>
+    {
+        return StartGenerator(name, fn, generator_buffer { 0 }, threadid);
+    }
+
+    template<class F>
+    auto StartGenerator(F fn, generator_buffer buffer, uint32_t threadid = constants::invalid_thread_id) -> generator<decltype(fn())>
+    {
+        return StartGenerator(nullptr, fn, buffer, threadid);
+    }
+
     template<class F>
     auto StartGenerator(F fn, uint32_t threadid = constants::invalid_thread_id) -> generator<decltype(fn())>
     {
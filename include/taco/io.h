@@ -0,0 +1,30 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <sys/types.h>
+
+namespace taco
+{
+    /// File I/O that suspends the calling task, rather than its thread, until the operation is done.
+    /// Each scheduler submits to its own io_uring and resumes the task once the completion comes
+    /// back; where that isn't available (or scheduler_options::async_io is off) the call is made
+    /// between BeginBlocking and EndBlocking instead. Called from outside of a scheduler (or inside
+    /// a blocking section) they are plain system calls.
+    ///
+    /// Arguments and results follow the posix calls of the same name: -1 with errno set on failure.
+    namespace io
+    {
+        int         open        (const char * path, int flags, mode_t mode = 0);
+        /// Reads at offset, or at (and advancing) the file position if offset is -1
+        ssize_t     read        (int fd, void * buffer, size_t size, off_t offset = -1);
+        /// Writes at offset, or at (and advancing) the file position if offset is -1
+        ssize_t     write       (int fd, const void * buffer, size_t size, off_t offset = -1);
+        int         fsync       (int fd);
+    }
+}
@@ -0,0 +1,39 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+namespace taco
+{
+    /// Socket calls that suspend the calling task, rather than its thread, while the socket isn't
+    /// ready. Sockets must be non-blocking; whenever a call would block the task waits on its
+    /// scheduler's reactor (epoll), which an idle scheduler sleeps on, and retries once the socket
+    /// is ready. Where there is no reactor the wait is done between BeginBlocking and EndBlocking
+    /// instead, and called from outside of a scheduler the thread just waits in poll.
+    ///
+    /// Closing a socket doesn't wake tasks waiting on it (epoll just forgets it), shut it down first.
+    ///
+    /// Arguments and results follow the posix calls of the same name: -1 with errno set on failure.
+    namespace net
+    {
+        /// The accepted socket is non-blocking and close-on-exec
+        int         accept          (int fd, sockaddr * address = nullptr, socklen_t * length = nullptr);
+        /// Returns once the connection is established or has failed
+        int         connect         (int fd, const sockaddr * address, socklen_t length);
+        ssize_t     recv            (int fd, void * buffer, size_t size, int flags = 0);
+        /// A peer that has gone away fails with EPIPE, rather than raising SIGPIPE
+        ssize_t     send            (int fd, const void * buffer, size_t size, int flags = 0);
+
+        /// Wait until fd is readable or writable (or has an error or hung up), returns 0 or -1
+        /// with errno set if fd can't be waited on
+        int         wait_readable   (int fd);
+        int         wait_writable   (int fd);
+    }
+}
@@ -0,0 +1,166 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <type_traits>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+#include "taco_core.h"
+#include "task_group.h"
+
+namespace taco
+{
+    namespace internal
+    {
+        /// Splits a range may still make before it is run as is. Ranges start out with enough to
+        /// give a few pieces to each scheduler that is idle, and just the one split (for anyone
+        /// about to be) if none are, halving as they go. Nothing is split ahead of being run - a
+        /// piece is only split once a task is running it. A piece that starts on a different
+        /// scheduler than the one that split it off was stolen, so someone ran out of work and it
+        /// is given more splits to share out
+        struct parallel_partition
+        {
+            /// Splits added to a stolen piece
+            static constexpr uint32_t steal_splits = 2;
+
+            uint32_t    splits;
+            uint32_t    owner;      ///< Scheduler that split it off
+
+            static parallel_partition initial()
+            {
+                uint32_t idle = IdleSchedulerCount();
+                uint32_t splits = 1;
+                if (GetThreadCount() == 1)
+                {
+                    splits = 0;
+                }
+                else if (idle > 0)
+                {
+                    // Around 4 pieces for each of them and us
+                    splits = 2;
+                    while ((1u << (splits - 2)) < idle + 1)
+                    {
+                        splits++;
+                    }
+                }
+                return { splits, GetSchedulerId() };
+            }
+
+            void start()
+            {
+                uint32_t id = GetSchedulerId();
+                if (id != owner)
+                {
+                    splits += steal_splits;
+                    owner = id;
+                }
+            }
+
+            bool split()
+            {
+                if (splits == 0)
+                {
+                    return false;
+                }
+                splits--;
+                return true;
+            }
+        };
+
+        template<class INDEX, class F>
+        void ParallelForRange(INDEX first, INDEX last, size_t grain, parallel_partition partition, task_group & group, F & fn)
+        {
+            partition.start();
+            while (size_t(last - first) > grain && partition.split())
+            {
+                // Hand off the top half, keep going with the bottom
+                INDEX mid = first + (last - first) / 2;
+                group.run([=, &group, &fn]() -> void {
+                    ParallelForRange(mid, last, grain, partition, group, fn);
+                });
+                last = mid;
+            }
+
+            if constexpr (std::is_invocable_v<F &, INDEX, INDEX>)
+            {
+                fn(first, last);
+            }
+            else
+            {
+                for (INDEX i=first; i!=last; ++i)
+                {
+                    fn(i);
+                }
+            }
+        }
+
+        template<class TYPE, class INDEX, class F, class COMBINE>
+        TYPE ParallelReduceRange(INDEX first, INDEX last, const TYPE & identity, size_t grain, parallel_partition partition, F & fn, COMBINE & combine)
+        {
+            partition.start();
+            if (size_t(last - first) > grain && partition.split())
+            {
+                // Each split waits on its top half, combining in order
+                INDEX mid = first + (last - first) / 2;
+                TYPE right = identity;
+                task_group group;
+                group.run([&]() -> void {
+                    right = ParallelReduceRange(mid, last, identity, grain, partition, fn, combine);
+                });
+                TYPE left = ParallelReduceRange(first, mid, identity, grain, partition, fn, combine);
+                group.wait();
+                return combine(std::move(left), std::move(right));
+            }
+            return fn(first, last, identity);
+        }
+    }
+
+    /// Calls fn for every index in [first, last) across the schedulers, returning once all have
+    /// completed. fn is called either with each index, or if it takes two with sub-ranges
+    /// [begin, end) of at most grain indices when they can be split no further. The range is
+    /// split lazily as it is run: pieces the calling scheduler doesn't have stolen from it are
+    /// run on it (inline if it can), see internal::parallel_partition
+    template<std::integral INDEX, class F>
+    void parallel_for(INDEX first, INDEX last, F && fn, size_t grain = 1)
+    {
+        if (first >= last)
+        {
+            return;
+        }
+
+        task_group group;
+        internal::ParallelForRange(first, last, std::max<size_t>(grain, 1), internal::parallel_partition::initial(), group, fn);
+        group.wait();
+    }
+
+    /// Reduces [first, last) in pieces: fn(begin, end, identity) returns the value of a piece,
+    /// and values of neighbouring pieces are combined with combine(left, right) in order, so
+    /// combine needs to be associative but not commutative. Split up the same way as parallel_for
+    template<class TYPE, std::integral INDEX, class F, class COMBINE>
+    TYPE parallel_reduce(INDEX first, INDEX last, const TYPE & identity, F && fn, COMBINE && combine, size_t grain = 1)
+    {
+        if (first >= last)
+        {
+            return identity;
+        }
+        return internal::ParallelReduceRange(first, last, identity, std::max<size_t>(grain, 1), internal::parallel_partition::initial(), fn, combine);
+    }
+
+    /// Runs each of fns, all but the first as tasks, and returns once they have completed
+    template<class F, class... REST>
+    void parallel_invoke(F && fn, REST &&... rest)
+    {
+        task_group group;
+        (group.run([&rest]() -> void { rest(); }), ...);
+        fn();
+        group.wait();
+    }
+}
@@ -26,7 +26,8 @@ namespace taco
             awake,
             log,
             enter_scope,
-            exit_scope
+            exit_scope,
+            deadline_miss       ///< A task completed after its deadline, emitted by the scheduler it completed on
         };
 
         struct event
@@ -15,4 +15,12 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 #include "event.h"
 #include "future.h"
 #include "generator.h"
+#include "channel.h"
+#include "task_group.h"
+#include "parallel.h"
 #include "auto_blocking.h"
+
+#if !defined(_WIN32)
+#include "io.h"
+#include "net.h"
+#endif
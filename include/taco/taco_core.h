@@ -7,9 +7,18 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <stdint.h>
 
+#include "task_name.h"
+
 namespace taco
 {
     typedef std::function<void()> task_fn;
@@ -18,30 +27,251 @@ namespace taco
         static constexpr uint32_t invalid_thread_id = 0xffffffff;
     }
 
+    /// Stack size class of the fiber a task runs on - a task is only ever
+    /// run on a fiber whose stack is at least as large as requested
+    enum class stack_size : uint8_t
+    {
+        standard,
+        large,
+        huge
+    };
+
+    /// Schedulers always look for work at a higher priority first. So that lower priorities still
+    /// make progress under a steady stream of higher priority work, a level that has been passed
+    /// over too many times in a row gets served first once. A fiber keeps the priority of the task
+    /// it was started for, including when it is resumed after waiting or switching out.
+    enum class task_priority : uint8_t
+    {
+        high,
+        normal,
+        low
+    };
+
+    static constexpr size_t task_priority_count = size_t(task_priority::low) + 1;
+
+    /// Time by which a task should have completed, a default constructed deadline means none
+    typedef std::chrono::steady_clock::time_point task_deadline;
+
+    /// What schedulers look at first when picking their next piece of work
+    enum class scheduling_mode : uint8_t
+    {
+        priority,   ///< Highest task_priority first, tasks with a deadline are scheduled as high priority
+        deadline    ///< Tasks with a deadline, and the fibers running them, ahead of everything else and earliest deadline first
+    };
+
+    /// How a scheduler that has run out of work waits for more. It re-polls its queues spin_count
+    /// times with a cpu_yield in between, then yield_count times giving up its time slice in between,
+    /// and only then goes to sleep until it is signaled. Spinning trades cpu time for not having to
+    /// be woken up when work arrives in bursts; the default is to go straight to sleep.
+    struct idle_policy
+    {
+        uint32_t    spin_count      = 0;
+        uint32_t    yield_count     = 0;
+    };
+
+    /// How schedulers are placed on cpus
+    enum class affinity_mode : uint8_t
+    {
+        none,       ///< Left to the OS, which is free to migrate them
+        compact,    ///< Pinned filling every hardware thread of a core, then every core sharing a cache and node, before moving on
+        scatter,    ///< Pinned spreading over as many cores, caches and nodes as possible before doubling up on any
+        list        ///< Scheduler i pinned to cpus[i % cpus.size()]
+    };
+
+    /// Scheduler 0 is the thread calling Initialize, it is pinned as well and has its original
+    /// affinity restored by Shutdown
+    struct affinity_policy
+    {
+        affinity_mode           mode = affinity_mode::none;
+        std::vector<uint32_t>   cpus;               ///< cpus to pin to in list mode
+        std::vector<uint32_t>   exclude;            ///< cpus never pinned to, eg ones reserved for interrupt handling
+        std::vector<uint32_t>   blocking_cpus;      ///< if not empty, threads running BeginBlocking sections are restricted to these
+    };
+
+    /// Threads that BeginBlocking sections run on. They are started as sections need them, up to
+    /// thread_limit at once (see SetBlockingThreadLimit), and sections beyond that wait in a queue
+    /// for the next thread to free up. A thread left without work for idle_timeout exits.
+    struct blocking_policy
+    {
+        uint32_t                    thread_limit    = 32;
+        std::chrono::milliseconds   idle_timeout    = std::chrono::seconds(10);    ///< milliseconds::max() to keep them until Shutdown
+    };
+
+    struct scheduler_options
+    {
+        int             thread_count    = -1;   ///< Number of schedulers, -1 for one per hardware thread
+        idle_policy     idle;
+        affinity_policy affinity;
+        blocking_policy blocking;
+        scheduling_mode mode            = scheduling_mode::priority;
+        bool            async_io        = true; ///< taco::io uses the OS's asynchronous I/O (io_uring) where available rather than blocking threads
+    };
+
     void                Initialize                  (int nthreads = -1);
-    void                Initialize                  (const char * name, task_fn comain, int nthreads = -1);
+    void                Initialize                  (const scheduler_options & options);
+    void                Initialize                  (task_name name, task_fn comain, int nthreads = -1);
+    void                Initialize                  (task_name name, task_fn comain, const scheduler_options & options);
     void                Shutdown                    ();
 
     void                EnterMain                   ();
     void                ExitMain                    ();
 
-    void                Schedule                    (const char * name, task_fn fn, uint32_t threadid = constants::invalid_thread_id);
+    void                Schedule                    (task_name name, task_fn fn, uint32_t threadid = constants::invalid_thread_id);
+    void                Schedule                    (task_name name, task_fn fn, stack_size stack, uint32_t threadid = constants::invalid_thread_id);
+
+    /// Schedules count stealable tasks in one go, generator(i) is called in order for i in [0, count)
+    /// to produce each task. Ids are reserved together, the tasks are published to the local queue
+    /// at once and only as many sleeping schedulers are woken as the batch can keep busy
+    void                ScheduleBatch               (task_name name, size_t count, const std::function<task_fn(size_t)> & generator, stack_size stack = stack_size::standard, task_priority priority = task_priority::normal);
 
     void                SetTaskLocalData            (void * data);
     void *              GetTaskLocalData            ();
     const char *        GetTaskName                 ();
+    task_priority       GetTaskPriority             ();
     void                Switch                      ();
+
+    /// Suspends the current task until time, without holding up its scheduler. Timers are kept
+    /// per scheduler with a resolution of TIMER_TICK_NS, so the task may wake up to that much
+    /// late (more if its scheduler is busy) but never early. Puts the whole thread to sleep
+    /// inside a blocking section
+    void                SleepUntil                  (std::chrono::steady_clock::time_point time);
     
     void                BeginBlocking               ();
     void                EndBlocking                 ();
+    /// Changes blocking_policy::thread_limit while running. Threads over a lowered limit exit
+    /// once they finish the section they are running
+    void                SetBlockingThreadLimit      (uint32_t limit);
 
     uint32_t            GetThreadCount              ();
     uint32_t            GetSchedulerId              ();
     uint64_t            GetTaskId                   ();
 
+    /// Work stealing counters, summed over all schedulers since Initialize
+    struct scheduler_stats
+    {
+        uint64_t    steal_attempts;     ///< Number of times a scheduler tried to steal from another
+        uint64_t    steal_successes;    ///< Attempts that came away with at least one item
+        uint64_t    tasks_stolen;
+        uint64_t    fibers_stolen;
+        uint64_t    deadline_tasks;     ///< Tasks with a deadline that have completed
+        uint64_t    deadline_misses;    ///< Of those, the ones that completed after their deadline
+    };
+
+    scheduler_stats     GetSchedulerStats           ();
+
+    /// Blocking section counters since Initialize
+    struct blocking_stats
+    {
+        uint64_t    sections;           ///< Number of completed BeginBlocking/EndBlocking sections
+        uint64_t    queued;             ///< Sections that found no idle thread and none could be started for them
+        uint64_t    handoff_ns;         ///< Total time from BeginBlocking to running on a blocking thread
+        uint64_t    max_handoff_ns;
+        uint64_t    blocked_ns;         ///< Total time from BeginBlocking to EndBlocking
+        uint64_t    max_blocked_ns;
+        uint64_t    threads_started;
+        uint64_t    threads_reaped;     ///< Threads that exited after idle_timeout, or to get under a lowered limit
+        uint32_t    threads;            ///< Blocking threads currently running
+    };
+
+    blocking_stats      GetBlockingStats            ();
+
+    /// Where threads were actually placed, which can differ from what was asked for if the OS
+    /// refused a cpu (eg it is outside the process's allowed set)
+    struct cpu_mapping
+    {
+        std::vector<int>        schedulers;     ///< cpu each scheduler is pinned to by scheduler id, -1 if not pinned
+        std::vector<uint32_t>   blocking;       ///< cpus blocking threads are restricted to, empty if unrestricted
+    };
+
+    cpu_mapping         GetCpuMapping               ();
+
+    namespace internal
+    {
+        /// Invokes (if requested) and then destroys a closure stored in a task
+        typedef void (*closure_fn)(void * closure, bool invoke);
+
+        /// Allocates a task with room for a closure of the given size and alignment, 
+        /// the closure must be constructed at the address stored in closure before
+        /// the task is passed to SubmitTask
+        void *  AllocTask       (size_t size, size_t align, void ** closure);
+        void    SubmitTask      (void * task, closure_fn fn, task_name name, stack_size stack, task_priority priority, task_deadline deadline, uint32_t threadid);
+
+        template<class CLOSURE>
+        void InvokeClosure(void * closure, bool invoke)
+        {
+            CLOSURE * c = (CLOSURE *) closure;
+            if (invoke)
+            {
+                (*c)();
+            }
+            c->~CLOSURE();
+        }
+
+        /// Moves the callable straight in to the task's storage - small closures live
+        /// inline in the task itself and neither ever go through std::function
+        template<class F>
+        void ScheduleClosure(task_name name, F && fn, stack_size stack, task_priority priority, task_deadline deadline, uint32_t threadid)
+        {
+            typedef typename std::decay<F>::type closure_type;
+
+            void * closure = nullptr;
+            void * task = AllocTask(sizeof(closure_type), alignof(closure_type), &closure);
+            new (closure) closure_type(std::forward<F>(fn));
+            SubmitTask(task, &InvokeClosure<closure_type>, name, stack, priority, deadline, threadid);
+        }
+
+        template<class F>
+        concept task_callable = std::is_invocable_v<typename std::decay<F>::type &>;
+
+        /// Submits a task belonging to a task_group, on to the current scheduler's shared queue
+        void    SubmitGroupTask (void * task, closure_fn fn, task_name name, task_priority priority, const void * group);
+        /// Takes the most recently scheduled task off of the current scheduler's queue at the given
+        /// priority and runs it inline, as long as it belongs to group. Returns false if there is
+        /// no such task, or the current task can't run one inline
+        bool    RunGroupTask    (task_priority priority, const void * group);
+
+        /// Number of schedulers parked for lack of work, stale as soon as it is returned
+        uint32_t IdleSchedulerCount();
+
+        /// Submits a task that may instead be run by whoever awaits its future. handle is set to
+        /// the task (holding a reference to it) unless it is bound to a thread
+        void    SubmitFutureTask(void * task, closure_fn fn, task_name name, stack_size stack, task_priority priority, task_deadline deadline, uint32_t threadid, std::atomic<void *> * handle);
+        /// Runs a task from SubmitFutureTask inline, unless it was already started or the current
+        /// task can't. Either way the reference to it is released
+        bool    RunFutureTask   (void * task);
+        void    ReleaseFutureTask(void * task);
+
+        template<class F>
+        void ScheduleFutureClosure(task_name name, F && fn, stack_size stack, task_priority priority, task_deadline deadline, uint32_t threadid, std::atomic<void *> * handle)
+        {
+            typedef typename std::decay<F>::type closure_type;
+
+            void * closure = nullptr;
+            void * task = AllocTask(sizeof(closure_type), alignof(closure_type), &closure);
+            new (closure) closure_type(std::forward<F>(fn));
+            SubmitFutureTask(task, &InvokeClosure<closure_type>, name, stack, priority, deadline, threadid, handle);
+        }
+
+        template<class F>
+        void ScheduleGroupClosure(task_name name, F && fn, task_priority priority, const void * group)
+        {
+            typedef typename std::decay<F>::type closure_type;
+
+            void * closure = nullptr;
+            void * task = AllocTask(sizeof(closure_type), alignof(closure_type), &closure);
+            new (closure) closure_type(std::forward<F>(fn));
+            SubmitGroupTask(task, &InvokeClosure<closure_type>, name, priority, group);
+        }
+    }
+
     inline void Initialize(task_fn comain, int nthreads = -1)
     {
-        Initialize("CoMain", comain, nthreads);
+        Initialize(task_name::literal("CoMain"), comain, nthreads);
+    }
+
+    inline void Initialize(task_fn comain, const scheduler_options & options)
+    {
+        Initialize(task_name::literal("CoMain"), comain, options);
     }
     
     inline void Schedule(task_fn fn, uint32_t threadid = constants::invalid_thread_id)
@@ -49,4 +279,81 @@ namespace taco
         Schedule(nullptr, fn, threadid);
     }
 
+    inline void Schedule(task_fn fn, stack_size stack, uint32_t threadid = constants::invalid_thread_id)
+    {
+        Schedule(nullptr, fn, stack, threadid);
+    }
+
+    template<internal::task_callable F>
+    void Schedule(task_name name, F && fn, uint32_t threadid = constants::invalid_thread_id)
+    {
+        internal::ScheduleClosure(name, std::forward<F>(fn), stack_size::standard, task_priority::normal, task_deadline(), threadid);
+    }
+
+    template<internal::task_callable F>
+    void Schedule(task_name name, F && fn, stack_size stack, uint32_t threadid = constants::invalid_thread_id)
+    {
+        internal::ScheduleClosure(name, std::forward<F>(fn), stack, task_priority::normal, task_deadline(), threadid);
+    }
+
+    template<internal::task_callable F>
+    void Schedule(task_name name, F && fn, task_priority priority, stack_size stack = stack_size::standard, uint32_t threadid = constants::invalid_thread_id)
+    {
+        internal::ScheduleClosure(name, std::forward<F>(fn), stack, priority, task_deadline(), threadid);
+    }
+
+    /// Schedules a task that should complete by deadline, see scheduling_mode. Completing late
+    /// counts as a miss in scheduler_stats whichever mode is in use
+    template<internal::task_callable F>
+    void Schedule(task_name name, F && fn, task_deadline deadline, uint32_t threadid = constants::invalid_thread_id)
+    {
+        internal::ScheduleClosure(name, std::forward<F>(fn), stack_size::standard, task_priority::high, deadline, threadid);
+    }
+
+    template<internal::task_callable F>
+    void Schedule(F && fn, uint32_t threadid = constants::invalid_thread_id)
+    {
+        internal::ScheduleClosure(nullptr, std::forward<F>(fn), stack_size::standard, task_priority::normal, task_deadline(), threadid);
+    }
+
+    template<internal::task_callable F>
+    void Schedule(F && fn, stack_size stack, uint32_t threadid = constants::invalid_thread_id)
+    {
+        internal::ScheduleClosure(nullptr, std::forward<F>(fn), stack, task_priority::normal, task_deadline(), threadid);
+    }
+
+    template<internal::task_callable F>
+    void Schedule(F && fn, task_priority priority, stack_size stack = stack_size::standard, uint32_t threadid = constants::invalid_thread_id)
+    {
+        internal::ScheduleClosure(nullptr, std::forward<F>(fn), stack, priority, task_deadline(), threadid);
+    }
+
+    template<internal::task_callable F>
+    void Schedule(F && fn, task_deadline deadline, uint32_t threadid = constants::invalid_thread_id)
+    {
+        internal::ScheduleClosure(nullptr, std::forward<F>(fn), stack_size::standard, task_priority::high, deadline, threadid);
+    }
+
+    /// Schedules every callable in [first, last) as a batch
+    template<class ITERATOR>
+    void ScheduleBatch(task_name name, ITERATOR first, ITERATOR last, stack_size stack = stack_size::standard, task_priority priority = task_priority::normal)
+    {
+        size_t count = (size_t) std::distance(first, last);
+        ScheduleBatch(name, count, [&](size_t) -> task_fn {
+            return *(first++);
+        }, stack, priority);
+    }
+
+    template<class ITERATOR>
+    void ScheduleBatch(ITERATOR first, ITERATOR last, stack_size stack = stack_size::standard, task_priority priority = task_priority::normal)
+    {
+        ScheduleBatch(nullptr, first, last, stack, priority);
+    }
+
+    template<class REP, class PERIOD>
+    void SleepFor(const std::chrono::duration<REP, PERIOD> & duration)
+    {
+        SleepUntil(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+    }
+
 }
@@ -0,0 +1,69 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include "taco_core.h"
+
+namespace taco
+{
+    struct fiber;
+
+    /// Fork-join over a set of child tasks, without a future (or event) per child. Children are
+    /// counted on one atomic and wait() returns once the count drops to zero. While waiting, the
+    /// children still sitting on top of the local queue are run inline on the waiting task, which
+    /// only suspends once the rest have been stolen by (and are still running on) other schedulers.
+    /// Children may run groups of their own, making for cheap recursive fork-join.
+    ///
+    /// Only one task may wait on a group at a time; the group can be reused once wait returns.
+    class task_group
+    {
+    public:
+        explicit task_group(task_priority priority = task_priority::normal)
+        :   m_state(0),
+            m_waiter(nullptr),
+            m_priority(priority)
+        {}
+
+        /// Waits for any children that are left
+        ~task_group()
+        {
+            wait();
+        }
+
+        template<internal::task_callable F>
+        void run(task_name name, F && fn)
+        {
+            m_state.fetch_add(1, std::memory_order_relaxed);
+            internal::ScheduleGroupClosure(name, [this, fn = std::forward<F>(fn)]() mutable -> void {
+                fn();
+                done();
+            }, m_priority, this);
+        }
+
+        template<internal::task_callable F>
+        void run(F && fn)
+        {
+            run(nullptr, std::forward<F>(fn));
+        }
+
+        void wait();
+
+    private:
+        task_group(const task_group &) = delete;
+        task_group & operator = (const task_group &) = delete;
+
+        void done();
+
+        // Children yet to complete, plus waiting_bit while a task is suspended in wait
+        std::atomic<uint64_t>   m_state;
+        fiber *                 m_waiter;
+        task_priority           m_priority;
+    };
+}
@@ -0,0 +1,102 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <stdint.h>
+
+namespace taco
+{
+    /// @brief Name attached to a task
+    /// A task_name is either absent, a string with static storage or an entry in the global name
+    /// table. In every case the string outlives the task, so names are copied around by pointer.
+    /// Only names made with literal (or the _task literal) skip the table - a char array can't be
+    /// told apart from a string literal, so any other string, arrays included, is interned on
+    /// construction. Interning a string the calling thread has recently interned is a lookup in
+    /// a small per-thread cache, with no locking, for names built per task TACO_TASK_NAME
+    /// avoids even that.
+    class task_name
+    {
+    public:
+        constexpr task_name()
+            :   m_str(nullptr), m_id(0)
+        {}
+
+        constexpr task_name(std::nullptr_t)
+            :   m_str(nullptr), m_id(0)
+        {}
+
+        /// Strings of unknown lifetime go through the name table
+        template<class STR>
+            requires std::is_convertible_v<STR, const char *>
+        task_name(STR && str)
+            :   task_name(Intern(str))
+        {}
+
+        /// Uses str as is, it must have static storage (eg a string literal)
+        static constexpr task_name literal(const char * str)
+        {
+            return task_name(str, 0);
+        }
+
+        /// Looks up (adding if needed) a string in the global name table. The returned name is
+        /// valid for the lifetime of the process and equal strings always share the same id.
+        /// Checks a per-thread cache of recently interned strings before taking the table lock.
+        /// Entries are never freed, so names should come from a bounded set - not per request
+        /// or per item ids. Once the table is full (TASK_NAME_TABLE_LIMIT in src/config.h) new
+        /// names come back empty, and their tasks go unnamed.
+        static task_name    Intern      (const char * str);
+
+        /// The string for an interned id, nullptr if the id is unknown
+        static const char * Lookup      (uint32_t id);
+
+        constexpr const char * c_str() const
+        {
+            return m_str ? m_str : "";
+        }
+
+        /// Id in the global name table, 0 if the name was not interned
+        constexpr uint32_t id() const
+        {
+            return m_id;
+        }
+
+        constexpr bool empty() const
+        {
+            return m_str == nullptr || m_str[0] == 0;
+        }
+
+    private:
+        constexpr task_name(const char * str, uint32_t id)
+            :   m_str(str), m_id(id)
+        {}
+
+        /// Intern without the per-thread cache
+        static task_name    InternShared(const char * str);
+
+        const char *    m_str;
+        uint32_t        m_id;
+    };
+
+    /// task_name for a string literal, interned the first time it is reached and reused from then
+    /// on. For names used on every task, eg Schedule(TACO_TASK_NAME("update"), fn)
+#define TACO_TASK_NAME(str) ([]() -> ::taco::task_name { \
+        static const ::taco::task_name name = ::taco::task_name::Intern("" str); \
+        return name; \
+    }())
+
+    inline namespace literals
+    {
+        /// "name"_task, a task_name for a string literal without going through the name table
+        constexpr task_name operator""_task(const char * str, size_t)
+        {
+            return task_name::literal(str);
+        }
+    }
+}
@@ -0,0 +1,114 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+#include <basis/assert.h>
+
+namespace taco
+{
+    /// @brief One bit per queue, set while that queue may have items in it
+    /// Stands in for a single shared item count. A bit is only written when its queue goes
+    /// from empty to non-empty or is found to be empty, pushes and pops in between only read
+    /// it, so the cache line stays shared rather than bouncing between every producer and
+    /// consumer. A bit may be left set for an empty queue until someone finds it empty, but is
+    /// never left clear while the queue holds items - as long as mark is called after items
+    /// are pushed and clear is given an accurate emptiness check.
+    class availability_mask
+    {
+        static constexpr uint32_t BITS = 64;
+
+        struct alignas(64) word
+        {
+            std::atomic<uint64_t>   bits { 0 };
+        };
+
+    public:
+        availability_mask(uint32_t count)
+            :   m_words(new word[(count + BITS - 1) / BITS]),
+                m_count(count)
+        {}
+
+        ~availability_mask()
+        {
+            delete [] m_words;
+        }
+
+        /// @brief Flags queue id as having items, call after the items have been pushed
+        void mark(uint32_t id)
+        {
+            BASIS_ASSERT(id < m_count);
+            std::atomic<uint64_t> & bits = m_words[id / BITS].bits;
+            uint64_t bit = uint64_t(1) << (id % BITS);
+
+            // Pairs with the fence in clear - either we see the bit cleared or they see our push
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if ((bits.load(std::memory_order_relaxed) & bit) == 0)
+            {
+                bits.fetch_or(bit, std::memory_order_relaxed);
+            }
+        }
+
+        /// @brief Clears the flag for queue id after it was found to be empty
+        /// @param is_empty re-checks the queue once the bit is clear, the bit is restored if
+        /// items were pushed in the meantime
+        template<class F>
+        void clear(uint32_t id, F && is_empty)
+        {
+            BASIS_ASSERT(id < m_count);
+            std::atomic<uint64_t> & bits = m_words[id / BITS].bits;
+            uint64_t bit = uint64_t(1) << (id % BITS);
+
+            if ((bits.load(std::memory_order_relaxed) & bit) == 0)
+            {
+                return;
+            }
+
+            bits.fetch_and(~bit, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!is_empty())
+            {
+                bits.fetch_or(bit, std::memory_order_relaxed);
+            }
+        }
+
+        bool test(uint32_t id) const
+        {
+            BASIS_ASSERT(id < m_count);
+            uint64_t bit = uint64_t(1) << (id % BITS);
+            return (m_words[id / BITS].bits.load(std::memory_order_relaxed) & bit) != 0;
+        }
+
+        /// @brief True if any queue may have items
+        bool any() const
+        {
+            for (uint32_t i=0; i<(m_count + BITS - 1) / BITS; i++)
+            {
+                if (m_words[i].bits.load(std::memory_order_relaxed) != 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        uint32_t size() const
+        {
+            return m_count;
+        }
+
+    private:
+        availability_mask(const availability_mask &) = delete;
+        availability_mask & operator = (const availability_mask &) = delete;
+
+        word *      m_words;
+        uint32_t    m_count;
+    };
+}
@@ -0,0 +1,132 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <mutex>
+#include <new>
+#include <stddef.h>
+
+#include "thread_state.h"
+
+namespace taco
+{
+    /// @brief Pool of fixed size memory blocks
+    /// Each thread keeps its own free list, blocks are returned to the list of whichever
+    /// thread frees them. Past CACHE_LIMIT half of a thread's list is handed over to a
+    /// shared list, which is also where a thread refills from before allocating more
+    /// blocks. Blocks are never returned to the system.
+    /// @tparam BLOCK_SIZE size in bytes of each block
+    /// @tparam CACHE_LIMIT number of free blocks a thread holds on to
+    template<size_t BLOCK_SIZE, size_t CACHE_LIMIT>
+    class block_pool
+    {
+        static_assert(CACHE_LIMIT >= 2);
+
+        struct node
+        {
+            node * next;
+        };
+
+        struct shared_list
+        {
+            std::mutex  mutex;
+            node *      head {};
+        };
+
+        struct cache
+        {
+            node *      head {};
+            size_t      count {};
+
+            ~cache()
+            {
+                Release(*this, count);
+            }
+        };
+
+    public:
+        static constexpr size_t block_size = BLOCK_SIZE < sizeof(node) ? sizeof(node) : BLOCK_SIZE;
+
+        static void * Alloc()
+        {
+            cache & c = thread_state<cache>();
+            if (!c.head)
+            {
+                Acquire(c, CACHE_LIMIT / 2);
+                if (!c.head)
+                {
+                    return ::operator new(block_size);
+                }
+            }
+
+            node * n = c.head;
+            c.head = n->next;
+            c.count--;
+            return n;
+        }
+
+        static void Free(void * block)
+        {
+            cache & c = thread_state<cache>();
+
+            node * n = (node *) block;
+            n->next = c.head;
+            c.head = n;
+            c.count++;
+
+            if (c.count > CACHE_LIMIT)
+            {
+                Release(c, c.count / 2);
+            }
+        }
+
+    private:
+        static shared_list & Shared()
+        {
+            static shared_list list;
+            return list;
+        }
+
+        static void Release(cache & c, size_t n)
+        {
+            if (n == 0)
+            {
+                return;
+            }
+
+            node * first = c.head;
+            node * last = first;
+            for (size_t i=1; i<n; i++)
+            {
+                last = last->next;
+            }
+            c.head = last->next;
+            c.count -= n;
+
+            shared_list & shared = Shared();
+            std::unique_lock<std::mutex> lock(shared.mutex);
+            last->next = shared.head;
+            shared.head = first;
+        }
+
+        static void Acquire(cache & c, size_t n)
+        {
+            shared_list & shared = Shared();
+            std::unique_lock<std::mutex> lock(shared.mutex);
+            while (n > 0 && shared.head)
+            {
+                node * first = shared.head;
+                shared.head = first->next;
+                first->next = c.head;
+                c.head = first;
+                c.count++;
+                n--;
+            }
+        }
+    };
+}
@@ -0,0 +1,141 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <iterator>
+#include <basis/assert.h>
+#include <taco/channel.h>
+#include "fiber.h"
+#include "scheduler_priv.h"
+#include "profiler_priv.h"
+
+namespace taco
+{
+    namespace internal
+    {
+        // Shared by the nodes of one wait, whoever sets selected first gets to resume it - but
+        // only once the waiter has finished registering, everything it registers with is on its
+        // stack. Both drop a reference on gate, the last one resumes it
+        struct channel_waiter
+        {
+            fiber *                 f;
+            std::atomic<size_t>     selected;
+            std::atomic<uint32_t>   gate;
+        };
+
+        static void Release(channel_waiter * waiter, uint32_t count)
+        {
+            fiber * f = waiter->f;
+            if (waiter->gate.fetch_sub(count, std::memory_order_acq_rel) == count)
+            {
+                Resume(f);
+            }
+        }
+
+        static void Link(channel_wait_node * node)
+        {
+            channel_base * c = node->channel;
+            size_t side = node->send ? 1 : 0;
+            std::lock_guard<std::mutex> lock(c->waitMutex);
+            node->prev = c->waitingTail[side];
+            node->next = nullptr;
+            if (node->prev)
+            {
+                node->prev->next = node;
+            }
+            else
+            {
+                c->waiting[side] = node;
+            }
+            c->waitingTail[side] = node;
+            node->linked = true;
+            c->waitCount[side].fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        // Expects the channel's waitMutex to be held
+        static void Unlink(channel_wait_node * node)
+        {
+            channel_base * c = node->channel;
+            size_t side = node->send ? 1 : 0;
+            (node->prev ? node->prev->next : c->waiting[side]) = node->next;
+            (node->next ? node->next->prev : c->waitingTail[side]) = node->prev;
+            node->linked = false;
+            c->waitCount[side].fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void channel_base::notify(bool senders, size_t count)
+        {
+            size_t side = senders ? 1 : 0;
+            channel_waiter * resume[16];
+            size_t claimed = 0;
+            {
+                // Whoever has already been selected by another channel is left for its owner
+                // to unlink
+                std::lock_guard<std::mutex> lock(waitMutex);
+                channel_wait_node * node = waiting[side];
+                while (node && count > 0 && claimed < std::size(resume))
+                {
+                    channel_wait_node * next = node->next;
+                    size_t expected = SIZE_MAX;
+                    if (node->waiter->selected.compare_exchange_strong(expected, node->index, std::memory_order_acq_rel))
+                    {
+                        Unlink(node);
+                        resume[claimed++] = node->waiter;
+                        count--;
+                    }
+                    node = next;
+                }
+            }
+
+            // Once resumed a waiter (and its nodes) may be gone
+            for (size_t i=0; i<claimed; i++)
+            {
+                Release(resume[i], 1);
+            }
+
+            if (claimed == std::size(resume) && count > 0)
+            {
+                notify(senders, count);
+            }
+        }
+
+        size_t ChannelWait(channel_wait_node * nodes, size_t count, bool (*ready)(void *), void * context)
+        {
+            BASIS_ASSERT(IsSchedulerThread());
+            TACO_PROFILER_LOG("channel::wait <%p>", nodes[0].channel);
+
+            channel_waiter waiter;
+            waiter.f = FiberCurrent();
+            waiter.selected.store(SIZE_MAX, std::memory_order_relaxed);
+            waiter.gate.store(2, std::memory_order_relaxed);
+            BASIS_ASSERT(waiter.f);
+
+            // Registered once we are suspended, then one last look - anything that happened
+            // before registering is seen by it, anything after sees us waiting
+            Suspend([&]() -> void {
+                for (size_t i=0; i<count; i++)
+                {
+                    nodes[i].waiter = &waiter;
+                    Link(&nodes[i]);
+                }
+
+                size_t expected = SIZE_MAX;
+                bool self = ready(context) && waiter.selected.compare_exchange_strong(expected, count, std::memory_order_acq_rel);
+                Release(&waiter, self ? 2 : 1);
+            });
+
+            for (size_t i=0; i<count; i++)
+            {
+                std::lock_guard<std::mutex> lock(nodes[i].channel->waitMutex);
+                if (nodes[i].linked)
+                {
+                    Unlink(&nodes[i]);
+                }
+            }
+            return waiter.selected.load(std::memory_order_acquire);
+        }
+    }
+}
@@ -5,6 +5,7 @@ http://divergentcoder.io
 This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
 */
 
+#include <algorithm>
 #include <mutex>
 #include <basis/assert.h>
 #include <taco/condition.h>
@@ -22,34 +23,59 @@ namespace taco
     {
         while (!m_waiting.empty())
         {
-            fiber * f = m_waiting.front();
-            FiberDestroy(f);
+            fiber_waiter * waiter = m_waiting.front();
+            if (waiter->timer.linked)
+            {
+                CancelTimer(&waiter->timer);
+            }
+            FiberDestroy(waiter->f);
             m_waiting.pop_front();
         }
     }
 
-    void condition::_wait(std::function<void()> on_suspend)
+    bool condition::_wait(std::function<void()> on_suspend, std::chrono::steady_clock::time_point time)
     {
         TACO_PROFILER_LOG("condition::wait <%p>", this);
 
         fiber * cur = FiberCurrent();
         BASIS_ASSERT(cur);
 
-        Suspend([&]() -> void {
+        fiber_waiter waiter(cur);
+        if (WaitOn(&waiter, time, [&]() -> void {
             std::unique_lock<mutex> lock(m_mutex);
-            m_waiting.push_back(cur);
+            m_waiting.push_back(&waiter);
             on_suspend();
-        });
+        }))
+        {
+            return true;
+        }
+
+        // Timed out, a notify may have already taken us out of the list (and lost the race)
+        std::unique_lock<mutex> lock(m_mutex);
+        auto it = std::find(m_waiting.begin(), m_waiting.end(), &waiter);
+        if (it != m_waiting.end())
+        {
+            m_waiting.erase(it);
+        }
+        return false;
     }
 
     void condition::notify_one()
     {
         TACO_PROFILER_LOG("condition::notify_one <%p>", this);
 
+        // Skip over waiters that have timed out but not taken themselves out yet
         std::unique_lock<mutex> lock(m_mutex);
-        fiber * f = m_waiting.front();
-        m_waiting.pop_front();
-        Resume(f);
+        while (!m_waiting.empty())
+        {
+            fiber_waiter * waiter = m_waiting.front();
+            m_waiting.pop_front();
+            if (ClaimWaiter(waiter))
+            {
+                Resume(waiter->f);
+                break;
+            }
+        }
     }
 
     void condition::notify_all()
@@ -59,9 +85,12 @@ namespace taco
         std::unique_lock<mutex> lock(m_mutex);
         while (!m_waiting.empty())
         {
-            fiber * f = m_waiting.front();
+            fiber_waiter * waiter = m_waiting.front();
             m_waiting.pop_front();
-            Resume(f);
+            if (ClaimWaiter(waiter))
+            {
+                Resume(waiter->f);
+            }
         }
     }
 }
@@ -13,8 +13,65 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 #define PRIVATE_FIBERQ_CHUNK_SIZE 512
 
 #define BLOCKING_FIBERQ_CHUNK_SIZE 128
-#define BLOCKING_THREAD_LIMIT 32
+
+// Most blocking sections waiting for a blocking thread at once, BeginBlocking yields until there
+// is room beyond that. Must be a power of 2
+#define BLOCKING_BACKLOG_LIMIT 4096
 
 #define MUTEX_SPIN_COUNT 50
 
-#define FIBER_STACK_SIZE 16384
\ No newline at end of file
+// Number of randomly chosen victims an idle scheduler tries before giving up (or,
+// for tasks, sweeping the remaining schedulers), and the most items taken per steal
+#define STEAL_ATTEMPT_LIMIT 4
+#define STEAL_BATCH_LIMIT 32
+
+// A priority level with work is served ahead of higher ones after being passed over this many times in a row
+#define PRIORITY_AGING_LIMIT 16
+
+// Size of each scheduler's io_uring submission queue, and so the most taco::io requests it
+// has in flight before the rest go to blocking threads
+#define IO_RING_ENTRIES 256
+
+// Most readiness events taken from the reactor at a time, and how many loop iterations a
+// scheduler with fibers waiting on sockets goes between checking on them while it has other work
+#define REACTOR_EVENT_BATCH 64
+#define REACTOR_POLL_INTERVAL 64
+
+// Resolution of SleepFor/SleepUntil and timed waits
+#define TIMER_TICK_NS 100000
+
+// Deepest tasks are nested running inline on a waiting task (task_group children, or unstarted
+// tasks a future is awaited on), past that it suspends instead. Bounds how much of a fiber's stack
+// recursive fork-join uses up
+#define TASK_INLINE_DEPTH 8
+
+// Alignment of each scheduler's data, at least the page size so it can be placed on its own node
+#define SCHEDULER_DATA_ALIGNMENT 4096
+
+// Closures up to TASK_INLINE_SIZE bytes are stored inside the task entry itself,
+// up to TASK_OVERFLOW_SIZE they come from a pool, anything bigger from the heap
+#define TASK_INLINE_SIZE 64
+#define TASK_OVERFLOW_SIZE 256
+#define TASK_POOL_CACHE_LIMIT 256
+
+// Future states and continuations are pooled in size classes of FUTURE_BLOCK_SIZE bytes and
+// up to 4 times that, anything bigger comes from the heap
+#define FUTURE_BLOCK_SIZE 64
+#define FUTURE_POOL_CACHE_LIMIT 256
+
+// Stack sizes for each taco::stack_size class, must be multiples of the page size
+#define FIBER_STACK_SIZE 16384
+#define FIBER_STACK_SIZE_LARGE 65536
+#define FIBER_STACK_SIZE_HUGE 262144
+
+// Number of stacks carved out of each mmap'd region, and the number of free
+// stacks per class a thread holds on to before returning them to the shared pool
+#define FIBER_STACK_REGION_COUNT 16
+#define FIBER_STACK_CACHE_LIMIT 32
+
+// Most distinct names the global task name table holds, they are never freed. Names interned
+// past that are dropped and their tasks left unnamed
+#define TASK_NAME_TABLE_LIMIT 65536
+
+// Entries in each thread's cache of recently interned names, power of 2
+#define TASK_NAME_CACHE_SIZE 64
@@ -0,0 +1,82 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+
+namespace taco
+{
+    /// @brief Min heap of items ordered by deadline, any thread may push or pop
+    /// The earliest deadline is published on every change so other threads can compare heaps,
+    /// to find the most urgent work, without taking their locks.
+    template<class TYPE>
+    class deadline_heap
+    {
+    public:
+        static constexpr int64_t none = INT64_MAX;
+
+        deadline_heap()
+            :   m_earliest(none)
+        {}
+
+        void push(int64_t deadline, const TYPE & item)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_items.push_back({ deadline, item });
+            std::push_heap(m_items.begin(), m_items.end(), &later);
+            m_earliest.store(m_items.front().deadline, std::memory_order_relaxed);
+        }
+
+        /// @brief Pops the item with the earliest deadline
+        bool pop(TYPE & out)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_items.empty())
+            {
+                return false;
+            }
+
+            std::pop_heap(m_items.begin(), m_items.end(), &later);
+            out = m_items.back().item;
+            m_items.pop_back();
+            m_earliest.store(m_items.empty() ? none : m_items.front().deadline, std::memory_order_relaxed);
+            return true;
+        }
+
+        /// @brief Earliest deadline in the heap, none if it is empty
+        int64_t earliest() const
+        {
+            return m_earliest.load(std::memory_order_relaxed);
+        }
+
+        bool empty() const
+        {
+            return earliest() == none;
+        }
+
+    private:
+        struct entry
+        {
+            int64_t     deadline;
+            TYPE        item;
+        };
+
+        static bool later(const entry & a, const entry & b)
+        {
+            return a.deadline > b.deadline;
+        }
+
+        std::mutex              m_mutex;
+        std::vector<entry>      m_items;
+        std::atomic<int64_t>    m_earliest;
+    };
+}
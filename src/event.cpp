@@ -5,6 +5,7 @@ http://divergentcoder.io
 This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
 */
 
+#include <algorithm>
 #include <mutex>
 #include <basis/assert.h>
 #include <taco/event.h>
@@ -22,13 +23,22 @@ namespace taco
     {
         while (!m_waiting.empty())
         {
-            fiber * f = m_waiting.front();
-            FiberDestroy(f);
+            fiber_waiter * waiter = m_waiting.front();
+            if (waiter->timer.linked)
+            {
+                CancelTimer(&waiter->timer);
+            }
+            FiberDestroy(waiter->f);
             m_waiting.pop_front();
         }
     }
 
     void event::wait()
+    {
+        wait_until(std::chrono::steady_clock::time_point::max());
+    }
+
+    bool event::wait_until(std::chrono::steady_clock::time_point time)
     {
         BASIS_ASSERT(IsSchedulerThread());
         TACO_PROFILER_LOG("event::wait <%p>", this);
@@ -38,20 +48,33 @@ namespace taco
 
         if (m_ready.load(std::memory_order_relaxed))
         {
-            return;
+            return true;
         }
 
         m_mutex.lock();
         if (m_ready.load(std::memory_order_relaxed))
         {
             m_mutex.unlock();
-            return;
+            return true;
         }
 
-        Suspend([&]() -> void {
-            m_waiting.push_back(cur);
+        fiber_waiter waiter(cur);
+        if (WaitOn(&waiter, time, [&]() -> void {
+            m_waiting.push_back(&waiter);
             m_mutex.unlock();
-        });
+        }))
+        {
+            return true;
+        }
+
+        // Timed out, signal may have already taken us out of the list (and lost the race)
+        std::unique_lock<mutex> lock(m_mutex);
+        auto it = std::find(m_waiting.begin(), m_waiting.end(), &waiter);
+        if (it != m_waiting.end())
+        {
+            m_waiting.erase(it);
+        }
+        return false;
     }
 
     void event::signal()
@@ -59,15 +82,29 @@ namespace taco
         BASIS_ASSERT(IsSchedulerThread());
         TACO_PROFILER_LOG("event::signal <%p>", this);
         
+        // Waiters are claimed under the lock, so a timed out one can't leave while we look at
+        // it, but resumed after it, a resumed waiter may well destroy the event
+        fiber_waiter * claimed = nullptr;
+        fiber_waiter ** tail = &claimed;
         m_mutex.lock();
         m_ready = true;
-        m_mutex.unlock();
-        
         while (!m_waiting.empty())
         {
-            auto f = m_waiting.front();
-            Resume(f);
+            fiber_waiter * waiter = m_waiting.front();
             m_waiting.pop_front();
+            if (ClaimWaiter(waiter))
+            {
+                *tail = waiter;
+                tail = &waiter->next;
+            }
+        }
+        m_mutex.unlock();
+
+        while (claimed)
+        {
+            fiber_waiter * waiter = claimed;
+            claimed = claimed->next;
+            Resume(waiter->f);
         }
     }
 
@@ -0,0 +1,80 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+#include "futex.h"
+
+namespace taco
+{
+    /// @brief Eventcount for threads waiting on a condition that is checked without a lock
+    /// A waiter calls prepare_wait, checks its condition one last time and then either cancel_wait's
+    /// or wait's with the key it was given. Notifiers make the condition true and then notify; a
+    /// notification after prepare_wait makes the wait return straight away, so none can be lost in
+    /// between. When nobody is waiting notifying costs a fence and a load.
+    class event_count
+    {
+    public:
+        /// @return key to pass to wait
+        uint32_t prepare_wait()
+        {
+            m_waiters.fetch_add(1, std::memory_order_seq_cst);
+            return m_epoch.load(std::memory_order_seq_cst);
+        }
+
+        void cancel_wait()
+        {
+            m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        /// @brief Sleeps until notified since prepare_wait, or timeout (in nanoseconds, negative
+        /// for none) has passed
+        /// @return false if it timed out
+        bool wait(uint32_t key, int64_t timeout = -1)
+        {
+            FutexWait(&m_epoch, key, timeout);
+            m_waiters.fetch_sub(1, std::memory_order_relaxed);
+            // A spurious wakeup looks like a timeout, callers recheck their condition either way
+            return m_epoch.load(std::memory_order_acquire) != key;
+        }
+
+        void notify_one()
+        {
+            if (bump())
+            {
+                FutexWakeOne(&m_epoch);
+            }
+        }
+
+        void notify_all()
+        {
+            if (bump())
+            {
+                FutexWakeAll(&m_epoch);
+            }
+        }
+
+    private:
+        // Pairs with prepare_wait, either the waiter sees the condition or we see the waiter
+        bool bump()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_waiters.load(std::memory_order_seq_cst) == 0)
+            {
+                return false;
+            }
+            m_epoch.fetch_add(1, std::memory_order_seq_cst);
+            return true;
+        }
+
+        std::atomic<uint32_t>   m_epoch { 0 };
+        std::atomic<uint32_t>   m_waiters { 0 };
+    };
+}
@@ -8,6 +8,8 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 #pragma once
 
 #include <functional>
+#include <taco/taco_core.h>
+#include "config.h"
 
 namespace taco
 {
@@ -15,6 +17,18 @@ namespace taco
 
     typedef std::function<void()> fiber_fn;
 
+    static constexpr size_t stack_class_count = size_t(stack_size::huge) + 1;
+
+    inline size_t FiberStackSize(stack_size size)
+    {
+        switch (size)
+        {
+        case stack_size::large:     return FIBER_STACK_SIZE_LARGE;
+        case stack_size::huge:      return FIBER_STACK_SIZE_HUGE;
+        default:                    return FIBER_STACK_SIZE;
+        }
+    }
+
     struct fiber_base
     {
         fiber_fn            fn;
@@ -23,12 +37,17 @@ namespace taco
         int                 threadId;
         void *              data;
         const char *        name;
+        stack_size          stack;
+        task_priority       priority;
+        int64_t             deadline;
+        int64_t             blockingSince;  ///< When the current blocking section began, steady clock nanoseconds
+        uint32_t            inlineDepth;    ///< Number of tasks running inline on this fiber, see TASK_INLINE_DEPTH
         bool                isBlocking;
     };
 
     void    FiberInitializeThread();
     void    FiberShutdownThread();
-    fiber * FiberCreate(const fiber_fn & fn);
+    fiber * FiberCreate(const fiber_fn & fn, stack_size size = stack_size::standard);
     void    FiberDestroy(fiber * f);
     void    FiberInvoke(fiber * f);
     fiber * FiberCurrent();
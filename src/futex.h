@@ -0,0 +1,20 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+namespace taco
+{
+    /// Sleeps while word holds expected, until woken or timeout (in nanoseconds, negative for
+    /// none) has passed. May also return spuriously, callers recheck whatever they wait for
+    void    FutexWait       (std::atomic<uint32_t> * word, uint32_t expected, int64_t timeout);
+    void    FutexWakeOne    (std::atomic<uint32_t> * word);
+    void    FutexWakeAll    (std::atomic<uint32_t> * word);
+}
@@ -0,0 +1,101 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <basis/assert.h>
+#include <taco/future.h>
+#include "block_pool.h"
+#include "config.h"
+#include "fiber.h"
+#include "scheduler_priv.h"
+#include "profiler_priv.h"
+
+namespace taco
+{
+    typedef block_pool<FUTURE_BLOCK_SIZE, FUTURE_POOL_CACHE_LIMIT> future_pool_small;
+    typedef block_pool<FUTURE_BLOCK_SIZE * 2, FUTURE_POOL_CACHE_LIMIT> future_pool_medium;
+    typedef block_pool<FUTURE_BLOCK_SIZE * 4, FUTURE_POOL_CACHE_LIMIT> future_pool_large;
+
+    // A fiber waiting on a future, lives on its stack
+    struct future_waiter : internal::continuation
+    {
+        fiber *     f;
+    };
+
+    static void ResumeWaiter(internal::continuation * self, bool invoke)
+    {
+        // Whoever waits holds a reference, so the future can't go away without this being run
+        BASIS_ASSERT(invoke);
+        BASIS_UNUSED(invoke);
+        Resume(((future_waiter *) self)->f);
+    }
+
+    namespace internal
+    {
+        void * AllocFutureBlock(size_t size, size_t align)
+        {
+            if (align <= alignof(std::max_align_t))
+            {
+                if (size <= future_pool_small::block_size)
+                {
+                    return future_pool_small::Alloc();
+                }
+                if (size <= future_pool_medium::block_size)
+                {
+                    return future_pool_medium::Alloc();
+                }
+                if (size <= future_pool_large::block_size)
+                {
+                    return future_pool_large::Alloc();
+                }
+            }
+            return ::operator new(size, std::align_val_t(align));
+        }
+
+        void FreeFutureBlock(void * block, size_t size, size_t align)
+        {
+            if (align <= alignof(std::max_align_t))
+            {
+                if (size <= future_pool_small::block_size)
+                {
+                    future_pool_small::Free(block);
+                    return;
+                }
+                if (size <= future_pool_medium::block_size)
+                {
+                    future_pool_medium::Free(block);
+                    return;
+                }
+                if (size <= future_pool_large::block_size)
+                {
+                    future_pool_large::Free(block);
+                    return;
+                }
+            }
+            ::operator delete(block, std::align_val_t(align));
+        }
+
+        void WaitFuture(future_state * state)
+        {
+            BASIS_ASSERT(IsSchedulerThread());
+            TACO_PROFILER_LOG("future::await <%p>", state);
+
+            fiber * cur = FiberCurrent();
+            BASIS_ASSERT(cur);
+
+            // Added once we are suspended, so completing it can't resume us too early. If it
+            // was completed in the meantime the waiter is run (resuming us) straight away
+            future_waiter waiter;
+            waiter.next = nullptr;
+            waiter.fn = &ResumeWaiter;
+            waiter.f = cur;
+            Suspend([&]() -> void {
+                state->add(&waiter);
+            });
+            BASIS_ASSERT(state->is_ready());
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <basis/assert.h>
+#include <taco/generator.h>
+#include "fiber.h"
+#include "scheduler_priv.h"
+#include "profiler_priv.h"
+
+namespace taco
+{
+    // Publishes the current fiber in waiter once suspended, then checks again - whoever makes
+    // ready true after that sees it and wakes us, anyone before is seen by the check. Exactly
+    // one of the two takes it back out and resumes us
+    template<class READY>
+    static void Park(std::atomic<void *> & waiter, READY && ready)
+    {
+        BASIS_ASSERT(IsSchedulerThread());
+
+        fiber * self = FiberCurrent();
+        BASIS_ASSERT(self);
+
+        while (!ready())
+        {
+            Suspend([&]() -> void {
+                waiter.store(self, std::memory_order_seq_cst);
+                if (ready() && waiter.exchange(nullptr, std::memory_order_acq_rel) == self)
+                {
+                    Resume(self);
+                }
+            });
+        }
+    }
+
+    namespace internal
+    {
+        void generator_base::wait_readable()
+        {
+            TACO_PROFILER_LOG("generator::wait_readable <%p>", this);
+            Park(reader, [this]() -> bool { return readable(); });
+        }
+
+        void generator_base::wait_writable()
+        {
+            TACO_PROFILER_LOG("generator::wait_writable <%p>", this);
+            Park(writer, [this]() -> bool { return writable(); });
+        }
+
+        void generator_base::wake(std::atomic<void *> & waiter)
+        {
+            fiber * f = (fiber *) waiter.exchange(nullptr, std::memory_order_acq_rel);
+            if (f)
+            {
+                Resume(f);
+            }
+        }
+    }
+}
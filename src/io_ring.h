@@ -0,0 +1,60 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+namespace taco
+{
+    struct fiber;
+
+    /// Asynchronous I/O queue of a single scheduler (io_uring on Linux). Only the owning scheduler
+    /// submits and reaps, other threads may only wake it
+    struct io_ring;
+
+    enum class io_opcode : uint8_t
+    {
+        open,
+        read,
+        write,
+        fsync
+    };
+
+    /// An operation on an io_ring, lives on the stack of the fiber waiting on it
+    struct io_request
+    {
+        io_opcode       op;
+        int             fd;
+        const char *    path;       ///< open
+        void *          buffer;     ///< read, write
+        uint32_t        size;
+        int64_t         offset;     ///< -1 for the file position
+        int             flags;      ///< open
+        uint32_t        mode;       ///< open
+
+        fiber *         f;
+        int64_t         result;     ///< as returned by the system call, -errno on failure
+    };
+
+    /// Completions are counted on notifyFd (an eventfd), nullptr where asynchronous I/O isn't supported
+    io_ring *   IoRingCreate        (uint32_t entries, int notifyFd);
+    void        IoRingDestroy       (io_ring * ring);
+
+    /// Reserves room for a request, false if the ring is full
+    bool        IoRingReserve       (io_ring * ring);
+    /// Queues a request (after reserving room for it) to be submitted by the next IoRingPoll,
+    /// which resumes request->f once it completes
+    void        IoRingQueue         (io_ring * ring, io_request * request);
+
+    /// Submits anything queued and resumes the fibers of completed requests
+    void        IoRingPoll          (io_ring * ring);
+    /// Whether any request is waiting to be submitted or to complete
+    bool        IoRingBusy          (io_ring * ring);
+    /// Whether IoRingPoll has something to do right now
+    bool        IoRingReady         (io_ring * ring);
+}
@@ -0,0 +1,243 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <stdint.h>
+
+#include <basis/assert.h>
+
+#include "futex.h"
+
+namespace taco
+{
+    /// @brief Eventcount style parking for a fixed set of threads
+    /// A thread that has run out of work calls prepare_park, takes one last look for work and then
+    /// either cancel_park's or park's. Anything that makes work available after that last look sees
+    /// the thread as parked and wakes it, so wakeups can't be lost in between. Parked threads are
+    /// tracked in a bit mask - waking only ever goes to threads that are actually parked, and when
+    /// none are it costs a fence and a load of a rarely written cache line. Threads sleep on
+    /// their own slot's state with FutexWait, timed or not, so waking one is a single FutexWakeOne.
+    /// Unlike event_count, which wakes whoever is waiting, wakers here pick which threads to wake.
+    /// A thread can also park in a wait of its own, with wakers calling the matching wake function.
+    class parking_lot
+    {
+        static constexpr uint32_t BITS = 64;
+
+        enum : uint32_t
+        {
+            awake,
+            parking,
+            notified
+        };
+
+        struct alignas(64) slot
+        {
+            std::atomic<uint32_t>   state { awake };
+            std::atomic<bool>       external { false };
+            std::atomic<void (*)(void *)> wake { nullptr };
+            std::atomic<void *>     context { nullptr };
+        };
+
+        struct alignas(64) word
+        {
+            std::atomic<uint64_t>   bits { 0 };
+        };
+
+    public:
+        parking_lot(uint32_t count)
+            :   m_slots(new slot[count]),
+                m_words(new word[(count + BITS - 1) / BITS]),
+                m_count(count)
+        {}
+
+        ~parking_lot()
+        {
+            delete [] m_slots;
+            delete [] m_words;
+        }
+
+        /// @brief Announces that thread id is about to park
+        /// Must be followed by a last check for work and then park or cancel_park
+        void prepare_park(uint32_t id)
+        {
+            BASIS_ASSERT(id < m_count);
+            m_slots[id].state.store(parking, std::memory_order_relaxed);
+            m_words[id / BITS].bits.fetch_or(bit(id), std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        /// @brief Backs out of parking after work turned up during the last check
+        void cancel_park(uint32_t id)
+        {
+            BASIS_ASSERT(id < m_count);
+            m_words[id / BITS].bits.fetch_and(~bit(id), std::memory_order_relaxed);
+            m_slots[id].state.store(awake, std::memory_order_relaxed);
+        }
+
+        /// @brief Sleeps until thread id is woken by unpark or unpark_any
+        void park(uint32_t id)
+        {
+            BASIS_ASSERT(id < m_count);
+            std::atomic<uint32_t> & state = m_slots[id].state;
+            while (state.load(std::memory_order_acquire) == parking)
+            {
+                FutexWait(&state, parking, -1);
+            }
+
+            // A waker from an earlier prepare_park may have left us notified while our bit was
+            // set again, make sure neither is left behind
+            m_words[id / BITS].bits.fetch_and(~bit(id), std::memory_order_relaxed);
+            state.store(awake, std::memory_order_relaxed);
+        }
+
+        /// @brief Sleeps until thread id is woken by unpark or unpark_any, or time is reached
+        /// @return false if the time was reached without being woken
+        bool park_until(uint32_t id, std::chrono::steady_clock::time_point time)
+        {
+            BASIS_ASSERT(id < m_count);
+            std::atomic<uint32_t> & state = m_slots[id].state;
+            bool woken = false;
+            for (;;)
+            {
+                woken = state.load(std::memory_order_acquire) != parking;
+                auto now = std::chrono::steady_clock::now();
+                if (woken || now >= time)
+                {
+                    break;
+                }
+                FutexWait(&state, parking, std::chrono::duration_cast<std::chrono::nanoseconds>(time - now).count());
+            }
+
+            m_words[id / BITS].bits.fetch_and(~bit(id), std::memory_order_relaxed);
+            state.store(awake, std::memory_order_relaxed);
+            return woken;
+        }
+
+        /// @brief Sleeps in wait instead, for threads that have something besides unpark to wake
+        /// up for (eg I/O completions). Wakers call wake(context), which must make wait return.
+        /// wait may return early, the thread is no longer parked either way
+        template<class WAIT>
+        void park_external(uint32_t id, void (*wake)(void * context), void * context, WAIT && wait)
+        {
+            BASIS_ASSERT(id < m_count);
+            slot & s = m_slots[id];
+
+            // Pairs with claim, either we see the notification or the waker sees us waiting
+            s.wake.store(wake, std::memory_order_relaxed);
+            s.context.store(context, std::memory_order_relaxed);
+            s.external.store(true, std::memory_order_seq_cst);
+            if (s.state.load(std::memory_order_seq_cst) == parking)
+            {
+                wait();
+            }
+            s.external.store(false, std::memory_order_relaxed);
+
+            m_words[id / BITS].bits.fetch_and(~bit(id), std::memory_order_relaxed);
+            s.state.store(awake, std::memory_order_relaxed);
+        }
+
+        /// @brief Wakes thread id if it is parked (or about to be)
+        /// Call after making the work it should pick up visible
+        /// @return true if the thread was woken
+        bool unpark(uint32_t id)
+        {
+            BASIS_ASSERT(id < m_count);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            std::atomic<uint64_t> & bits = m_words[id / BITS].bits;
+            if ((bits.load(std::memory_order_relaxed) & bit(id)) == 0)
+            {
+                return false;
+            }
+            return claim(bits, id);
+        }
+
+        /// @brief Wakes up to count parked threads, other than exclude
+        /// Call after making the work they should pick up visible
+        /// @return number of threads woken
+        size_t unpark_any(size_t count, uint32_t exclude)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            size_t woken = 0;
+            for (uint32_t w=0; w<(m_count + BITS - 1) / BITS && woken < count; w++)
+            {
+                std::atomic<uint64_t> & bits = m_words[w].bits;
+                uint64_t parked = bits.load(std::memory_order_relaxed);
+                while (parked != 0 && woken < count)
+                {
+                    uint32_t id = w * BITS + uint32_t(std::countr_zero(parked));
+                    parked &= parked - 1;
+                    if (id != exclude && claim(bits, id))
+                    {
+                        woken++;
+                    }
+                }
+            }
+            return woken;
+        }
+
+        /// @brief True if no thread is parked or about to park
+        bool empty() const
+        {
+            for (uint32_t w=0; w<(m_count + BITS - 1) / BITS; w++)
+            {
+                if (m_words[w].bits.load(std::memory_order_relaxed) != 0)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// @brief Number of threads parked or about to park
+        uint32_t parked() const
+        {
+            uint32_t count = 0;
+            for (uint32_t w=0; w<(m_count + BITS - 1) / BITS; w++)
+            {
+                count += uint32_t(std::popcount(m_words[w].bits.load(std::memory_order_relaxed)));
+            }
+            return count;
+        }
+
+    private:
+        parking_lot(const parking_lot &) = delete;
+        parking_lot & operator = (const parking_lot &) = delete;
+
+        static uint64_t bit(uint32_t id)
+        {
+            return uint64_t(1) << (id % BITS);
+        }
+
+        // Only the waker that clears a thread's bit gets to wake it
+        bool claim(std::atomic<uint64_t> & bits, uint32_t id)
+        {
+            if ((bits.fetch_and(~bit(id), std::memory_order_seq_cst) & bit(id)) == 0)
+            {
+                return false;
+            }
+
+            slot & s = m_slots[id];
+            s.state.store(notified, std::memory_order_seq_cst);
+            FutexWakeOne(&s.state);
+            if (s.external.load(std::memory_order_seq_cst))
+            {
+                s.wake.load(std::memory_order_relaxed)(s.context.load(std::memory_order_relaxed));
+            }
+            return true;
+        }
+
+        slot *      m_slots;
+        word *      m_words;
+        uint32_t    m_count;
+    };
+}
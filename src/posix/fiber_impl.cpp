@@ -5,8 +5,17 @@ http://divergentcoder.io
 This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
 */
 
+#if !defined(TACO_FIBER_USE_UCONTEXT) && !defined(__x86_64__) && !defined(__aarch64__)
+// no hand written switch for this architecture, fall back to ucontext
+#define TACO_FIBER_USE_UCONTEXT
+#endif
+
+#if defined(TACO_FIBER_USE_UCONTEXT)
 #include <ucontext.h>
 #include <setjmp.h>
+#endif
+#include <stdint.h>
+#include <new>
 
 #include <basis/assert.h>
 #include <basis/thread_util.h>
@@ -14,15 +23,130 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 #include "../fiber.h"
 #include "../config.h"
 #include "../thread_state.h"
+#include "fiber_stack.h"
 
-#if defined(__clang__)
+#if defined(TACO_FIBER_USE_UCONTEXT) && defined(__clang__)
 // yes, yes, ucontext is deprecated on at least MacOS as of 10.6
 // probably elsewhere too
 // it still works for now though
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
 #endif
 
-// using technique detailed at http://www.1024cores.net/home/lock-free-algorithms/tricks/fibers
+#if !defined(TACO_FIBER_USE_UCONTEXT)
+
+// Hand written context switch - taco_fiber_switch(&from->sp, to->sp)
+// pushes the callee-saved registers on to the current stack, stores
+// the resulting stack pointer in *from and then pops the same set of
+// registers back off of the stack we are switching to. Everything else
+// is already considered clobbered by the caller per the ABI so there is
+// nothing more to save and, unlike swapcontext, no signal mask syscall.
+//
+// A new fiber is bootstrapped by laying out a fake switch frame at the
+// top of its stack (see FiberInitStack) that "returns" in to
+// taco_fiber_trampoline with the fiber pointer and entry function
+// sitting in callee-saved registers.
+
+#if defined(__APPLE__)
+#define TACO_ASM_SYMBOL(name) "_" #name
+#define TACO_ASM_FUNCTION(name) \
+    ".private_extern " TACO_ASM_SYMBOL(name) "\n" \
+    ".globl " TACO_ASM_SYMBOL(name) "\n" \
+    TACO_ASM_SYMBOL(name) ":\n"
+#else
+#define TACO_ASM_SYMBOL(name) #name
+#define TACO_ASM_FUNCTION(name) \
+    ".hidden " TACO_ASM_SYMBOL(name) "\n" \
+    ".globl " TACO_ASM_SYMBOL(name) "\n" \
+    ".type " TACO_ASM_SYMBOL(name) ", %function\n" \
+    TACO_ASM_SYMBOL(name) ":\n"
+#endif
+
+extern "C"
+{
+    void taco_fiber_switch(void ** from, void * to);
+    void taco_fiber_trampoline();
+}
+
+#if defined(__x86_64__)
+
+// Frame layout (lowest address first):
+//      mxcsr / x87 control word, r15, r14, r13, r12, rbx, rbp, return address
+asm(
+    ".text\n"
+    ".p2align 4\n"
+    TACO_ASM_FUNCTION(taco_fiber_switch)
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".p2align 4\n"
+    TACO_ASM_FUNCTION(taco_fiber_trampoline)
+    "    movq %r12, %rdi\n"
+    "    callq *%r13\n"
+    "    ud2\n"
+);
+
+#elif defined(__aarch64__)
+
+// Frame layout (lowest address first):
+//      x19 - x28, x29 (fp), x30 (lr), d8 - d15
+asm(
+    ".text\n"
+    ".p2align 4\n"
+    TACO_ASM_FUNCTION(taco_fiber_switch)
+    "    sub sp, sp, #160\n"
+    "    stp x19, x20, [sp, #0]\n"
+    "    stp x21, x22, [sp, #16]\n"
+    "    stp x23, x24, [sp, #32]\n"
+    "    stp x25, x26, [sp, #48]\n"
+    "    stp x27, x28, [sp, #64]\n"
+    "    stp x29, x30, [sp, #80]\n"
+    "    stp d8, d9, [sp, #96]\n"
+    "    stp d10, d11, [sp, #112]\n"
+    "    stp d12, d13, [sp, #128]\n"
+    "    stp d14, d15, [sp, #144]\n"
+    "    mov x9, sp\n"
+    "    str x9, [x0]\n"
+    "    mov sp, x1\n"
+    "    ldp x19, x20, [sp, #0]\n"
+    "    ldp x21, x22, [sp, #16]\n"
+    "    ldp x23, x24, [sp, #32]\n"
+    "    ldp x25, x26, [sp, #48]\n"
+    "    ldp x27, x28, [sp, #64]\n"
+    "    ldp x29, x30, [sp, #80]\n"
+    "    ldp d8, d9, [sp, #96]\n"
+    "    ldp d10, d11, [sp, #112]\n"
+    "    ldp d12, d13, [sp, #128]\n"
+    "    ldp d14, d15, [sp, #144]\n"
+    "    add sp, sp, #160\n"
+    "    ret\n"
+    ".p2align 4\n"
+    TACO_ASM_FUNCTION(taco_fiber_trampoline)
+    "    mov x0, x19\n"
+    "    blr x20\n"
+    "    brk #0\n"
+);
+
+#endif
+
+#endif
 
 namespace taco
 {
@@ -30,8 +154,12 @@ namespace taco
     {
         fiber_base                base;
         bool                      active;
+#if defined(TACO_FIBER_USE_UCONTEXT)
         ucontext_t                ctx;
         jmp_buf                   jmp;
+#else
+        void *                    sp;
+#endif
         char *                    stack;
     };
 
@@ -69,6 +197,10 @@ namespace taco
         }
     }
 
+#if defined(TACO_FIBER_USE_UCONTEXT)
+
+    // using technique detailed at http://www.1024cores.net/home/lock-free-algorithms/tricks/fibers
+
     static void FiberMain(uint32_t ptr_hi, uint32_t ptr_low)
     {
         // makecontext expects integer parameters
@@ -102,6 +234,56 @@ namespace taco
         self->base.fn();
     }
 
+#else
+
+    static void FiberMain(fiber * self)
+    {
+        BASIS_ASSERT(self != nullptr);
+
+        // First time this fiber has been invoked, complete the handoff
+        // transition from whatever fiber switched to us before invoking
+        // the users function
+        FiberHandoff(thread_state<fiber_state>().current, self);
+        self->base.fn();
+
+        // fiber functions are not allowed to return, there is nothing to
+        // return to
+        BASIS_ASSERT_FAILED;
+    }
+
+    static void * FiberInitStack(fiber * f, char * stack, size_t size)
+    {
+        uintptr_t top = ((uintptr_t)(stack + size)) & ~uintptr_t(15);
+
+#if defined(__x86_64__)
+        // 8 slots for the switch frame plus 2 to keep the stack 16 byte
+        // aligned at the call in to FiberMain
+        void ** sp = (void **) top - 10;
+        sp[0] = (void *) uintptr_t(0x037f00001f80ull);   // default x87 control word and mxcsr
+        sp[1] = nullptr;                                    // r15
+        sp[2] = nullptr;                                    // r14
+        sp[3] = (void *) &FiberMain;                        // r13
+        sp[4] = f;                                          // r12
+        sp[5] = nullptr;                                    // rbx
+        sp[6] = nullptr;                                    // rbp
+        sp[7] = (void *) &taco_fiber_trampoline;            // return address
+        sp[8] = nullptr;
+        sp[9] = nullptr;
+#elif defined(__aarch64__)
+        void ** sp = (void **) top - 20;
+        for (int i=0; i<20; i++)
+        {
+            sp[i] = nullptr;
+        }
+        sp[0] = f;                                          // x19
+        sp[1] = (void *) &FiberMain;                        // x20
+        sp[11] = (void *) &taco_fiber_trampoline;           // x30 (lr)
+#endif
+        return sp;
+    }
+
+#endif
+
     void FiberInitializeThread()
     {
         fiber_state & state = thread_state<fiber_state>();
@@ -110,6 +292,11 @@ namespace taco
         fiber * root = new fiber;
         root->base.threadId = -1;
         root->base.data = nullptr;
+        root->base.stack = stack_size::huge;
+        root->base.priority = task_priority::normal;
+        root->base.deadline = 0;
+        root->base.blockingSince = 0;
+        root->base.inlineDepth = 0;
         root->active = true;
 
         state.root = state.current = root;
@@ -125,28 +312,43 @@ namespace taco
         state.root = state.current = nullptr;
     }
 
-    fiber * FiberCreate(const fiber_fn & fn)
+    fiber * FiberCreate(const fiber_fn & fn, stack_size size)
     {
         fiber * f = new fiber;
-        uintptr_t addr = (uintptr_t) f;
 
         f->base.fn = fn;
         f->base.threadId = -1;
         f->base.data = nullptr;
         f->base.isBlocking = false;
         f->base.onEnter = f->base.onExit = nullptr;
+        f->base.stack = size;
+        f->base.priority = task_priority::normal;
+        f->base.deadline = 0;
+        f->base.blockingSince = 0;
+        f->base.inlineDepth = 0;
         f->active = false;
-        f->stack = new char[FIBER_STACK_SIZE];
+        f->stack = FiberStackAlloc(size);
+        if (!f->stack)
+        {
+            delete f;
+            throw std::bad_alloc();
+        }
+
+#if defined(TACO_FIBER_USE_UCONTEXT)
+        uintptr_t addr = (uintptr_t) f;
 
         getcontext(&f->ctx);
 
         f->ctx.uc_stack.ss_sp = f->stack;
-        f->ctx.uc_stack.ss_size = FIBER_STACK_SIZE;
+        f->ctx.uc_stack.ss_size = FiberStackSize(size);
         f->ctx.uc_link = 0;
 
         fiber_state & state = thread_state<fiber_state>();
         makecontext(&f->ctx, (void(*)())&FiberMain, 2, ((addr >> 32) & 0xffffffff), (addr & 0xffffffff));
         swapcontext(&state.current->ctx, &f->ctx);
+#else
+        f->sp = FiberInitStack(f, f->stack, FiberStackSize(size));
+#endif
 
         return f;
     }
@@ -155,7 +357,7 @@ namespace taco
     {
         BASIS_ASSERT(thread_state<fiber_state>().current != f);
 
-        delete [] f->stack;
+        FiberStackFree(f->stack, f->base.stack);
         delete f;
     }
 
@@ -165,10 +367,14 @@ namespace taco
         
         BASIS_ASSERT(f != self);
 
+#if defined(TACO_FIBER_USE_UCONTEXT)
         if (_setjmp(self->jmp) == 0)
         {
             _longjmp(f->jmp, 1);
         }
+#else
+        taco_fiber_switch(&self->sp, f->sp);
+#endif
 
         // Note we call thread_state again instead of reusing the
         // earlier reference because we could now be on a different
@@ -0,0 +1,182 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <mutex>
+
+#include <basis/assert.h>
+
+#include "../fiber.h"
+#include "../config.h"
+#include "../thread_state.h"
+#include "fiber_stack.h"
+
+#if !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+// Stacks are carved out of larger mmap'd regions, each stack preceded by a
+// PROT_NONE guard page so an overflow faults instead of silently trashing
+// whatever happens to sit below it on the heap. Pages are only committed
+// as they are touched so a huge stack only costs what it actually uses.
+//
+// Free stacks are kept in per thread, per size class lists (linked through
+// the bottom of the free stack itself). Past FIBER_STACK_CACHE_LIMIT half of
+// a thread's list is handed back to a shared pool for that class, which is
+// also where a thread refills from before mapping a new region. Regions are
+// never unmapped.
+
+namespace taco
+{
+    struct stack_node
+    {
+        stack_node * next;
+    };
+
+    struct stack_pool
+    {
+        std::mutex      mutex;
+        stack_node *    head {};
+    };
+
+    static stack_pool SharedStacks[stack_class_count];
+
+    struct stack_cache
+    {
+        stack_node *    head[stack_class_count] {};
+        size_t          count[stack_class_count] {};
+
+        ~stack_cache()
+        {
+            for (size_t i=0; i<stack_class_count; i++)
+            {
+                Release(i, count[i]);
+            }
+        }
+
+        // Moves n stacks from this thread's list to the shared pool
+        void Release(size_t cls, size_t n)
+        {
+            if (n == 0)
+            {
+                return;
+            }
+
+            stack_node * first = head[cls];
+            stack_node * last = first;
+            for (size_t i=1; i<n; i++)
+            {
+                last = last->next;
+            }
+            head[cls] = last->next;
+            count[cls] -= n;
+
+            std::unique_lock<std::mutex> lock(SharedStacks[cls].mutex);
+            last->next = SharedStacks[cls].head;
+            SharedStacks[cls].head = first;
+        }
+
+        // Moves up to n stacks from the shared pool to this thread's list
+        void Acquire(size_t cls, size_t n)
+        {
+            std::unique_lock<std::mutex> lock(SharedStacks[cls].mutex);
+            while (n > 0 && SharedStacks[cls].head)
+            {
+                stack_node * node = SharedStacks[cls].head;
+                SharedStacks[cls].head = node->next;
+                node->next = head[cls];
+                head[cls] = node;
+                count[cls]++;
+                n--;
+            }
+        }
+    };
+
+    static size_t PageSize()
+    {
+        static const size_t size = (size_t) sysconf(_SC_PAGESIZE);
+        return size;
+    }
+
+    // Maps FIBER_STACK_REGION_COUNT stacks in to the cache, false if the OS refused
+    static bool MapRegion(stack_cache & cache, size_t cls)
+    {
+        const size_t page = PageSize();
+        const size_t size = FiberStackSize(stack_size(cls));
+        const size_t stride = page + size;
+
+        BASIS_ASSERT((size % page) == 0);
+
+        char * region = (char *) mmap(nullptr, stride * FIBER_STACK_REGION_COUNT, PROT_READ | PROT_WRITE,
+                                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED)
+        {
+            return false;
+        }
+
+        for (size_t i=0; i<FIBER_STACK_REGION_COUNT; i++)
+        {
+            // Typically out of mappings (vm.max_map_count), each guard page splits the region
+            if (mprotect(region + i * stride, page, PROT_NONE) != 0)
+            {
+                munmap(region, stride * FIBER_STACK_REGION_COUNT);
+                return false;
+            }
+        }
+
+        for (size_t i=0; i<FIBER_STACK_REGION_COUNT; i++)
+        {
+            stack_node * node = (stack_node *) (region + i * stride + page);
+            node->next = cache.head[cls];
+            cache.head[cls] = node;
+            cache.count[cls]++;
+        }
+        return true;
+    }
+
+    char * FiberStackAlloc(stack_size size)
+    {
+        stack_cache & cache = thread_state<stack_cache>();
+        size_t cls = size_t(size);
+
+        BASIS_ASSERT(cls < stack_class_count);
+
+        if (!cache.head[cls])
+        {
+            cache.Acquire(cls, FIBER_STACK_CACHE_LIMIT / 2);
+        }
+        if (!cache.head[cls] && !MapRegion(cache, cls))
+        {
+            return nullptr;
+        }
+
+        stack_node * node = cache.head[cls];
+        cache.head[cls] = node->next;
+        cache.count[cls]--;
+
+        return (char *) node;
+    }
+
+    void FiberStackFree(char * stack, stack_size size)
+    {
+        stack_cache & cache = thread_state<stack_cache>();
+        size_t cls = size_t(size);
+
+        BASIS_ASSERT(cls < stack_class_count);
+
+        stack_node * node = (stack_node *) stack;
+        node->next = cache.head[cls];
+        cache.head[cls] = node;
+        cache.count[cls]++;
+
+        if (cache.count[cls] > FIBER_STACK_CACHE_LIMIT)
+        {
+            cache.Release(cls, cache.count[cls] / 2);
+        }
+    }
+}
@@ -0,0 +1,19 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <taco/taco_core.h>
+
+namespace taco
+{
+    /// Returns the lowest usable address of a stack of FiberStackSize(size) bytes
+    /// The page directly below it is a PROT_NONE guard page. Returns nullptr if the stack
+    /// couldn't be mapped
+    char *  FiberStackAlloc(stack_size size);
+    void    FiberStackFree(char * stack, stack_size size);
+}
@@ -0,0 +1,76 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include <basis/assert.h>
+
+#include "../futex.h"
+
+namespace taco
+{
+#if defined(__linux__)
+
+    void FutexWait(std::atomic<uint32_t> * word, uint32_t expected, int64_t timeout)
+    {
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Expected a lock free 32 bit atomic");
+
+        timespec ts = { time_t(timeout / 1000000000), long(timeout % 1000000000) };
+        syscall(SYS_futex, (uint32_t *) word, FUTEX_WAIT_PRIVATE, expected, (timeout < 0) ? nullptr : &ts, nullptr, 0);
+    }
+
+    void FutexWakeOne(std::atomic<uint32_t> * word)
+    {
+        syscall(SYS_futex, (uint32_t *) word, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+
+    void FutexWakeAll(std::atomic<uint32_t> * word)
+    {
+        syscall(SYS_futex, (uint32_t *) word, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+#else
+
+    // std::atomic wait can't time out, timed waits check back every millisecond instead
+
+    void FutexWait(std::atomic<uint32_t> * word, uint32_t expected, int64_t timeout)
+    {
+        if (timeout < 0)
+        {
+            word->wait(expected);
+            return;
+        }
+
+        auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeout);
+        while (word->load() == expected && std::chrono::steady_clock::now() < end)
+        {
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(end - std::chrono::steady_clock::now(), std::chrono::milliseconds(1)));
+        }
+    }
+
+    void FutexWakeOne(std::atomic<uint32_t> * word)
+    {
+        word->notify_one();
+    }
+
+    void FutexWakeAll(std::atomic<uint32_t> * word)
+    {
+        word->notify_all();
+    }
+
+#endif
+}
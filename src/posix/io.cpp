@@ -0,0 +1,112 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include <basis/assert.h>
+#include <taco/io.h>
+#include <taco/taco_core.h>
+
+#include "../fiber.h"
+#include "../io_ring.h"
+#include "../scheduler_priv.h"
+
+namespace taco
+{
+    namespace io
+    {
+        // Largest transfer Linux does in one read or write, anything bigger comes back short anyway
+        static const size_t max_transfer = 0x7ffff000;
+
+        // Runs request on the current scheduler's ring, or call (which must return the result the
+        // posix way) on a blocking thread if there isn't one
+        template<class CALL>
+        static int64_t Perform(io_request & request, CALL && call)
+        {
+            if (!IsSchedulerThread())
+            {
+                return call();
+            }
+
+            io_ring * ring = GetIoRing();
+            if (!ring || !IoRingReserve(ring))
+            {
+                BeginBlocking();
+                int64_t result = call();
+                // errno belongs to the blocking thread
+                int error = errno;
+                EndBlocking();
+                errno = error;
+                return result;
+            }
+
+            // Queued once we are suspended, so the completion can't resume us too early
+            request.f = FiberCurrent();
+            Suspend([&]() -> void {
+                IoRingQueue(ring, &request);
+            });
+
+            if (request.result < 0)
+            {
+                errno = int(-request.result);
+                return -1;
+            }
+            return request.result;
+        }
+
+        int open(const char * path, int flags, mode_t mode)
+        {
+            io_request request = {};
+            request.op = io_opcode::open;
+            request.path = path;
+            request.flags = flags;
+            request.mode = uint32_t(mode);
+            return int(Perform(request, [&]() -> int64_t {
+                return ::open(path, flags, mode);
+            }));
+        }
+
+        ssize_t read(int fd, void * buffer, size_t size, off_t offset)
+        {
+            io_request request = {};
+            request.op = io_opcode::read;
+            request.fd = fd;
+            request.buffer = buffer;
+            request.size = uint32_t(std::min(size, max_transfer));
+            request.offset = offset;
+            return ssize_t(Perform(request, [&]() -> int64_t {
+                return (offset < 0) ? ::read(fd, buffer, size) : ::pread(fd, buffer, size, offset);
+            }));
+        }
+
+        ssize_t write(int fd, const void * buffer, size_t size, off_t offset)
+        {
+            io_request request = {};
+            request.op = io_opcode::write;
+            request.fd = fd;
+            request.buffer = const_cast<void *>(buffer);
+            request.size = uint32_t(std::min(size, max_transfer));
+            request.offset = offset;
+            return ssize_t(Perform(request, [&]() -> int64_t {
+                return (offset < 0) ? ::write(fd, buffer, size) : ::pwrite(fd, buffer, size, offset);
+            }));
+        }
+
+        int fsync(int fd)
+        {
+            io_request request = {};
+            request.op = io_opcode::fsync;
+            request.fd = fd;
+            return int(Perform(request, [&]() -> int64_t {
+                return ::fsync(fd);
+            }));
+        }
+    }
+}
@@ -0,0 +1,327 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <basis/assert.h>
+
+#include "../io_ring.h"
+
+#if defined(__linux__)
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "../scheduler_priv.h"
+
+// Talks to io_uring with the raw system calls rather than through liburing, we only need a
+// small part of it: one ring per scheduler, no polling threads, completions counted on an
+// eventfd (the scheduler's reactor's) so an idle scheduler can sleep on them alongside its
+// other wakeups.
+
+namespace taco
+{
+    struct io_ring
+    {
+        int                 fd;
+
+        void *              sqMap;
+        size_t              sqMapSize;
+        void *              cqMap;
+        size_t              cqMapSize;
+        io_uring_sqe *      sqes;
+        size_t              sqesSize;
+
+        unsigned *          sqHead;
+        unsigned *          sqTail;
+        unsigned *          sqMask;
+        unsigned *          sqArray;
+        unsigned            sqEntries;
+
+        unsigned *          cqHead;
+        unsigned *          cqTail;
+        unsigned *          cqMask;
+        io_uring_cqe *      cqes;
+
+        // Requests between IoRingReserve and being reaped, never more than sqEntries so
+        // neither the submission nor the (twice as large) completion queue can overflow
+        uint32_t            inflight;
+        // Queued but not yet submitted
+        uint32_t            queued;
+    };
+
+    static unsigned LoadAcquire(unsigned * ptr)
+    {
+        return std::atomic_ref<unsigned>(*ptr).load(std::memory_order_acquire);
+    }
+
+    static void StoreRelease(unsigned * ptr, unsigned value)
+    {
+        std::atomic_ref<unsigned>(*ptr).store(value, std::memory_order_release);
+    }
+
+    static int Enter(io_ring * ring, unsigned submit)
+    {
+        int result;
+        do
+        {
+            result = (int) syscall(__NR_io_uring_enter, ring->fd, submit, 0, 0, nullptr, 0);
+        } while (result < 0 && errno == EINTR);
+        return result;
+    }
+
+    // Every operation we use needs to be there (they all are from Linux 5.6 on)
+    static bool Supported(int fd)
+    {
+        static const uint8_t ops[] = { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC };
+        static const unsigned count = 256;
+
+        std::vector<uint8_t> buffer(sizeof(io_uring_probe) + count * sizeof(io_uring_probe_op), 0);
+        io_uring_probe * probe = (io_uring_probe *) buffer.data();
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, count) < 0)
+        {
+            return false;
+        }
+
+        return std::all_of(std::begin(ops), std::end(ops), [=](uint8_t op) -> bool {
+            return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        });
+    }
+
+    io_ring * IoRingCreate(uint32_t entries, int notifyFd)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0)
+        {
+            // Not built into the kernel, or blocked (eg by a container's seccomp profile)
+            return nullptr;
+        }
+
+        io_ring * ring = new io_ring();
+        ring->fd = fd;
+
+        ring->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single)
+        {
+            ring->sqMapSize = ring->cqMapSize = std::max(ring->sqMapSize, ring->cqMapSize);
+        }
+        ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+        ring->sqMap = mmap(nullptr, ring->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        ring->cqMap = single ? ring->sqMap :
+            mmap(nullptr, ring->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        void * sqes = mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        ring->sqes = (sqes == MAP_FAILED) ? nullptr : (io_uring_sqe *) sqes;
+
+        if (ring->sqMap == MAP_FAILED || ring->cqMap == MAP_FAILED || !ring->sqes || !Supported(fd))
+        {
+            IoRingDestroy(ring);
+            return nullptr;
+        }
+
+        uint8_t * sq = (uint8_t *) ring->sqMap;
+        ring->sqHead = (unsigned *) (sq + params.sq_off.head);
+        ring->sqTail = (unsigned *) (sq + params.sq_off.tail);
+        ring->sqMask = (unsigned *) (sq + params.sq_off.ring_mask);
+        ring->sqArray = (unsigned *) (sq + params.sq_off.array);
+        ring->sqEntries = params.sq_entries;
+
+        uint8_t * cq = (uint8_t *) ring->cqMap;
+        ring->cqHead = (unsigned *) (cq + params.cq_off.head);
+        ring->cqTail = (unsigned *) (cq + params.cq_off.tail);
+        ring->cqMask = (unsigned *) (cq + params.cq_off.ring_mask);
+        ring->cqes = (io_uring_cqe *) (cq + params.cq_off.cqes);
+
+        if (notifyFd < 0 || syscall(__NR_io_uring_register, fd, IORING_REGISTER_EVENTFD, &notifyFd, 1) < 0)
+        {
+            IoRingDestroy(ring);
+            return nullptr;
+        }
+
+        ring->inflight = 0;
+        ring->queued = 0;
+        return ring;
+    }
+
+    void IoRingDestroy(io_ring * ring)
+    {
+        if (!ring)
+        {
+            return;
+        }
+
+        if (ring->sqes)
+        {
+            munmap(ring->sqes, ring->sqesSize);
+        }
+        if (ring->cqMap != MAP_FAILED && ring->cqMap != ring->sqMap)
+        {
+            munmap(ring->cqMap, ring->cqMapSize);
+        }
+        if (ring->sqMap != MAP_FAILED)
+        {
+            munmap(ring->sqMap, ring->sqMapSize);
+        }
+        close(ring->fd);
+        delete ring;
+    }
+
+    bool IoRingReserve(io_ring * ring)
+    {
+        if (ring->inflight == ring->sqEntries)
+        {
+            return false;
+        }
+        ring->inflight++;
+        return true;
+    }
+
+    void IoRingQueue(io_ring * ring, io_request * request)
+    {
+        BASIS_ASSERT(ring->queued < ring->inflight);
+
+        // Only we write the tail, and everything up to it is consumed on every submit
+        unsigned tail = *ring->sqTail;
+        unsigned index = tail & *ring->sqMask;
+        io_uring_sqe * sqe = ring->sqes + index;
+        memset(sqe, 0, sizeof(*sqe));
+
+        switch (request->op)
+        {
+        case io_opcode::open:
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t) (uintptr_t) request->path;
+            sqe->len = request->mode;
+            sqe->open_flags = (uint32_t) request->flags;
+            break;
+        case io_opcode::read:
+        case io_opcode::write:
+            sqe->opcode = (request->op == io_opcode::read) ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe->fd = request->fd;
+            sqe->addr = (uint64_t) (uintptr_t) request->buffer;
+            sqe->len = request->size;
+            sqe->off = (uint64_t) request->offset;
+            break;
+        case io_opcode::fsync:
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fd = request->fd;
+            break;
+        }
+        sqe->user_data = (uint64_t) (uintptr_t) request;
+
+        ring->sqArray[index] = index;
+        StoreRelease(ring->sqTail, tail + 1);
+        ring->queued++;
+    }
+
+    void IoRingPoll(io_ring * ring)
+    {
+        if (ring->inflight == 0)
+        {
+            return;
+        }
+
+        if (ring->queued > 0)
+        {
+            // Everything queued since the last poll goes in one system call. If the kernel is
+            // short of memory it takes fewer (or none), the rest are retried next time
+            int submitted = Enter(ring, ring->queued);
+            if (submitted > 0)
+            {
+                ring->queued -= std::min<uint32_t>(ring->queued, uint32_t(submitted));
+            }
+        }
+
+        unsigned head = *ring->cqHead;
+        unsigned tail = LoadAcquire(ring->cqTail);
+        if (head == tail)
+        {
+            return;
+        }
+
+        for (; head != tail; head++)
+        {
+            io_uring_cqe * cqe = ring->cqes + (head & *ring->cqMask);
+            io_request * request = (io_request *) (uintptr_t) cqe->user_data;
+            request->result = cqe->res;
+            ring->inflight--;
+            Resume(request->f);
+        }
+        StoreRelease(ring->cqHead, head);
+    }
+
+    bool IoRingBusy(io_ring * ring)
+    {
+        return ring->inflight > 0;
+    }
+
+    bool IoRingReady(io_ring * ring)
+    {
+        return ring->queued > 0 || *ring->cqHead != LoadAcquire(ring->cqTail);
+    }
+}
+
+#else
+
+// No io_uring, taco::io goes through blocking threads
+
+namespace taco
+{
+    io_ring * IoRingCreate(uint32_t entries, int notifyFd)
+    {
+        BASIS_UNUSED(entries);
+        BASIS_UNUSED(notifyFd);
+        return nullptr;
+    }
+
+    void IoRingDestroy(io_ring * ring)
+    {
+        BASIS_UNUSED(ring);
+    }
+
+    bool IoRingReserve(io_ring * ring)
+    {
+        BASIS_UNUSED(ring);
+        return false;
+    }
+
+    void IoRingQueue(io_ring * ring, io_request * request)
+    {
+        BASIS_UNUSED(ring);
+        BASIS_UNUSED(request);
+    }
+
+    void IoRingPoll(io_ring * ring)
+    {
+        BASIS_UNUSED(ring);
+    }
+
+    bool IoRingBusy(io_ring * ring)
+    {
+        BASIS_UNUSED(ring);
+        return false;
+    }
+
+    bool IoRingReady(io_ring * ring)
+    {
+        BASIS_UNUSED(ring);
+        return false;
+    }
+}
+
+#endif
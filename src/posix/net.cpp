@@ -0,0 +1,178 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <basis/assert.h>
+#include <taco/net.h>
+#include <taco/taco_core.h>
+
+#include "../fiber.h"
+#include "../reactor.h"
+#include "../scheduler_priv.h"
+
+namespace taco
+{
+    namespace net
+    {
+        static int Poll(int fd, uint32_t interest)
+        {
+            pollfd entry = {};
+            entry.fd = fd;
+            entry.events = short((interest & reactor_read) ? POLLIN : POLLOUT);
+            int result;
+            do
+            {
+                result = ::poll(&entry, 1, -1);
+            } while (result < 0 && errno == EINTR);
+
+            if (result > 0 && (entry.revents & POLLNVAL))
+            {
+                errno = EBADF;
+                return -1;
+            }
+            return (result < 0) ? -1 : 0;
+        }
+
+        static int Wait(int fd, uint32_t interest)
+        {
+            if (!IsSchedulerThread())
+            {
+                return Poll(fd, interest);
+            }
+
+            reactor * r = GetReactor();
+            if (!r)
+            {
+                BeginBlocking();
+                int result = Poll(fd, interest);
+                // errno belongs to the blocking thread
+                int error = errno;
+                EndBlocking();
+                errno = error;
+                return result;
+            }
+
+            // Added once we are suspended, so readiness can't resume us too early
+            reactor_waiter waiter = {};
+            waiter.fd = fd;
+            waiter.interest = interest;
+            waiter.f = FiberCurrent();
+            Suspend([&]() -> void {
+                ReactorAdd(r, &waiter);
+            });
+
+            if (waiter.error != 0)
+            {
+                errno = waiter.error;
+                return -1;
+            }
+            return 0;
+        }
+
+        // Makes call until it doesn't fail with EINTR or, after waiting on fd, EAGAIN
+        template<class CALL>
+        static auto Retry(int fd, uint32_t interest, CALL && call) -> decltype(call())
+        {
+            for (;;)
+            {
+                auto result = call();
+                if (result >= 0)
+                {
+                    return result;
+                }
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if ((errno != EAGAIN && errno != EWOULDBLOCK) || Wait(fd, interest) < 0)
+                {
+                    return result;
+                }
+            }
+        }
+
+        int accept(int fd, sockaddr * address, socklen_t * length)
+        {
+            return Retry(fd, reactor_read, [&]() -> int {
+#if defined(__linux__)
+                return ::accept4(fd, address, length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+                int result = ::accept(fd, address, length);
+                if (result >= 0)
+                {
+                    ::fcntl(result, F_SETFL, ::fcntl(result, F_GETFL) | O_NONBLOCK);
+                    ::fcntl(result, F_SETFD, FD_CLOEXEC);
+                }
+                return result;
+#endif
+            });
+        }
+
+        int connect(int fd, const sockaddr * address, socklen_t length)
+        {
+            if (::connect(fd, address, length) == 0)
+            {
+                return 0;
+            }
+            // Interrupted connects carry on in the background just the same
+            if (errno != EINPROGRESS && errno != EINTR)
+            {
+                return -1;
+            }
+
+            if (Wait(fd, reactor_write) < 0)
+            {
+                return -1;
+            }
+
+            int error = 0;
+            socklen_t size = sizeof(error);
+            if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) < 0)
+            {
+                return -1;
+            }
+            if (error != 0)
+            {
+                errno = error;
+                return -1;
+            }
+            return 0;
+        }
+
+        ssize_t recv(int fd, void * buffer, size_t size, int flags)
+        {
+            return Retry(fd, reactor_read, [&]() -> ssize_t {
+                return ::recv(fd, buffer, size, flags);
+            });
+        }
+
+        ssize_t send(int fd, const void * buffer, size_t size, int flags)
+        {
+#if defined(MSG_NOSIGNAL)
+            // A peer that went away shows up as EPIPE rather than killing the process
+            flags |= MSG_NOSIGNAL;
+#endif
+            return Retry(fd, reactor_write, [&]() -> ssize_t {
+                return ::send(fd, buffer, size, flags);
+            });
+        }
+
+        int wait_readable(int fd)
+        {
+            return Wait(fd, reactor_read);
+        }
+
+        int wait_writable(int fd)
+        {
+            return Wait(fd, reactor_write);
+        }
+    }
+}
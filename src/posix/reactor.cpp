@@ -0,0 +1,342 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <basis/assert.h>
+
+#include "../reactor.h"
+
+#if defined(__linux__)
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+
+#include "../config.h"
+#include "../scheduler_priv.h"
+
+// Every fd is registered EPOLLONESHOT for the union of what its waiters want, so an event is
+// only ever delivered once and the fd is re-armed for whoever is left after dispatching it.
+// Registrations are kept when nobody is waiting, an fd that was closed (and maybe reused)
+// in the meantime is sorted out when re-arming it fails.
+
+namespace taco
+{
+    struct reactor_fd
+    {
+        reactor_waiter *    waiters;
+        bool                registered;
+    };
+
+    struct reactor
+    {
+        int                                     epollFd;
+        int                                     wakeFd;
+        std::unordered_map<int, reactor_fd>     fds;
+        uint32_t                                waiting;
+    };
+
+    static uint32_t EpollEvents(reactor_waiter * waiters)
+    {
+        uint32_t events = 0;
+        for (reactor_waiter * waiter = waiters; waiter; waiter = waiter->next)
+        {
+            events |= (waiter->interest & reactor_read) ? uint32_t(EPOLLIN | EPOLLRDHUP) : 0;
+            events |= (waiter->interest & reactor_write) ? uint32_t(EPOLLOUT) : 0;
+        }
+        return events;
+    }
+
+    static bool Arm(reactor * r, int fd, reactor_fd & entry)
+    {
+        uint32_t events = EpollEvents(entry.waiters);
+        if (events == 0)
+        {
+            return true;
+        }
+
+        epoll_event ev = {};
+        ev.events = events | EPOLLONESHOT;
+        ev.data.fd = fd;
+
+        int op = entry.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        int result = epoll_ctl(r->epollFd, op, fd, &ev);
+        if (result < 0 && ((op == EPOLL_CTL_MOD && errno == ENOENT) || (op == EPOLL_CTL_ADD && errno == EEXIST)))
+        {
+            op = (op == EPOLL_CTL_MOD) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+            result = epoll_ctl(r->epollFd, op, fd, &ev);
+        }
+        entry.registered = (result == 0);
+        return result == 0;
+    }
+
+    // Takes the waiters matching ready off of entry, appending them to resume
+    static void Collect(reactor_fd & entry, uint32_t ready, reactor_waiter **& resume)
+    {
+        reactor_waiter ** link = &entry.waiters;
+        while (*link)
+        {
+            reactor_waiter * waiter = *link;
+            if (waiter->interest & ready)
+            {
+                *link = waiter->next;
+                waiter->next = nullptr;
+                *resume = waiter;
+                resume = &waiter->next;
+            }
+            else
+            {
+                link = &waiter->next;
+            }
+        }
+    }
+
+    static void ResumeAll(reactor * r, reactor_waiter * waiters, int error)
+    {
+        while (waiters)
+        {
+            // Once resumed the waiter may be gone
+            reactor_waiter * waiter = waiters;
+            waiters = waiters->next;
+            waiter->error = error;
+            r->waiting--;
+            Resume(waiter->f);
+        }
+    }
+
+    static void DrainWakeFd(reactor * r)
+    {
+        uint64_t count;
+        while (read(r->wakeFd, &count, sizeof(count)) < 0 && errno == EINTR)
+        {
+        }
+    }
+
+    static void Dispatch(reactor * r, const epoll_event * events, int count)
+    {
+        reactor_waiter * ready = nullptr;
+        reactor_waiter ** tail = &ready;
+
+        for (int i=0; i<count; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == r->wakeFd)
+            {
+                DrainWakeFd(r);
+                continue;
+            }
+
+            auto it = r->fds.find(fd);
+            if (it == r->fds.end())
+            {
+                continue;
+            }
+
+            uint32_t flags = 0;
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP))
+            {
+                flags |= reactor_read;
+            }
+            if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+            {
+                flags |= reactor_write;
+            }
+
+            Collect(it->second, flags, tail);
+            if (!Arm(r, fd, it->second))
+            {
+                // Whoever is left can't be waited for either
+                reactor_waiter * failed = it->second.waiters;
+                it->second.waiters = nullptr;
+                ResumeAll(r, failed, errno);
+            }
+        }
+
+        ResumeAll(r, ready, 0);
+    }
+
+    reactor * ReactorCreate()
+    {
+        reactor * r = new reactor();
+        r->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        r->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        r->waiting = 0;
+
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = r->wakeFd;
+        if (r->epollFd < 0 || r->wakeFd < 0 || epoll_ctl(r->epollFd, EPOLL_CTL_ADD, r->wakeFd, &ev) < 0)
+        {
+            ReactorDestroy(r);
+            return nullptr;
+        }
+        return r;
+    }
+
+    void ReactorDestroy(reactor * r)
+    {
+        if (!r)
+        {
+            return;
+        }
+
+        if (r->wakeFd >= 0)
+        {
+            close(r->wakeFd);
+        }
+        if (r->epollFd >= 0)
+        {
+            close(r->epollFd);
+        }
+        delete r;
+    }
+
+    int ReactorWakeFd(reactor * r)
+    {
+        return r->wakeFd;
+    }
+
+    void ReactorAdd(reactor * r, reactor_waiter * waiter)
+    {
+        reactor_fd & entry = r->fds[waiter->fd];
+        waiter->error = 0;
+        waiter->next = entry.waiters;
+        entry.waiters = waiter;
+        r->waiting++;
+
+        if (!Arm(r, waiter->fd, entry))
+        {
+            // eg a closed fd, or a regular file which epoll won't take
+            reactor_waiter * waiters = entry.waiters;
+            entry.waiters = nullptr;
+            ResumeAll(r, waiters, errno);
+        }
+    }
+
+    bool ReactorBusy(reactor * r)
+    {
+        return r->waiting > 0;
+    }
+
+    void ReactorPoll(reactor * r)
+    {
+        epoll_event events[REACTOR_EVENT_BATCH];
+        int count = epoll_wait(r->epollFd, events, REACTOR_EVENT_BATCH, 0);
+        if (count > 0)
+        {
+            Dispatch(r, events, count);
+        }
+    }
+
+    void ReactorWait(reactor * r, int64_t deadline)
+    {
+        epoll_event events[REACTOR_EVENT_BATCH];
+        int count;
+        if (deadline == INT64_MAX)
+        {
+            count = epoll_wait(r->epollFd, events, REACTOR_EVENT_BATCH, -1);
+        }
+        else
+        {
+            int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            int64_t remaining = std::max<int64_t>(deadline - now, 0);
+
+#if defined(SYS_epoll_pwait2)
+            // Nanosecond timeouts from Linux 5.11 on, before that milliseconds rounded up
+            static std::atomic<bool> hasPwait2(true);
+            if (hasPwait2.load(std::memory_order_relaxed))
+            {
+                timespec timeout = { time_t(remaining / 1000000000), long(remaining % 1000000000) };
+                count = (int) syscall(SYS_epoll_pwait2, r->epollFd, events, REACTOR_EVENT_BATCH, &timeout, nullptr, 0);
+                if (count >= 0 || errno != ENOSYS)
+                {
+                    if (count > 0)
+                    {
+                        Dispatch(r, events, count);
+                    }
+                    return;
+                }
+                hasPwait2.store(false, std::memory_order_relaxed);
+            }
+#endif
+            int64_t ms = std::min<int64_t>((remaining + 999999) / 1000000, INT32_MAX);
+            count = epoll_wait(r->epollFd, events, REACTOR_EVENT_BATCH, int(ms));
+        }
+
+        if (count > 0)
+        {
+            Dispatch(r, events, count);
+        }
+    }
+
+    void ReactorWake(void * r)
+    {
+        uint64_t one = 1;
+        while (write(((reactor *) r)->wakeFd, &one, sizeof(one)) < 0 && errno == EINTR)
+        {
+        }
+    }
+}
+
+#else
+
+// No epoll, taco::net waits for sockets on blocking threads
+
+namespace taco
+{
+    reactor * ReactorCreate()
+    {
+        return nullptr;
+    }
+
+    void ReactorDestroy(reactor * r)
+    {
+        BASIS_UNUSED(r);
+    }
+
+    int ReactorWakeFd(reactor * r)
+    {
+        BASIS_UNUSED(r);
+        return -1;
+    }
+
+    void ReactorAdd(reactor * r, reactor_waiter * waiter)
+    {
+        BASIS_UNUSED(r);
+        BASIS_UNUSED(waiter);
+    }
+
+    bool ReactorBusy(reactor * r)
+    {
+        BASIS_UNUSED(r);
+        return false;
+    }
+
+    void ReactorPoll(reactor * r)
+    {
+        BASIS_UNUSED(r);
+    }
+
+    void ReactorWait(reactor * r, int64_t deadline)
+    {
+        BASIS_UNUSED(r);
+        BASIS_UNUSED(deadline);
+    }
+
+    void ReactorWake(void * r)
+    {
+        BASIS_UNUSED(r);
+    }
+}
+
+#endif
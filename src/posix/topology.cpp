@@ -0,0 +1,315 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
+#include <basis/assert.h>
+
+#include "../topology.h"
+
+#if !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+// Topology comes from sysfs:
+//   /sys/devices/system/cpu/online                              cpus that are up, less those not in our affinity mask
+//   /sys/devices/system/cpu/cpuN/topology/thread_siblings_list  hardware threads of cpuN's core
+//   /sys/devices/system/cpu/cpuN/cache/indexK/{level,shared_cpu_list}
+//   /sys/devices/system/node/nodeK/cpulist                      cpus of each NUMA node
+// Anything missing (containers, non Linux systems) leaves that level flat.
+
+namespace taco
+{
+    static bool ReadLine(const char * path, char * buffer, size_t size)
+    {
+        FILE * file = fopen(path, "r");
+        if (!file)
+        {
+            return false;
+        }
+        bool ok = fgets(buffer, int(size), file) != nullptr;
+        fclose(file);
+        return ok;
+    }
+
+    // Parses the kernel's cpu list format, eg "0-3,8,10-11"
+    static std::vector<uint32_t> ParseCpuList(const char * str)
+    {
+        std::vector<uint32_t> cpus;
+        while (*str)
+        {
+            char * end = nullptr;
+            unsigned long first = strtoul(str, &end, 10);
+            if (end == str)
+            {
+                break;
+            }
+
+            unsigned long last = first;
+            str = end;
+            if (*str == '-')
+            {
+                last = strtoul(str + 1, &end, 10);
+                str = end;
+            }
+            for (unsigned long cpu=first; cpu<=last; cpu++)
+            {
+                cpus.push_back(uint32_t(cpu));
+            }
+
+            if (*str != ',')
+            {
+                break;
+            }
+            str++;
+        }
+        return cpus;
+    }
+
+    static bool ReadCpuList(const char * path, std::vector<uint32_t> & cpus)
+    {
+        char buffer[4096];
+        if (!ReadLine(path, buffer, sizeof(buffer)))
+        {
+            return false;
+        }
+        cpus = ParseCpuList(buffer);
+        return !cpus.empty();
+    }
+
+    static uint32_t LowestOf(const std::vector<uint32_t> & cpus, uint32_t fallback)
+    {
+        return cpus.empty() ? fallback : *std::min_element(cpus.begin(), cpus.end());
+    }
+
+    // Drops the cpus the process isn't allowed to run on (taskset, cgroup cpusets). Returns false
+    // if that leaves none, keeps them all if the mask can't be read
+    static bool RestrictToAffinity(std::vector<uint32_t> & cpus)
+    {
+#if defined(__linux__)
+        uint32_t highest = *std::max_element(cpus.begin(), cpus.end());
+        cpu_set_t * mask = CPU_ALLOC(highest + 1);
+        size_t size = CPU_ALLOC_SIZE(highest + 1);
+        if (!mask)
+        {
+            return true;
+        }
+
+        CPU_ZERO_S(size, mask);
+        if (sched_getaffinity(0, size, mask) == 0)
+        {
+            cpus.erase(std::remove_if(cpus.begin(), cpus.end(), [=](uint32_t cpu) { return !CPU_ISSET_S(cpu, size, mask); }), cpus.end());
+        }
+        CPU_FREE(mask);
+        return !cpus.empty();
+#else
+        return true;
+#endif
+    }
+
+    cpu_topology ReadCpuTopology()
+    {
+        cpu_topology topology;
+        topology.nodeCount = 1;
+
+        std::vector<uint32_t> online;
+        if (!ReadCpuList("/sys/devices/system/cpu/online", online) || !RestrictToAffinity(online))
+        {
+            online.clear();
+            uint32_t count = std::max<uint32_t>(1, std::thread::hardware_concurrency());
+            for (uint32_t i=0; i<count; i++)
+            {
+                online.push_back(i);
+            }
+        }
+
+        char path[256];
+        std::vector<uint32_t> list;
+        for (uint32_t cpu : online)
+        {
+            cpu_info info = { cpu, cpu, 0, 0, 0 };
+
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", cpu);
+            if (ReadCpuList(path, list))
+            {
+                info.core = LowestOf(list, cpu);
+                info.thread = uint32_t(std::count_if(list.begin(), list.end(), [=](uint32_t c) { return c < cpu; }));
+            }
+
+            // The highest level cache listed is the last level one
+            uint32_t level = 0;
+            for (uint32_t index=0; ; index++)
+            {
+                char buffer[64];
+                snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/cache/index%u/level", cpu, index);
+                if (!ReadLine(path, buffer, sizeof(buffer)))
+                {
+                    break;
+                }
+
+                uint32_t l = uint32_t(atoi(buffer));
+                snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/cache/index%u/shared_cpu_list", cpu, index);
+                if (l >= level && ReadCpuList(path, list))
+                {
+                    level = l;
+                    info.cache = LowestOf(list, cpu);
+                }
+            }
+
+            topology.cpus.push_back(info);
+        }
+
+        DIR * nodes = opendir("/sys/devices/system/node");
+        if (nodes)
+        {
+            uint32_t highest = 0;
+            while (dirent * entry = readdir(nodes))
+            {
+                unsigned node = 0;
+                if (sscanf(entry->d_name, "node%u", &node) != 1)
+                {
+                    continue;
+                }
+
+                snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+                if (!ReadCpuList(path, list))
+                {
+                    continue;
+                }
+
+                highest = std::max(highest, uint32_t(node));
+                for (cpu_info & info : topology.cpus)
+                {
+                    if (std::find(list.begin(), list.end(), info.cpu) != list.end())
+                    {
+                        info.node = node;
+                    }
+                }
+            }
+            closedir(nodes);
+            topology.nodeCount = highest + 1;
+        }
+
+        std::stable_sort(topology.cpus.begin(), topology.cpus.end(), [](const cpu_info & a, const cpu_info & b) -> bool {
+            if (a.thread != b.thread) return a.thread < b.thread;
+            if (a.node != b.node) return a.node < b.node;
+            if (a.cache != b.cache) return a.cache < b.cache;
+            return a.core < b.core;
+        });
+
+        return topology;
+    }
+
+    void * NodeReserve(size_t size)
+    {
+        void * ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        BASIS_ASSERT(ptr != MAP_FAILED);
+        return ptr;
+    }
+
+    void NodeCommit(void * ptr, size_t size, uint32_t node)
+    {
+#if defined(__linux__) && defined(SYS_mbind)
+        // MPOL_PREFERRED, spelled out so we don't need the numa headers. Pages are only
+        // allocated when first touched, at which point the kernel picks them from node
+        static const int mpol_preferred = 1;
+        unsigned long mask[4] = {};
+        if (node < sizeof(mask) * 8)
+        {
+            mask[node / (sizeof(unsigned long) * 8)] = 1ul << (node % (sizeof(unsigned long) * 8));
+            // Best effort, fails harmlessly on kernels without NUMA support
+            syscall(SYS_mbind, ptr, size, mpol_preferred, mask, sizeof(mask) * 8, 0);
+        }
+#else
+        BASIS_UNUSED(ptr);
+        BASIS_UNUSED(size);
+        BASIS_UNUSED(node);
+#endif
+    }
+
+    void NodeRelease(void * ptr, size_t size)
+    {
+        munmap(ptr, size);
+    }
+
+#if defined(__linux__)
+    static bool SetAffinity(pthread_t thread, const std::vector<uint32_t> & cpus)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (uint32_t cpu : cpus)
+        {
+            if (cpu >= CPU_SETSIZE)
+            {
+                return false;
+            }
+            CPU_SET(cpu, &set);
+        }
+        return !cpus.empty() && pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+    }
+
+    bool SetThreadAffinity(std::thread & thread, const std::vector<uint32_t> & cpus)
+    {
+        return SetAffinity(thread.native_handle(), cpus);
+    }
+
+    bool SetThreadAffinity(const std::vector<uint32_t> & cpus)
+    {
+        return SetAffinity(pthread_self(), cpus);
+    }
+
+    std::vector<uint32_t> GetThreadAffinity()
+    {
+        std::vector<uint32_t> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+        {
+            for (uint32_t cpu=0; cpu<CPU_SETSIZE; cpu++)
+            {
+                if (CPU_ISSET(cpu, &set))
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+        return cpus;
+    }
+#else
+    // No way to pin threads to cpus (macOS only has affinity hints), threads stay where the OS puts them
+    bool SetThreadAffinity(std::thread & thread, const std::vector<uint32_t> & cpus)
+    {
+        BASIS_UNUSED(thread);
+        BASIS_UNUSED(cpus);
+        return false;
+    }
+
+    bool SetThreadAffinity(const std::vector<uint32_t> & cpus)
+    {
+        BASIS_UNUSED(cpus);
+        return false;
+    }
+
+    std::vector<uint32_t> GetThreadAffinity()
+    {
+        return std::vector<uint32_t>();
+    }
+#endif
+}
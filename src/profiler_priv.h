@@ -34,7 +34,7 @@ namespace taco
 #define TACO_PROFILER_EMIT_NAME_TASKID(type, taskid, message) \
     taco::profiler::Emit(type, taskid, message)
 
-#define TACO_PROFILER_EMIT_NAMED(type, message) \
+#define TACO_PROFILER_EMIT_NAME(type, message) \
     taco::profiler::Emit(type, message)
 
 #define TACO_PROFILER_EMIT_NONAME(type) \
@@ -0,0 +1,58 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+namespace taco
+{
+    struct fiber;
+
+    /// Readiness notification for a single scheduler (epoll on Linux). Fibers waiting on file
+    /// descriptors are registered with and resumed by the owning scheduler only, other threads
+    /// may only wake it. Its wake eventfd doubles as the notification fd of the scheduler's
+    /// io_ring, so an idle scheduler sleeps in one place for all of them.
+    struct reactor;
+
+    enum : uint32_t
+    {
+        reactor_read    = 1,
+        reactor_write   = 2
+    };
+
+    /// A fiber waiting for a file descriptor, lives on its stack
+    struct reactor_waiter
+    {
+        int                 fd;
+        uint32_t            interest;   ///< reactor_read or reactor_write
+        fiber *             f;
+        int                 error;      ///< errno if the fd couldn't be waited on
+        reactor_waiter *    next;
+    };
+
+    /// nullptr where not supported
+    reactor *   ReactorCreate       ();
+    void        ReactorDestroy      (reactor * r);
+    int         ReactorWakeFd       (reactor * r);
+
+    /// Resumes waiter->f once its fd is ready (or has an error or hung up). Must be called
+    /// with waiter->f suspended. If the fd can't be waited on it is resumed straight away with
+    /// waiter->error set
+    void        ReactorAdd          (reactor * r, reactor_waiter * waiter);
+
+    /// Whether any fiber is waiting on the reactor
+    bool        ReactorBusy         (reactor * r);
+    /// Resumes the fibers whose fds are ready, without waiting
+    void        ReactorPoll         (reactor * r);
+    /// Sleeps until an fd is ready, ReactorWake is called, the wake fd is otherwise signaled
+    /// or deadline (in steady clock nanoseconds) is reached, then resumes whoever is ready
+    void        ReactorWait         (reactor * r, int64_t deadline);
+    /// Makes ReactorWait return, from any thread. Takes the reactor as a void * so it can be
+    /// handed to parking_lot::park_external
+    void        ReactorWake         (void * r);
+}
@@ -5,7 +5,11 @@ http://divergentcoder.io
 This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
 */
 
+#include <algorithm>
 #include <utility>
+#include <new>
+#include <cstddef>
+#include <stdio.h>
 
 #include <basis/assert.h>
 #include <basis/thread_util.h>
@@ -20,192 +24,805 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 #include "thread_state.h"
 
 #include "work_queue.h"
+#include "availability_mask.h"
+#include "deadline_heap.h"
+#include "event_count.h"
+#include "io_ring.h"
+#include "parking_lot.h"
+#include "reactor.h"
+#include "topology.h"
+#include "block_pool.h"
 
 namespace taco
 {
+    enum class closure_storage : uint8_t
+    {
+        inline_buffer,
+        pooled,
+        heap
+    };
+
     struct task_entry
     {
-        task_fn         fn;
-        basis::string   name;
-        uint64_t        id;
+        internal::closure_fn    fn;
+        void *                  closure;
+        task_name               name;
+        uint64_t                id;
+        uint32_t                closureAlign;
+        closure_storage         storage;
+        stack_size              stack;
+        task_priority           priority;
+        int64_t                 deadline;       // steady clock nanoseconds, 0 for none
+        const void *            group;          // task_group the task belongs to, if any
+        // For a task its future may run inline, whether it was started (claim_started) and the
+        // number of references to it (from its queue and its future). 0 for any other task
+        std::atomic<uint32_t>   claim;
+
+        alignas(std::max_align_t) unsigned char buffer[TASK_INLINE_SIZE];
 
         void operator () ()
         {
             thread_state<task_entry *>() = this;
-            TACO_PROFILER_EMIT(profiler::event_type::start, name);
-            fn();
+            TACO_PROFILER_EMIT(profiler::event_type::start, name.c_str());
+            fn(closure, true);
             TACO_PROFILER_EMIT(profiler::event_type::complete);
         }
     };
 
-    typedef work_queue<task_entry, 256> shared_task_queue_t;
-    typedef work_queue<fiber*, 256> shared_fiber_queue_t;
-    typedef basis::chunk_queue<task_entry,basis::queue_access_policy::mpsc> private_task_queue_t;
+    // Task entries (and closures too big for their inline buffer) are recycled
+    // through per thread free lists so scheduling doesn't touch the heap
+    typedef block_pool<sizeof(task_entry), TASK_POOL_CACHE_LIMIT> task_pool;
+    typedef block_pool<TASK_OVERFLOW_SIZE, TASK_POOL_CACHE_LIMIT> closure_pool;
+
+    typedef work_deque<task_entry *> shared_task_queue_t;
+    typedef work_deque<fiber *> shared_fiber_queue_t;
+    typedef basis::chunk_queue<task_entry *,basis::queue_access_policy::mpsc> private_task_queue_t;
     typedef basis::chunk_queue<fiber *,basis::queue_access_policy::mpsc> private_fiber_queue_t;
 
-    struct scheduler_data
+    // Either a task to start or a fiber to resume
+    struct deadline_item
+    {
+        task_entry *    task;
+        fiber *         resume;
+    };
+
+    typedef deadline_heap<deadline_item> deadline_queue_t;
+
+    static int64_t DeadlineClock(task_deadline deadline)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    }
+
+    // One queue per task_priority
+    template<class QUEUE>
+    struct priority_queues
+    {
+        static_assert(task_priority_count == 3, "Expected one queue to be constructed per priority");
+
+        explicit priority_queues(size_t chunk)
+        :   levels { QUEUE(chunk), QUEUE(chunk), QUEUE(chunk) }
+        {}
+
+        QUEUE & operator [] (size_t level)
+        {
+            return levels[level];
+        }
+
+        QUEUE   levels[task_priority_count];
+    };
+
+    // Page aligned so each scheduler's data can be placed on its own NUMA node
+    struct alignas(SCHEDULER_DATA_ALIGNMENT) scheduler_data
     {
         scheduler_data()
-        :   privateTasks(PRIVATE_TASKQ_CHUNK_SIZE),
-            privateFibers(PRIVATE_FIBERQ_CHUNK_SIZE)
+        :   sharedTasks(PUBLIC_TASKQ_CHUNK_SIZE),
+            privateTasks(PRIVATE_TASKQ_CHUNK_SIZE),
+            sharedFibers(PUBLIC_FIBERQ_CHUNK_SIZE),
+            privateFibers(PRIVATE_FIBERQ_CHUNK_SIZE),
+            timers(uint64_t(DeadlineClock(std::chrono::steady_clock::now())) / TIMER_TICK_NS)
         {}
 
-        shared_task_queue_t         sharedTasks;
-        private_task_queue_t        privateTasks;
-        shared_fiber_queue_t        sharedFibers;
-        private_fiber_queue_t       privateFibers;
+        priority_queues<shared_task_queue_t>    sharedTasks;
+        priority_queues<private_task_queue_t>   privateTasks;
+        priority_queues<shared_fiber_queue_t>   sharedFibers;
+        priority_queues<private_fiber_queue_t>  privateFibers;
+
+        // Work with a deadline under scheduling_mode::deadline, other schedulers may steal
+        // from the shared heap
+        deadline_queue_t            deadlineShared;
+        deadline_queue_t            deadlinePrivate;
+
+        // Timers of fibers that went to sleep, or started a timed wait, on this scheduler. Only
+        // this scheduler advances the wheel, other threads just take the lock to cancel timers
+        std::mutex                  timerMutex;
+        timer_wheel                 timers;
+        std::atomic<uint32_t>       timerCount;
+        std::atomic<int64_t>        nextTimer;
+
+        // taco::io requests are submitted to and completed on this, nullptr if unsupported
+        io_ring *                   ring;
+        // Fibers waiting on sockets in taco::net, nullptr if unsupported. The ring signals its
+        // wake fd on completions
+        reactor *                   ioReactor;
+        uint32_t                    reactorCountdown;
 
         std::thread                 thread;
 
         std::atomic_bool            exitRequested;
-        std::condition_variable_any wakeCondition;
-        basis::shared_mutex         wakeMutex;
-        std::vector<fiber*>         inactive;
-        std::atomic<uint32_t>       privateTaskCount;
+        std::vector<fiber*>         inactive[stack_class_count];
+        std::atomic<uint32_t>       privateTaskCount[task_priority_count];
+        std::atomic<uint32_t>       privateFiberCount;
+
+        // Times in a row each level has been passed over for a higher one, see PRIORITY_AGING_LIMIT
+        uint32_t                    passedOver[task_priority_count];
+
+        task_entry *                handoff;
+        int                         handoffThreadId;
+        bool                        hasHandoff;
 
         uint32_t                    threadId;
+        uint32_t                    randomState;
+        cpu_info                    cpu;
+        bool                        isPinned;
+
+        // Every other scheduler, closest first. victimLevels[level] is the end of the
+        // schedulers at that topology_level, all of them are at system level if not pinned
+        std::vector<uint32_t>       victims;
+        uint32_t                    victimLevels[size_t(topology_level::count)];
         bool                        isActive;
-        bool                        isSignaled;
+
+        // Only written by the owning scheduler, atomic so GetSchedulerStats can read them
+        std::atomic<uint64_t>       stealAttempts;
+        std::atomic<uint64_t>       stealSuccesses;
+        std::atomic<uint64_t>       tasksStolen;
+        std::atomic<uint64_t>       fibersStolen;
+        std::atomic<uint64_t>       deadlineTasks;
+        std::atomic<uint64_t>       deadlineMisses;
     };
 
-    static std::atomic<uint32_t> GlobalSharedTaskCount;
+    // Which schedulers may have tasks in their shared queue, per priority
+    static availability_mask * SharedTaskMask[task_priority_count] = {};
+    // Which schedulers may have work in their shared deadline heap
+    static availability_mask * DeadlineMask = nullptr;
+    static bool DeadlineMode = false;
     static scheduler_data * SchedulerList = nullptr;
     static uint32_t ThreadCount = 0;
+    static idle_policy IdlePolicy;
+    static cpu_topology Topology;
+    static std::vector<uint32_t> BlockingCpus;
+    static std::vector<uint32_t> MainAffinity;
+    static parking_lot * Parking = nullptr;
     static std::atomic<uint64_t> GlobalTaskCounter;
 
     struct blocking_thread
     {
         std::thread                 thread;
-        std::mutex                  workMutex;
-        std::condition_variable     workCondition;
-        bool                        exitRequested;
-        fiber *                     current;
+        std::atomic<bool>           finished;
     };
 
-    basis::ring_queue<blocking_thread*,basis::queue_access_policy::mpmc> BlockingThreads(BLOCKING_THREAD_LIMIT);
-    std::atomic<int> BlockingThreadCount(0);
+    // Fibers in blocking sections waiting for a thread to run on. Threads are started on demand
+    // up to the limit, idle ones sleep on BlockingSignal and exit after the idle timeout
+    struct blocking_pool
+    {
+        blocking_pool()
+        :   backlog(BLOCKING_BACKLOG_LIMIT)
+        {}
+
+        basis::ring_queue<fiber*,basis::queue_access_policy::mpmc> backlog;
+        // Backlog slots claimed by BeginBlocking, so pushing in onExit can't fail
+        std::atomic<uint32_t>       reserved { 0 };
+        // Fibers pushed to the backlog and not yet taken off it
+        std::atomic<uint32_t>       pending { 0 };
+        std::atomic<uint32_t>       idle { 0 };
+        std::atomic<uint32_t>       threadCount { 0 };
+        std::atomic<uint32_t>       threadLimit { 32 };
+        std::atomic<int64_t>        idleTimeout { -1 };
+        std::atomic<bool>           exitRequested { false };
+        event_count                 signal;
+
+        // Only for starting and joining threads, never held while handing off work
+        std::mutex                  threadsMutex;
+        std::vector<blocking_thread*> threads;
+
+        std::atomic<uint64_t>       sections { 0 };
+        std::atomic<uint64_t>       queued { 0 };
+        std::atomic<uint64_t>       handoffNs { 0 };
+        std::atomic<uint64_t>       maxHandoffNs { 0 };
+        std::atomic<uint64_t>       blockedNs { 0 };
+        std::atomic<uint64_t>       maxBlockedNs { 0 };
+        std::atomic<uint64_t>       threadsStarted { 0 };
+        std::atomic<uint64_t>       threadsReaped { 0 };
+    };
+
+    static blocking_pool BlockingPool;
 
     static void WorkerLoop();
+    static void StopBlockingThreads();
 
     uint64_t GenTaskId()
     {
         return GlobalTaskCounter.fetch_add(1);
     }
 
-    static bool HasTasks()
+    static bool HasTasks(size_t level)
     {
-        uint32_t shared_count = GlobalSharedTaskCount.load(std::memory_order_relaxed);
-        uint32_t private_count = thread_state<scheduler_data*>()->privateTaskCount.load(std::memory_order_relaxed);
+        uint32_t private_count = thread_state<scheduler_data*>()->privateTaskCount[level].load(std::memory_order_relaxed);
+        return (private_count > 0) || SharedTaskMask[level]->any();
+    }
 
-        return (shared_count > 0) || (private_count > 0);
+    static bool HasTasks()
+    {
+        for (size_t level=0; level<task_priority_count; level++)
+        {
+            if (HasTasks(level))
+            {
+                return true;
+            }
+        }
+        return false;
     }
 
-    static bool GetPrivateTask(task_entry & out)
+    static bool HasDeadlineWork(scheduler_data * s)
     {
-        return thread_state<scheduler_data*>()->privateTasks.pop_front(out);
+        return DeadlineMode && (!s->deadlinePrivate.empty() || DeadlineMask->any());
     }
 
-    static bool GetSharedTask(task_entry & out)
+    // Whether s has anything at all to do, including resuming fibers or exiting
+    static bool HasWork(scheduler_data * s)
     {
-        uint32_t start = thread_state<scheduler_data*>()->threadId;
-        uint32_t id = start;
-        do
+        if (s->exitRequested.load(std::memory_order_relaxed) || HasTasks() || HasDeadlineWork(s) ||
+            (s->privateFiberCount.load(std::memory_order_relaxed) > 0) || (s->ring && IoRingReady(s->ring)))
+        {
+            return true;
+        }
+
+        for (shared_fiber_queue_t & queue : s->sharedFibers.levels)
         {
-            if ((id == start) && SchedulerList[id].sharedTasks.pop(out))
+            if (queue.size() > 0)
             {
-                GlobalSharedTaskCount.fetch_sub(1, std::memory_order_relaxed);
                 return true;
-            } 
-            else if ((id != start) && SchedulerList[id].sharedTasks.steal(out))
+            }
+        }
+        return false;
+    }
+
+    static void FreeTask(task_entry * task)
+    {
+        switch (task->storage)
+        {
+        case closure_storage::pooled:
+            closure_pool::Free(task->closure);
+            break;
+        case closure_storage::heap:
+            ::operator delete(task->closure, std::align_val_t(task->closureAlign));
+            break;
+        default:
+            break;
+        }
+        task->~task_entry();
+        task_pool::Free(task);
+    }
+
+    static constexpr uint32_t claim_started = uint32_t(1) << 31;
+
+    // Whoever gets to start a task its future may also run, only one of them does
+    static bool ClaimTask(task_entry * task)
+    {
+        return task->claim.load(std::memory_order_relaxed) == 0 ||
+            !(task->claim.fetch_or(claim_started, std::memory_order_acq_rel) & claim_started);
+    }
+
+    static void ReleaseTask(task_entry * task)
+    {
+        if (task->claim.load(std::memory_order_relaxed) == 0 ||
+            (task->claim.fetch_sub(1, std::memory_order_acq_rel) & ~claim_started) == 1)
+        {
+            FreeTask(task);
+        }
+    }
+
+    // Destroys a task that is never going to be run
+    static void DiscardTask(task_entry * task)
+    {
+        if (ClaimTask(task))
+        {
+            task->fn(task->closure, false);
+        }
+        ReleaseTask(task);
+    }
+
+    static bool GetPrivateTask(size_t level, task_entry *& out)
+    {
+        scheduler_data * s = thread_state<scheduler_data*>();
+        if (s->privateTasks[level].pop_front(out))
+        {
+            s->privateTaskCount[level].fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    static void AddStat(std::atomic<uint64_t> & stat, uint64_t n)
+    {
+        stat.store(stat.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    // xorshift32
+    static uint32_t NextRandom(scheduler_data * s)
+    {
+        uint32_t x = s->randomState;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        s->randomState = x;
+        return x;
+    }
+
+    // Random number in [0, n)
+    static uint32_t RandomBelow(scheduler_data * s, uint32_t n)
+    {
+        return uint32_t((uint64_t(NextRandom(s)) * n) >> 32);
+    }
+
+    // Unpinned schedulers can be running anywhere, so the cpu they were assigned says nothing
+    // about how close they are
+    static void BuildVictimList(scheduler_data * s, bool pinned)
+    {
+        s->victims.clear();
+        for (size_t level=0; level<size_t(topology_level::count); level++)
+        {
+            for (uint32_t id=0; id<ThreadCount; id++)
             {
-                GlobalSharedTaskCount.fetch_sub(1, std::memory_order_relaxed);
-                return true;
+                topology_level distance = pinned ? TopologyDistance(s->cpu, SchedulerList[id].cpu) : topology_level::system;
+                if (id != s->threadId && size_t(distance) == level)
+                {
+                    s->victims.push_back(id);
+                }
             }
-            id = (id + 1) < ThreadCount ? (id + 1) : 0;
-        } while (id != start && GlobalSharedTaskCount > 0);
+            s->victimLevels[level] = uint32_t(s->victims.size());
+        }
+    }
+
+    static bool Contains(const std::vector<uint32_t> & cpus, uint32_t cpu)
+    {
+        return std::find(cpus.begin(), cpus.end(), cpu) != cpus.end();
+    }
+
+    // Deals cpus out round robin across groups. A cpu's rank is how many cpus before it (with the
+    // same hardware thread index) share its group, so sorting by rank takes one from each group in turn
+    template<class GROUP>
+    static void DealAcross(std::vector<cpu_info> & cpus, GROUP group)
+    {
+        std::vector<std::pair<uint32_t, cpu_info>> ranked;
+        for (const cpu_info & info : cpus)
+        {
+            uint32_t rank = 0;
+            for (const std::pair<uint32_t, cpu_info> & r : ranked)
+            {
+                if (r.second.thread == info.thread && group(r.second) == group(info))
+                {
+                    rank++;
+                }
+            }
+            ranked.emplace_back(rank, info);
+        }
+
+        std::stable_sort(ranked.begin(), ranked.end(), [&](const std::pair<uint32_t, cpu_info> & a, const std::pair<uint32_t, cpu_info> & b) -> bool {
+            if (a.second.thread != b.second.thread) return a.second.thread < b.second.thread;
+            if (a.first != b.first) return a.first < b.first;
+            return group(a.second) < group(b.second);
+        });
+
+        for (size_t i=0; i<cpus.size(); i++)
+        {
+            cpus[i] = ranked[i].second;
+        }
+    }
+
+    // The cpus schedulers are assigned to, scheduler i gets the (i % size)th one. Empty if the
+    // policy leaves nothing to pin to
+    static std::vector<cpu_info> PlacementOrder(const affinity_policy & affinity)
+    {
+        if (affinity.mode == affinity_mode::none)
+        {
+            return Topology.cpus;
+        }
+
+        std::vector<cpu_info> cpus;
+        if (affinity.mode == affinity_mode::list)
+        {
+            for (uint32_t cpu : affinity.cpus)
+            {
+                auto it = std::find_if(Topology.cpus.begin(), Topology.cpus.end(), [=](const cpu_info & info) -> bool {
+                    return info.cpu == cpu;
+                });
+                if (!Contains(affinity.exclude, cpu))
+                {
+                    // Unknown cpus are kept, pinning to them fails and shows in GetCpuMapping
+                    cpus.push_back(it != Topology.cpus.end() ? *it : cpu_info { cpu, cpu, cpu, 0, 0 });
+                }
+            }
+        }
+        else
+        {
+            for (const cpu_info & info : Topology.cpus)
+            {
+                if (!Contains(affinity.exclude, info.cpu))
+                {
+                    cpus.push_back(info);
+                }
+            }
+        }
+        if (affinity.mode == affinity_mode::compact)
+        {
+            std::stable_sort(cpus.begin(), cpus.end(), [](const cpu_info & a, const cpu_info & b) -> bool {
+                if (a.node != b.node) return a.node < b.node;
+                if (a.cache != b.cache) return a.cache < b.cache;
+                if (a.core != b.core) return a.core < b.core;
+                return a.thread < b.thread;
+            });
+        }
+        else if (affinity.mode == affinity_mode::scatter)
+        {
+            // Topology order already has the first hardware thread of every core ahead of any
+            // siblings, spread each of those rounds over the caches of a node and then over nodes
+            DealAcross(cpus, [](const cpu_info & info) -> uint32_t { return info.cache; });
+            DealAcross(cpus, [](const cpu_info & info) -> uint32_t { return info.node; });
+        }
+        return cpus;
+    }
+
+    // Keep SharedTaskMask in sync with the shared task queues, shared fiber queues are not tracked
+    static bool MayHaveItems(shared_task_queue_t &, size_t level, uint32_t id)
+    {
+        return SharedTaskMask[level]->test(id);
+    }
+
+    static bool MayHaveItems(shared_fiber_queue_t &, size_t, uint32_t)
+    {
+        return true;
+    }
+
+    static void OnPushed(shared_task_queue_t &, size_t level, uint32_t id)
+    {
+        SharedTaskMask[level]->mark(id);
+    }
+
+    static void OnPushed(shared_fiber_queue_t &, size_t, uint32_t)
+    {}
+
+    // Only called on other schedulers' queues and by a scheduler about to go to sleep - a
+    // scheduler running one task at a time would otherwise flip its bit on every task
+    static void OnFoundEmpty(shared_task_queue_t & queue, size_t level, uint32_t id)
+    {
+        SharedTaskMask[level]->clear(id, [&]() -> bool { return queue.size() == 0; });
+    }
+
+    static void OnFoundEmpty(shared_fiber_queue_t &, size_t, uint32_t)
+    {}
+
+    // Moves up to half of the victim's queue at the given level over to the local one in one go,
+    // out receives the oldest of the stolen items
+    template<class QUEUE, class ITEM>
+    static bool StealFrom(QUEUE scheduler_data::* queue, size_t level, uint32_t victim, ITEM & out, std::atomic<uint64_t> & stolen)
+    {
+        scheduler_data * s = thread_state<scheduler_data*>();
+        ITEM items[STEAL_BATCH_LIMIT];
+
+        AddStat(s->stealAttempts, 1);
+        int64_t count = (SchedulerList[victim].*queue)[level].steal_half(items, STEAL_BATCH_LIMIT);
+        if (count == 0)
+        {
+            OnFoundEmpty((SchedulerList[victim].*queue)[level], level, victim);
+            return false;
+        }
+
+        AddStat(s->stealSuccesses, 1);
+        AddStat(stolen, uint64_t(count));
+        out = items[0];
+        if (count > 1)
+        {
+            (s->*queue)[level].push(items + 1, count - 1);
+            OnPushed((s->*queue)[level], level, s->threadId);
+        }
+        return true;
+    }
+
+    // Pops from the local queue, falling back to stealing from up to STEAL_ATTEMPT_LIMIT randomly
+    // chosen schedulers at each level of the topology, closest first. The other schedulers are then
+    // swept, still closest first and starting from a random one within each level, for as long as
+    // sweep says there is known to be something left to find
+    template<class QUEUE, class ITEM, class SWEEP>
+    static bool PopOrSteal(QUEUE scheduler_data::* queue, size_t level, std::atomic<uint64_t> scheduler_data::* stolen, ITEM & out, SWEEP sweep)
+    {
+        scheduler_data * s = thread_state<scheduler_data*>();
+        if ((s->*queue)[level].pop(out))
+        {
+            return true;
+        }
+
+        uint32_t begin = 0;
+        for (size_t distance=0; distance<size_t(topology_level::count); distance++)
+        {
+            uint32_t count = s->victimLevels[distance] - begin;
+            for (uint32_t i=0; i<STEAL_ATTEMPT_LIMIT && i<count; i++)
+            {
+                uint32_t id = s->victims[begin + RandomBelow(s, count)];
+                if (MayHaveItems((SchedulerList[id].*queue)[level], level, id) && StealFrom(queue, level, id, out, s->*stolen))
+                {
+                    return true;
+                }
+            }
+            begin += count;
+        }
+
+        begin = 0;
+        for (size_t distance=0; distance<size_t(topology_level::count); distance++)
+        {
+            uint32_t count = s->victimLevels[distance] - begin;
+            uint32_t offset = count > 0 ? RandomBelow(s, count) : 0;
+            for (uint32_t i=0; i<count && sweep(); i++)
+            {
+                uint32_t id = s->victims[begin + (offset + i) % count];
+                if (MayHaveItems((SchedulerList[id].*queue)[level], level, id) && StealFrom(queue, level, id, out, s->*stolen))
+                {
+                    return true;
+                }
+            }
+            begin += count;
+        }
+
         return false;
     }
 
+    static bool GetSharedTask(size_t level, task_entry *& out)
+    {
+        // Sleeping schedulers are only woken when tasks are pushed, so keep looking for as
+        // long as the mask says there is a shared task somewhere
+        return PopOrSteal(&scheduler_data::sharedTasks, level, &scheduler_data::tasksStolen, out, [=]() -> bool {
+            return SharedTaskMask[level]->any();
+        });
+    }
+
+    // The order to look through the priority levels in: highest first, except that the lowest
+    // level that has been passed over PRIORITY_AGING_LIMIT times in a row goes ahead of the rest
+    static void ServiceOrder(scheduler_data * s, size_t (&order)[task_priority_count])
+    {
+        size_t aged = 0;
+        for (size_t level=task_priority_count - 1; level>0; level--)
+        {
+            if (s->passedOver[level] >= PRIORITY_AGING_LIMIT)
+            {
+                aged = level;
+                break;
+            }
+        }
+
+        order[0] = aged;
+        for (size_t level=0, n=1; level<task_priority_count; level++)
+        {
+            if (level != aged)
+            {
+                order[n++] = level;
+            }
+        }
+    }
+
+    static void OnServed(scheduler_data * s, size_t level)
+    {
+        s->passedOver[level] = 0;
+        for (size_t lower=level + 1; lower<task_priority_count; lower++)
+        {
+            s->passedOver[lower] = std::min<uint32_t>(s->passedOver[lower] + 1, PRIORITY_AGING_LIMIT);
+        }
+    }
+
+    // Wakes s if it is parked, must be called after whatever it is being woken for is visible.
+    // Costs nothing more than a fence and a load if it is awake
     static void SignalScheduler(scheduler_data * s)
     {
+        Parking->unpark(s->threadId);
+    }
+
+    // Wakes up to count parked schedulers to help with shared tasks, returns the number woken
+    static size_t AskForHelp(size_t count)
+    {
+        size_t woken = Parking->unpark_any(count, thread_state<scheduler_data*>()->threadId);
+        if (woken > 0)
+        {
+            TACO_PROFILER_LOG("Help Requested");
+        }
+        return woken;
+    }
+
+    static void UpdateTimers(scheduler_data * s)
+    {
+        uint64_t tick = s->timers.next_tick();
+        s->timerCount.store(uint32_t(s->timers.size()), std::memory_order_relaxed);
+        s->nextTimer.store(tick == timer_wheel::never ? INT64_MAX : int64_t(tick * TIMER_TICK_NS), std::memory_order_relaxed);
+    }
+
+    static bool HasDueTimers(scheduler_data * s, int64_t now)
+    {
+        return s->timerCount.load(std::memory_order_relaxed) > 0 && s->nextTimer.load(std::memory_order_relaxed) <= now;
+    }
+
+    static void WakeSleeper(timer_entry * timer)
+    {
+        Resume((fiber *) timer->context);
+    }
+
+    // Fires s's timers that are due, which resumes whoever was waiting on them
+    static void ProcessTimers(scheduler_data * s)
+    {
+        if (s->timerCount.load(std::memory_order_relaxed) == 0)
+        {
+            return;
+        }
+
+        int64_t now = DeadlineClock(std::chrono::steady_clock::now());
+        if (!HasDueTimers(s, now))
         {
-            s->wakeMutex.lock_shared();
-            s->isSignaled = true;
-            s->wakeMutex.unlock_shared();
+            return;
         }
 
-        s->wakeCondition.notify_one();
+        // Fired under the lock, so CancelTimer can't return while a timer is still firing
+        std::lock_guard<std::mutex> lock(s->timerMutex);
+        s->timers.advance(uint64_t(now) / TIMER_TICK_NS, [](timer_entry * timer) -> void {
+            timer->fn(timer);
+        });
+        UpdateTimers(s);
+    }
+
+    static void PushDeadlineWork(scheduler_data * s, bool shared, int64_t deadline, const deadline_item & item)
+    {
+        if (shared)
+        {
+            s->deadlineShared.push(deadline, item);
+            DeadlineMask->mark(s->threadId);
+        }
+        else
+        {
+            s->deadlinePrivate.push(deadline, item);
+        }
     }
 
-    static void AskForHelp(size_t count)
+    // Pops the most urgent deadline work this scheduler can run - the earliest of its own private
+    // heap and every shared one, so stealing always goes for the most urgent work around
+    static bool GetDeadlineWork(scheduler_data * s, deadline_item & out, int & threadId)
     {
-        TACO_PROFILER_LOG("Help Requested");
+        deadline_queue_t * source = &s->deadlinePrivate;
+        uint32_t owner = s->threadId;
+        int64_t earliest = source->earliest();
 
-        uint32_t start = thread_state<scheduler_data*>()->threadId;
-        uint32_t id = (start + 1) < ThreadCount ? (start + 1) : 0;
-        while (count > 0 && id != start)
+        if (DeadlineMask->any())
         {
-            if (SchedulerList[id].isActive)
+            for (uint32_t id=0; id<ThreadCount; id++)
             {
-                SignalScheduler(SchedulerList + id);
-                count--;
+                if (DeadlineMask->test(id) && SchedulerList[id].deadlineShared.earliest() < earliest)
+                {
+                    source = &SchedulerList[id].deadlineShared;
+                    owner = id;
+                    earliest = source->earliest();
+                }
             }
-            id = (id + 1) < ThreadCount ? (id + 1) : 0;
         }
+
+        if (earliest == deadline_queue_t::none || !source->pop(out))
+        {
+            return false;
+        }
+
+        if (source == &s->deadlinePrivate)
+        {
+            threadId = int(s->threadId);
+            return true;
+        }
+
+        if (source->empty())
+        {
+            DeadlineMask->clear(owner, [=]() -> bool { return source->empty(); });
+        }
+        if (owner != s->threadId)
+        {
+            AddStat(s->stealAttempts, 1);
+            AddStat(s->stealSuccesses, 1);
+            AddStat(out.task ? s->tasksStolen : s->fibersStolen, 1);
+        }
+        threadId = -int(s->threadId + 1);
+        return true;
+    }
+
+    static void PushPrivateFiber(scheduler_data * s, fiber * f)
+    {
+        fiber_base * base = (fiber_base *) f;
+        if (DeadlineMode && base->deadline != 0)
+        {
+            PushDeadlineWork(s, false, base->deadline, { nullptr, f });
+            return;
+        }
+
+        s->privateFibers[size_t(base->priority)].push_back(f);
+        s->privateFiberCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void PushSharedFiber(scheduler_data * s, fiber * f)
+    {
+        fiber_base * base = (fiber_base *) f;
+        if (DeadlineMode && base->deadline != 0)
+        {
+            PushDeadlineWork(s, true, base->deadline, { nullptr, f });
+            return;
+        }
+
+        s->sharedFibers[size_t(base->priority)].push(f);
+    }
+
+    static bool PopPrivateFiber(size_t level, fiber *& f)
+    {
+        scheduler_data * s = thread_state<scheduler_data*>();
+        if (s->privateFibers[level].pop_front(f))
+        {
+            s->privateFiberCount.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
     }
 
-    static fiber * GetInactiveFiber()
+    static fiber * GetInactiveFiber(stack_size size = stack_size::standard)
     {
-        size_t count = thread_state<scheduler_data*>()->inactive.size();
+        std::vector<fiber*> & inactive = thread_state<scheduler_data*>()->inactive[size_t(size)];
+        size_t count = inactive.size();
         if (count > 0)
         {
-            fiber * f = thread_state<scheduler_data*>()->inactive[count - 1];
-            thread_state<scheduler_data*>()->inactive.pop_back();
+            fiber * f = inactive[count - 1];
+            inactive.pop_back();
             return f;
         }
-        return FiberCreate(&WorkerLoop);
+        return FiberCreate(&WorkerLoop, size);
+    }
+
+    static void MakeInactive(fiber * f)
+    {
+        fiber_base * base = (fiber_base *) f;
+        thread_state<scheduler_data*>()->inactive[size_t(base->stack)].push_back(f);
     }
 
-    static fiber * GetSharedFiber()
+    // Shared fibers are only pushed by the scheduler that owns the queue and it always checks
+    // its own queue first, so stealing them is purely opportunistic and only done once there is
+    // nothing left to do locally at any level
+    static fiber * StealFiber()
     {
         fiber * ret = nullptr;
-        uint32_t start = thread_state<scheduler_data*>()->threadId;
-        uint32_t id = start;
-        do
+        for (size_t level=0; level<task_priority_count && !ret; level++)
         {
-            if ((id == start) && SchedulerList[id].sharedFibers.pop(ret))
-            {
-                return ret;
-            }
-            else if ((id != start) && SchedulerList[id].sharedFibers.steal(ret))
-            {
-                return ret;
-            }
-            id = (id + 1) < ThreadCount ? (id + 1) : 0;
-        } while (id != start);
-        return nullptr;
+            PopOrSteal(&scheduler_data::sharedFibers, level, &scheduler_data::fibersStolen, ret, []() -> bool {
+                return false;
+            });
+        }
+        return ret;
     }
 
-    static fiber * GetNextScheduledFiber()
+    static fiber * GetNextScheduledFiber(size_t level)
     {
         fiber * ret = nullptr;
 
         // TODO:  Something more intelligent...
         basis_thread_local static int source = 0;
 
+        shared_fiber_queue_t & shared = thread_state<scheduler_data*>()->sharedFibers[level];
         if (source == 0)
         {
-            if (!thread_state<scheduler_data*>()->privateFibers.pop_front(ret))
+            if (!PopPrivateFiber(level, ret))
             {
-                ret = GetSharedFiber();
+                shared.pop(ret);
             }
         }
         else
         {
-            ret = GetSharedFiber();
-            if (!ret)
+            if (!shared.pop(ret))
             {
-                thread_state<scheduler_data*>()->privateFibers.pop_front(ret);
+                PopPrivateFiber(level, ret);
             }
         }
         source = (ret != nullptr) ? (source ^ 1) : source;
@@ -213,18 +830,43 @@ namespace taco
         return ret;
     }
 
+    // Resumes the fiber with the highest priority, unless there is a task at the same or a
+    // higher level in which case a fresh fiber is used to go and run it
     static fiber * GetNextFiber()
     {
-        fiber * next = HasTasks() ? GetInactiveFiber() : GetNextScheduledFiber();
-        next = (next == nullptr) ? GetInactiveFiber() : next;
-        return next;
+        scheduler_data * s = thread_state<scheduler_data*>();
+        if (HasDeadlineWork(s))
+        {
+            return GetInactiveFiber();
+        }
+
+        size_t order[task_priority_count];
+        ServiceOrder(s, order);
+
+        for (size_t level : order)
+        {
+            if (HasTasks(level))
+            {
+                return GetInactiveFiber();
+            }
+
+            fiber * next = GetNextScheduledFiber(level);
+            if (next)
+            {
+                OnServed(s, level);
+                return next;
+            }
+        }
+
+        fiber * next = StealFiber();
+        return (next == nullptr) ? GetInactiveFiber() : next;
     }
 
     static void CheckForExitCondition()
     {
         if (thread_state<scheduler_data*>()->exitRequested)
         {
-            thread_state<scheduler_data*>()->inactive.push_back(FiberCurrent());
+            MakeInactive(FiberCurrent());
             FiberInvoke(FiberRoot());
             BASIS_ASSERT_FAILED;
         }
@@ -244,64 +886,252 @@ namespace taco
         TACO_PROFILER_EMIT(profiler::event_type::resume);
     }
 
+    static void RunClaimedTask(task_entry * todo, int threadId)
+    {
+        fiber_base * base = (fiber_base *) FiberCurrent();
+
+        base->threadId = threadId;
+        base->data = nullptr;
+        base->name = todo->name.c_str();
+        base->priority = todo->priority;
+        base->deadline = todo->deadline;
+        (*todo)();
+
+        if (base->deadline != 0)
+        {
+            // May have been resumed on another scheduler since it started
+            scheduler_data * s = thread_state<scheduler_data*>();
+            AddStat(s->deadlineTasks, 1);
+            if (DeadlineClock(std::chrono::steady_clock::now()) > base->deadline)
+            {
+                AddStat(s->deadlineMisses, 1);
+                TACO_PROFILER_EMIT(profiler::event_type::deadline_miss, todo->id, todo->name.c_str());
+            }
+        }
+
+        base->name = "";
+        base->deadline = 0;
+        ReleaseTask(todo);
+    }
+
+    static void RunTask(task_entry * todo, int threadId)
+    {
+        if (!ClaimTask(todo))
+        {
+            // Already run by whoever awaited its future
+            ReleaseTask(todo);
+            return;
+        }
+        RunClaimedTask(todo, threadId);
+    }
+
+    // Runs a task as part of the current one, which gets its own details back afterwards
+    static void RunTaskInline(task_entry * task)
+    {
+        fiber_base * base = (fiber_base *) FiberCurrent();
+        task_entry * current = thread_state<task_entry *>();
+        void * data = base->data;
+        const char * name = base->name;
+        task_priority taskPriority = base->priority;
+        int64_t deadline = base->deadline;
+
+        base->inlineDepth++;
+        RunClaimedTask(task, base->threadId);
+        base->inlineDepth--;
+
+        thread_state<task_entry *>() = current;
+        base->data = data;
+        base->name = name;
+        base->priority = taskPriority;
+        base->deadline = deadline;
+    }
+
+    // Bound tasks would take an inline task with them to their own scheduler, and each nested
+    // one runs further down the same stack
+    static bool CanRunInline(stack_size stack)
+    {
+        if (!IsSchedulerThread())
+        {
+            return false;
+        }
+        fiber_base * base = (fiber_base *) FiberCurrent();
+        return base->threadId < 0 && base->inlineDepth < TASK_INLINE_DEPTH && stack <= base->stack;
+    }
+
     static bool WorkerIteration()
     {
         fiber * self = FiberCurrent();
         fiber_base * base = (fiber_base *) self;
 
-        task_entry todo;
-        if (GetPrivateTask(todo))
-        {
-            thread_state<scheduler_data*>()->privateTaskCount.fetch_sub(1, std::memory_order_relaxed);
-            base->threadId = thread_state<scheduler_data*>()->threadId;
-            base->data = nullptr;
-            base->name = todo.name;
-            todo();
-            base->name = "";
-            basis::strfree(todo.name);
+        scheduler_data * s = thread_state<scheduler_data*>();
+        task_entry * todo = nullptr;
+        int threadId = 0;
+        deadline_item urgent;
 
-            return true;
+        ProcessTimers(s);
+        if (s->ring)
+        {
+            IoRingPoll(s->ring);
         }
-        else if (GetSharedTask(todo))
+        if (s->ioReactor && ReactorBusy(s->ioReactor) && --s->reactorCountdown == 0)
         {
-            base->threadId = -int(thread_state<scheduler_data*>()->threadId + 1);
-            base->data = nullptr;
-            base->name = todo.name;
-            todo();
-            base->name = "";
-            basis::strfree(todo.name);
+            // Otherwise only looked at once out of work, which a busy scheduler never is
+            s->reactorCountdown = REACTOR_POLL_INTERVAL;
+            ReactorPoll(s->ioReactor);
+        }
 
-            return true;
+        if (s->hasHandoff)
+        {
+            // Handed a task that needed a larger stack than the fiber that picked it up
+            s->hasHandoff = false;
+            todo = s->handoff;
+            threadId = s->handoffThreadId;
         }
-        else
+        else if (DeadlineMode && GetDeadlineWork(s, urgent, threadId))
         {
-            fiber * next = GetNextScheduledFiber();
-            if (next)
+            if (urgent.resume)
             {
-                thread_state<scheduler_data*>()->inactive.push_back(self);
-                FiberSwitch(next);
+                MakeInactive(self);
+                FiberSwitch(urgent.resume);
                 return true;
             }
+            todo = urgent.task;
         }
-        return false;
+        else
+        {
+            // Within a level new tasks go ahead of resuming fibers
+            size_t order[task_priority_count];
+            ServiceOrder(s, order);
+
+            for (size_t level : order)
+            {
+                if (GetPrivateTask(level, todo))
+                {
+                    threadId = int(s->threadId);
+                }
+                else if (GetSharedTask(level, todo))
+                {
+                    threadId = -int(s->threadId + 1);
+                }
+                else if (fiber * next = GetNextScheduledFiber(level))
+                {
+                    OnServed(s, level);
+                    MakeInactive(self);
+                    FiberSwitch(next);
+                    return true;
+                }
+                else
+                {
+                    // Nothing waiting, so it isn't being passed over
+                    s->passedOver[level] = 0;
+                    continue;
+                }
+
+                OnServed(s, level);
+                break;
+            }
+
+            if (!todo)
+            {
+                fiber * next = StealFiber();
+                if (next)
+                {
+                    MakeInactive(self);
+                    FiberSwitch(next);
+                    return true;
+                }
+                return false;
+            }
+        }
+
+        if (todo->stack > base->stack)
+        {
+            s->handoff = todo;
+            s->handoffThreadId = threadId;
+            s->hasHandoff = true;
+
+            MakeInactive(self);
+            FiberSwitch(GetInactiveFiber(todo->stack));
+            return true;
+        }
+
+        RunTask(todo, threadId);
+
+        if (base->stack != stack_size::standard)
+        {
+            // Don't keep using an oversized stack for general work, put it back
+            // so it is available for the next task that actually needs it
+            MakeInactive(self);
+            FiberSwitch(GetInactiveFiber());
+        }
+
+        return true;
     }
 
     static void WorkerLoop()
     {
+        // Number of polls since we last found work, see idle_policy
+        uint32_t idleCount = 0;
+
         for(;;)
         {
             CheckForExitCondition();
 
-            if (!WorkerIteration())
+            if (WorkerIteration())
+            {
+                idleCount = 0;
+            }
+            else if (idleCount < IdlePolicy.spin_count + IdlePolicy.yield_count)
             {
-                std::unique_lock<basis::shared_mutex> lock(thread_state<scheduler_data*>()->wakeMutex);
-                if (!thread_state<scheduler_data*>()->isSignaled)
+                if (idleCount < IdlePolicy.spin_count)
+                {
+                    basis::cpu_yield();
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+                idleCount++;
+            }
+            else
+            {
+                idleCount = 0;
+
+                scheduler_data * s = thread_state<scheduler_data*>();
+                for (size_t level=0; level<task_priority_count; level++)
+                {
+                    OnFoundEmpty(s->sharedTasks[level], level, s->threadId);
+                }
+                DeadlineMask->clear(s->threadId, [&]() -> bool { return s->deadlineShared.empty(); });
+
+                // Anything that shows up after this last look will see us as parked and wake us
+                // Timers are only ever added by this scheduler, so the next one can't change while parked
+                Parking->prepare_park(s->threadId);
+                int64_t nextTimer = s->nextTimer.load(std::memory_order_relaxed);
+                if (HasWork(s) || HasDueTimers(s, DeadlineClock(std::chrono::steady_clock::now())))
+                {
+                    Parking->cancel_park(s->threadId);
+                }
+                else
                 {
-                    TACO_PROFILER_EMIT(profiler::event_type::sleep)
-                    thread_state<scheduler_data*>()->wakeCondition.wait(lock);
-                    TACO_PROFILER_EMIT(profiler::event_type::awake)
+                    TACO_PROFILER_EMIT(profiler::event_type::sleep);
+                    if (s->ioReactor && (ReactorBusy(s->ioReactor) || (s->ring && IoRingBusy(s->ring))))
+                    {
+                        // Woken by sockets and ring completions as well as by being unparked
+                        Parking->park_external(s->threadId, &ReactorWake, s->ioReactor, [&]() -> void {
+                            ReactorWait(s->ioReactor, nextTimer);
+                        });
+                    }
+                    else if (s->timerCount.load(std::memory_order_relaxed) == 0)
+                    {
+                        Parking->park(s->threadId);
+                    }
+                    else
+                    {
+                        Parking->park_until(s->threadId, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(nextTimer)));
+                    }
+                    TACO_PROFILER_EMIT(profiler::event_type::awake);
                 }
-                thread_state<scheduler_data*>()->isSignaled = false;
             }
         }
     }
@@ -309,40 +1139,160 @@ namespace taco
     static void ShutdownScheduler()
     {
         fiber * f = nullptr;
+        task_entry * task = nullptr;
         BASIS_ASSERT(FiberCurrent() == FiberRoot());
-        while (thread_state<scheduler_data*>()->privateFibers.pop_front(f))
+        for (size_t level=0; level<task_priority_count; level++)
+        {
+            while (thread_state<scheduler_data*>()->privateFibers[level].pop_front(f))
+            {
+                FiberDestroy(f);
+            }
+
+            while (thread_state<scheduler_data*>()->sharedFibers[level].pop(f))
+            {
+                FiberDestroy(f);
+            }
+
+            while (thread_state<scheduler_data*>()->sharedTasks[level].pop(task))
+            {
+                DiscardTask(task);
+            }
+            while (thread_state<scheduler_data*>()->privateTasks[level].pop_front(task))
+            {
+                DiscardTask(task);
+            }
+        }
+
+        deadline_item item;
+        for (deadline_queue_t * heap : { &thread_state<scheduler_data*>()->deadlineShared, &thread_state<scheduler_data*>()->deadlinePrivate })
         {
-            FiberDestroy(f);
+            while (heap->pop(item))
+            {
+                if (item.task)
+                {
+                    DiscardTask(item.task);
+                }
+                else
+                {
+                    FiberDestroy(item.resume);
+                }
+            }
         }
 
-        while (thread_state<scheduler_data*>()->sharedFibers.pop(f))
         {
-            FiberDestroy(f);
+            // Fibers in timed waits belong to whatever they are waiting on, sleeping ones only to us
+            scheduler_data * s = thread_state<scheduler_data*>();
+            std::lock_guard<std::mutex> lock(s->timerMutex);
+            s->timers.clear([](timer_entry * timer) -> void {
+                if (timer->fn == &WakeSleeper)
+                {
+                    FiberDestroy((fiber *) timer->context);
+                }
+            });
+            UpdateTimers(s);
         }
 
-        for (size_t i=0; i<thread_state<scheduler_data*>()->inactive.size(); i++)
+        for (std::vector<fiber*> & inactive : thread_state<scheduler_data*>()->inactive)
         {
-            FiberDestroy(thread_state<scheduler_data*>()->inactive[i]);
+            for (size_t i=0; i<inactive.size(); i++)
+            {
+                FiberDestroy(inactive[i]);
+            }
+            inactive.clear();
         }
-        thread_state<scheduler_data*>()->inactive.clear();
 
         thread_state<scheduler_data*>() = nullptr;
     }
 
     void Initialize(int nthreads)
+    {
+        scheduler_options options;
+        options.thread_count = nthreads;
+        Initialize(options);
+    }
+
+    void Initialize(const scheduler_options & options)
     {
         BASIS_ASSERT(ThreadCount == 0);
 
-        ThreadCount = (nthreads <= 0) ? std::thread::hardware_concurrency() : nthreads;
-        GlobalSharedTaskCount = 0;
+        ThreadCount = (options.thread_count <= 0) ? std::thread::hardware_concurrency() : options.thread_count;
+        IdlePolicy = options.idle;
+        for (availability_mask *& mask : SharedTaskMask)
+        {
+            mask = new availability_mask(ThreadCount);
+        }
+        DeadlineMask = new availability_mask(ThreadCount);
+        DeadlineMode = (options.mode == scheduling_mode::deadline);
+        Parking = new parking_lot(ThreadCount);
+
+        // When pinned each scheduler's data lives on the node of the cpu it is assigned to,
+        // otherwise it is left to wherever the OS first runs the scheduler
+        Topology = ReadCpuTopology();
+        bool pinned = options.affinity.mode != affinity_mode::none;
+        std::vector<cpu_info> placement = PlacementOrder(options.affinity);
+        if (placement.empty())
+        {
+            fprintf(stderr, "taco: affinity policy excludes every cpu, schedulers are left unpinned\n");
+            pinned = false;
+            placement = Topology.cpus;
+        }
+        for (uint32_t cpu : options.affinity.blocking_cpus)
+        {
+            bool known = std::any_of(Topology.cpus.begin(), Topology.cpus.end(), [=](const cpu_info & info) -> bool {
+                return info.cpu == cpu;
+            });
+            if (known && !Contains(BlockingCpus, cpu))
+            {
+                BlockingCpus.push_back(cpu);
+            }
+        }
+
+        BASIS_ASSERT(options.blocking.thread_limit > 0);
+        BlockingPool.threadLimit = options.blocking.thread_limit;
+        BlockingPool.idleTimeout = (options.blocking.idle_timeout == std::chrono::milliseconds::max()) ? -1 :
+            std::chrono::duration_cast<std::chrono::nanoseconds>(options.blocking.idle_timeout).count();
+        BlockingPool.exitRequested = false;
+
+        SchedulerList = (scheduler_data *) NodeReserve(sizeof(scheduler_data) * ThreadCount);
+        for (unsigned i=0; i<ThreadCount; i++)
+        {
+            const cpu_info & cpu = placement[i % placement.size()];
+            NodeCommit(SchedulerList + i, sizeof(scheduler_data), pinned ? cpu.node : any_node);
+            new (SchedulerList + i) scheduler_data;
+            SchedulerList[i].cpu = cpu;
+        }
 
-        SchedulerList = new scheduler_data[ThreadCount];
         for (unsigned i=0; i<ThreadCount; i++)
         {
             SchedulerList[i].exitRequested = false;
             SchedulerList[i].threadId = i;
+            SchedulerList[i].randomState = (i + 1) * 2654435761u;
+            SchedulerList[i].stealAttempts = 0;
+            SchedulerList[i].stealSuccesses = 0;
+            SchedulerList[i].tasksStolen = 0;
+            SchedulerList[i].fibersStolen = 0;
+            SchedulerList[i].deadlineTasks = 0;
+            SchedulerList[i].deadlineMisses = 0;
+            SchedulerList[i].timerCount = 0;
+            SchedulerList[i].nextTimer = INT64_MAX;
+            SchedulerList[i].ioReactor = ReactorCreate();
+            SchedulerList[i].reactorCountdown = REACTOR_POLL_INTERVAL;
+            SchedulerList[i].ring = (options.async_io && SchedulerList[i].ioReactor) ?
+                IoRingCreate(IO_RING_ENTRIES, ReactorWakeFd(SchedulerList[i].ioReactor)) : nullptr;
             SchedulerList[i].isActive = false;
-            SchedulerList[i].isSignaled = false;
+            SchedulerList[i].isPinned = false;
+            for (size_t level=0; level<task_priority_count; level++)
+            {
+                SchedulerList[i].privateTaskCount[level] = 0;
+                SchedulerList[i].passedOver[level] = 0;
+            }
+            SchedulerList[i].privateFiberCount = 0;
+            SchedulerList[i].hasHandoff = false;
+        }
+
+        for (unsigned i=0; i<ThreadCount; i++)
+        {
+            BuildVictimList(SchedulerList + i, pinned);
         }
 
         for (unsigned i=1; i<ThreadCount; i++)
@@ -363,13 +1313,30 @@ namespace taco
             });
         }
 
+        if (pinned)
+        {
+            for (unsigned i=1; i<ThreadCount; i++)
+            {
+                SchedulerList[i].isPinned = SetThreadAffinity(SchedulerList[i].thread, { SchedulerList[i].cpu.cpu });
+            }
+            MainAffinity = GetThreadAffinity();
+            SchedulerList[0].isPinned = SetThreadAffinity({ SchedulerList[0].cpu.cpu });
+        }
+
         thread_state<scheduler_data*>() = SchedulerList;
         FiberInitializeThread();
     }
 
-    void Initialize(const char * name, task_fn comain, int nthreads)
+    void Initialize(task_name name, task_fn comain, int nthreads)
+    {
+        scheduler_options options;
+        options.thread_count = nthreads;
+        Initialize(name, comain, options);
+    }
+
+    void Initialize(task_name name, task_fn comain, const scheduler_options & options)
     {
-        Initialize(nthreads);
+        Initialize(options);
         Schedule(name, [&]() -> void {
             comain();
             ExitMain();
@@ -395,24 +1362,37 @@ namespace taco
             SchedulerList[i].thread.join();
         }
 
-        blocking_thread * thread;
-        while (BlockingThreads.pop_front(thread))
+        StopBlockingThreads();
+
+
+        ShutdownScheduler();
+
+        if (SchedulerList[0].isPinned && !MainAffinity.empty())
         {
-            {
-                std::unique_lock<std::mutex> lock(thread->workMutex);
-                thread->exitRequested = true;
-            }
-            thread->workCondition.notify_one();
-            thread->thread.join();
-            delete thread;
+            SetThreadAffinity(MainAffinity);
         }
-        
-        ShutdownScheduler();
+        MainAffinity.clear();
+        BlockingCpus.clear();
 
-        delete [] SchedulerList;
+        for (unsigned i=0; i<ThreadCount; i++)
+        {
+            IoRingDestroy(SchedulerList[i].ring);
+            ReactorDestroy(SchedulerList[i].ioReactor);
+            SchedulerList[i].~scheduler_data();
+        }
+        NodeRelease(SchedulerList, sizeof(scheduler_data) * ThreadCount);
         SchedulerList = nullptr;
+        for (availability_mask *& mask : SharedTaskMask)
+        {
+            delete mask;
+            mask = nullptr;
+        }
+        delete DeadlineMask;
+        DeadlineMask = nullptr;
+        DeadlineMode = false;
+        delete Parking;
+        Parking = nullptr;
         ThreadCount = 0;
-        BlockingThreadCount = 0;
 
         FiberShutdownThread();
     }
@@ -438,19 +1418,47 @@ namespace taco
         SignalScheduler(SchedulerList);
     }
 
-    void Schedule(const char * name, task_fn fn, uint32_t threadid)
+    void Schedule(task_name name, task_fn fn, uint32_t threadid)
+    {
+        Schedule(name, std::move(fn), stack_size::standard, threadid);
+    }
+
+    void Schedule(task_name name, task_fn fn, stack_size stack, uint32_t threadid)
+    {
+        internal::ScheduleClosure(name, std::move(fn), stack, task_priority::normal, task_deadline(), threadid);
+    }
+
+    static void PushTask(task_entry * task, uint32_t threadid)
     {
         BASIS_ASSERT(thread_state<scheduler_data*>() != nullptr);
-        
-        uint64_t taskid = GenTaskId();
+        size_t level = size_t(task->priority);
 
-        TACO_PROFILER_EMIT(profiler::event_type::schedule, taskid, name);
+        if (DeadlineMode && task->deadline != 0)
+        {
+            if (threadid < ThreadCount)
+            {
+                scheduler_data * s = SchedulerList + threadid;
+                PushDeadlineWork(s, false, task->deadline, { task, nullptr });
+                if (s != thread_state<scheduler_data*>())
+                {
+                    SignalScheduler(s);
+                }
+            }
+            else
+            {
+                BASIS_ASSERT(threadid == constants::invalid_thread_id);
+                PushDeadlineWork(thread_state<scheduler_data*>(), true, task->deadline, { task, nullptr });
+                // Whatever this scheduler is doing now, urgent work shouldn't wait on it
+                AskForHelp(1);
+            }
+            return;
+        }
 
         if (threadid < ThreadCount)
         {
             scheduler_data * s = SchedulerList + threadid;
-            s->privateTasks.push_back<task_entry>({ fn, basis::stralloc(name), taskid });
-            s->privateTaskCount.fetch_add(1, std::memory_order_relaxed);
+            s->privateTasks[level].push_back(task);
+            s->privateTaskCount[level].fetch_add(1, std::memory_order_relaxed);
 
             if (s != thread_state<scheduler_data*>())
             {
@@ -460,17 +1468,170 @@ namespace taco
         else
         {
             BASIS_ASSERT(threadid == constants::invalid_thread_id);
-            basis::string taskname = basis::stralloc(name);
-            while (!thread_state<scheduler_data*>()->sharedTasks.push({ fn, taskname, taskid })) {
-                printf("Can't push task %s\n", taskname);
-                Switch();
+            scheduler_data * s = thread_state<scheduler_data*>();
+            s->sharedTasks[level].push(task);
+            SharedTaskMask[level]->mark(s->threadId);
+
+            int64_t count = s->sharedTasks[level].size();
+            if (count > 1 || !s->isActive)
+            {
+                AskForHelp(size_t(count));
+            }
+        }
+    }
+
+    namespace internal
+    {
+        void * AllocTask(size_t size, size_t align, void ** closure)
+        {
+            task_entry * task = new (task_pool::Alloc()) task_entry;
+            task->group = nullptr;
+            task->claim.store(0, std::memory_order_relaxed);
+
+            if (size <= TASK_INLINE_SIZE && align <= alignof(std::max_align_t))
+            {
+                task->storage = closure_storage::inline_buffer;
+                task->closure = task->buffer;
+            }
+            else if (size <= closure_pool::block_size && align <= alignof(std::max_align_t))
+            {
+                task->storage = closure_storage::pooled;
+                task->closure = closure_pool::Alloc();
+            }
+            else
+            {
+                task->storage = closure_storage::heap;
+                task->closureAlign = uint32_t(align);
+                task->closure = ::operator new(size, std::align_val_t(align));
+            }
+
+            *closure = task->closure;
+            return task;
+        }
+
+        void SubmitTask(void * ptr, closure_fn fn, task_name name, stack_size stack, task_priority priority, task_deadline deadline, uint32_t threadid)
+        {
+            task_entry * task = (task_entry *) ptr;
+            task->fn = fn;
+            task->name = name;
+            task->id = GenTaskId();
+            task->stack = stack;
+            task->priority = priority;
+            task->deadline = DeadlineClock(deadline);
+
+            TACO_PROFILER_EMIT(profiler::event_type::schedule, task->id, name.c_str());
+
+            PushTask(task, threadid);
+        }
+
+        void SubmitGroupTask(void * ptr, closure_fn fn, task_name name, task_priority priority, const void * group)
+        {
+            task_entry * task = (task_entry *) ptr;
+            task->group = group;
+            SubmitTask(ptr, fn, name, stack_size::standard, priority, task_deadline(), constants::invalid_thread_id);
+        }
+
+        void SubmitFutureTask(void * ptr, closure_fn fn, task_name name, stack_size stack, task_priority priority, task_deadline deadline, uint32_t threadid, std::atomic<void *> * handle)
+        {
+            task_entry * task = (task_entry *) ptr;
+            if (threadid == constants::invalid_thread_id)
+            {
+                // One reference for its queue, one for the future
+                task->claim.store(2, std::memory_order_relaxed);
+                handle->store(task, std::memory_order_release);
+            }
+            SubmitTask(ptr, fn, name, stack, priority, deadline, threadid);
+        }
+
+        bool RunFutureTask(void * ptr)
+        {
+            task_entry * task = (task_entry *) ptr;
+            if (!CanRunInline(task->stack) || !ClaimTask(task))
+            {
+                ReleaseTask(task);
+                return false;
+            }
+
+            // Still sitting in a queue, whoever takes it from there just drops it. Our own
+            // reference goes with running it
+            RunTaskInline(task);
+            return true;
+        }
+
+        void ReleaseFutureTask(void * task)
+        {
+            ReleaseTask((task_entry *) task);
+        }
+
+        uint32_t IdleSchedulerCount()
+        {
+            return Parking ? Parking->parked() : 0;
+        }
+
+        bool RunGroupTask(task_priority priority, const void * group)
+        {
+            if (!CanRunInline(stack_size::standard))
+            {
+                return false;
+            }
+
+            scheduler_data * s = thread_state<scheduler_data*>();
+            size_t level = size_t(priority);
+            task_entry * task = nullptr;
+            if (!s->sharedTasks[level].pop(task))
+            {
+                return false;
             }
-            
-            uint32_t count = GlobalSharedTaskCount.fetch_add(1, std::memory_order_relaxed) + 1;
-            if (count > 1 || !thread_state<scheduler_data*>()->isActive)
+            if (task->group != group)
             {
-                AskForHelp(count);
+                // Not ours, put it back where it was
+                s->sharedTasks[level].push(task);
+                return false;
             }
+
+            RunTaskInline(task);
+            return true;
+        }
+    }
+
+    void ScheduleBatch(task_name name, size_t count, const std::function<task_fn(size_t)> & generator, stack_size stack, task_priority priority)
+    {
+        BASIS_ASSERT(thread_state<scheduler_data*>() != nullptr);
+
+        if (count == 0)
+        {
+            return;
+        }
+
+        uint64_t firstid = GlobalTaskCounter.fetch_add(count);
+
+        // Build everything up front - the generator is user code and could itself
+        // schedule work on to the deque we are about to push to
+        std::vector<task_entry *> tasks(count);
+        for (size_t i=0; i<count; i++)
+        {
+            TACO_PROFILER_EMIT(profiler::event_type::schedule, firstid + i, name.c_str());
+            void * closure = nullptr;
+            task_entry * task = (task_entry *) internal::AllocTask(sizeof(task_fn), alignof(task_fn), &closure);
+            new (closure) task_fn(generator(i));
+            task->fn = &internal::InvokeClosure<task_fn>;
+            task->name = name;
+            task->id = firstid + i;
+            task->stack = stack;
+            task->priority = priority;
+            task->deadline = 0;
+            tasks[i] = task;
+        }
+
+        scheduler_data * s = thread_state<scheduler_data*>();
+        s->sharedTasks[size_t(priority)].push(tasks.data(), int64_t(count));
+        SharedTaskMask[size_t(priority)]->mark(s->threadId);
+
+        // If we are an active scheduler we will be working through the batch ourselves
+        size_t wanted = s->isActive ? (count - 1) : count;
+        if (wanted > 0)
+        {
+            AskForHelp(wanted);
         }
     }
 
@@ -480,39 +1641,179 @@ namespace taco
         f->onExit = [&]() -> void {
             if (f->threadId < 0)
             {
-                thread_state<scheduler_data*>()->sharedFibers.push((fiber *)f);
+                PushSharedFiber(thread_state<scheduler_data*>(), (fiber *)f);
             }
             else
             {
-                thread_state<scheduler_data*>()->privateFibers.push_back((fiber *)f);
+                PushPrivateFiber(thread_state<scheduler_data*>(), (fiber *)f);
             }
         };
         FiberSwitch(GetNextFiber());
     }
 
-    void BlockingThread(blocking_thread * self)
+    static void AddLatency(std::atomic<uint64_t> & total, std::atomic<uint64_t> & max, int64_t ns)
+    {
+        uint64_t value = uint64_t(std::max<int64_t>(ns, 0));
+        total.fetch_add(value, std::memory_order_relaxed);
+        uint64_t prev = max.load(std::memory_order_relaxed);
+        while (prev < value && !max.compare_exchange_weak(prev, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Called by a blocking thread out of work, returns true if it should exit - because it has
+    // been idle for too long or the pool is over its limit. Work queued meanwhile either sees the
+    // thread gone, and so has room to start another, or is seen here and keeps it around
+    static bool RetireBlockingThread(bool idleTimeout)
+    {
+        uint32_t count = BlockingPool.threadCount.load();
+        do
+        {
+            if (!idleTimeout && count <= BlockingPool.threadLimit.load())
+            {
+                return false;
+            }
+        } while (!BlockingPool.threadCount.compare_exchange_weak(count, count - 1));
+
+        if (BlockingPool.pending.load() > 0 && !BlockingPool.exitRequested.load())
+        {
+            BlockingPool.threadCount.fetch_add(1);
+            return false;
+        }
+        BlockingPool.threadsReaped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    static void BlockingThread(blocking_thread * self)
     {
         FiberInitializeThread();
-        std::unique_lock<std::mutex> lock(self->workMutex);
-        for (;;)
+        while (!BlockingPool.exitRequested.load())
         {
-            while (!self->current && !self->exitRequested)
+            fiber * f = nullptr;
+            if (BlockingPool.backlog.pop_front(f))
             {
-                self->workCondition.wait(lock);
+                BlockingPool.pending.fetch_sub(1);
+                BlockingPool.reserved.fetch_sub(1);
+                // Returns once the fiber calls EndBlocking
+                FiberInvoke(f);
+                continue;
             }
 
-            if (self->exitRequested)
+            if (RetireBlockingThread(false))
             {
                 break;
             }
 
-            BASIS_ASSERT(self->current);
+            // Either work submitted from here on sees us idle and signals, or we see it below
+            BlockingPool.idle.fetch_add(1);
+            uint32_t key = BlockingPool.signal.prepare_wait();
+            if (BlockingPool.pending.load() > 0 || BlockingPool.exitRequested.load() ||
+                BlockingPool.threadCount.load() > BlockingPool.threadLimit.load())
+            {
+                BlockingPool.signal.cancel_wait();
+                BlockingPool.idle.fetch_sub(1);
+                continue;
+            }
+
+            int64_t timeout = BlockingPool.idleTimeout.load(std::memory_order_relaxed);
+            int64_t start = DeadlineClock(std::chrono::steady_clock::now());
+            bool signaled = BlockingPool.signal.wait(key, timeout);
+            BlockingPool.idle.fetch_sub(1);
 
-            FiberInvoke(self->current);
-            self->current = nullptr;
-            BlockingThreads.push_back(self);
+            // Wakeups can be spurious, only give up after really having waited out the timeout
+            if (!signaled && timeout >= 0 && DeadlineClock(std::chrono::steady_clock::now()) - start >= timeout &&
+                RetireBlockingThread(true))
+            {
+                break;
+            }
         }
         FiberShutdownThread();
+        self->finished.store(true, std::memory_order_release);
+    }
+
+    // Takes a slot under the limit and starts a thread in it, returns false if at the limit
+    static bool StartBlockingThread()
+    {
+        uint32_t count = BlockingPool.threadCount.load();
+        do
+        {
+            if (count >= BlockingPool.threadLimit.load())
+            {
+                return false;
+            }
+        } while (!BlockingPool.threadCount.compare_exchange_weak(count, count + 1));
+
+        std::lock_guard<std::mutex> lock(BlockingPool.threadsMutex);
+
+        // Threads that have exited are joined here rather than by themselves
+        auto finished = std::remove_if(BlockingPool.threads.begin(), BlockingPool.threads.end(), [](blocking_thread * thread) -> bool {
+            if (!thread->finished.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            thread->thread.join();
+            delete thread;
+            return true;
+        });
+        BlockingPool.threads.erase(finished, BlockingPool.threads.end());
+
+        blocking_thread * thread = new blocking_thread;
+        thread->finished = false;
+        thread->thread = std::thread([=]() -> void {
+            BlockingThread(thread);
+        });
+        if (!BlockingCpus.empty())
+        {
+            SetThreadAffinity(thread->thread, BlockingCpus);
+        }
+        BlockingPool.threads.push_back(thread);
+        BlockingPool.threadsStarted.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Runs on the scheduler f left, once it has switched away
+    static void SubmitBlocking(fiber * f)
+    {
+        bool pushed = BlockingPool.backlog.push_back(f);
+        BASIS_ASSERT(pushed);
+        BASIS_UNUSED(pushed);
+
+        uint32_t pending = BlockingPool.pending.fetch_add(1) + 1;
+        uint32_t idle = BlockingPool.idle.load();
+        if (idle > 0)
+        {
+            BlockingPool.signal.notify_one();
+        }
+        if (pending > idle && !StartBlockingThread())
+        {
+            // Picked up by the next thread to finish what it is running
+            BlockingPool.queued.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static void StopBlockingThreads()
+    {
+        BlockingPool.exitRequested = true;
+        BlockingPool.signal.notify_all();
+
+        std::lock_guard<std::mutex> lock(BlockingPool.threadsMutex);
+        for (blocking_thread * thread : BlockingPool.threads)
+        {
+            thread->thread.join();
+            delete thread;
+        }
+        BlockingPool.threads.clear();
+
+        // Counters start over with the next Initialize
+        BlockingPool.threadCount = 0;
+        BlockingPool.sections = 0;
+        BlockingPool.queued = 0;
+        BlockingPool.handoffNs = 0;
+        BlockingPool.maxHandoffNs = 0;
+        BlockingPool.blockedNs = 0;
+        BlockingPool.maxBlockedNs = 0;
+        BlockingPool.threadsStarted = 0;
+        BlockingPool.threadsReaped = 0;
     }
 
     void BeginBlocking()
@@ -522,36 +1823,23 @@ namespace taco
 
         BASIS_ASSERT(!base->onExit);
 
-        blocking_thread * thread = nullptr;
-        while (!thread && !BlockingThreads.pop_front(thread))
+        // Sections only have to wait before being queued once the backlog is full
+        while (BlockingPool.reserved.fetch_add(1) >= BLOCKING_BACKLOG_LIMIT)
         {
-            int cur = BlockingThreadCount.fetch_add(1);
-            if (cur == BLOCKING_THREAD_LIMIT)
-            {
-                BlockingThreadCount.store(cur);
-                Switch();
-            }
-            else
-            {
-                thread = new blocking_thread;
-                thread->exitRequested = false;
-                thread->current = nullptr;
-                thread->thread = std::thread([=]() -> void {
-                    BlockingThread(thread);
-                });
-            }
+            BlockingPool.reserved.fetch_sub(1);
+            Switch();
         }
 
+        base->blockingSince = DeadlineClock(std::chrono::steady_clock::now());
         base->onExit = [=]() -> void {
             base->isBlocking = true;
-            {
-                std::unique_lock<std::mutex> lock(thread->workMutex);
-                thread->current = f;
-            }
-            thread->workCondition.notify_one();
+            SubmitBlocking(f);
         };
 
         FiberInvoke(GetNextFiber());
+
+        // Now on a blocking thread
+        AddLatency(BlockingPool.handoffNs, BlockingPool.maxHandoffNs, DeadlineClock(std::chrono::steady_clock::now()) - base->blockingSince);
     }
 
     void EndBlocking()
@@ -561,24 +1849,43 @@ namespace taco
         
         BASIS_ASSERT(!base->onExit);
 
+        AddLatency(BlockingPool.blockedNs, BlockingPool.maxBlockedNs, DeadlineClock(std::chrono::steady_clock::now()) - base->blockingSince);
+        BlockingPool.sections.fetch_add(1, std::memory_order_relaxed);
+
         base->onExit = [=]() -> void {
             base->isBlocking = false;
             if (base->threadId < 0)
             {
-                SchedulerList[-(base->threadId + 1)].sharedFibers.push(f);
+                // Only the owning scheduler may push to its shared queue, and we are on
+                // the blocking thread here, so go through the (mpsc) private queue instead
+                PushPrivateFiber(SchedulerList - (base->threadId + 1), f);
                 SignalScheduler(SchedulerList - (base->threadId + 1));
             }
             else
             {
-                BASIS_ASSERT((unsigned)base->threadId < thread_state<scheduler_data*>()->threadId);
-                thread_state<scheduler_data*>()->privateFibers.push_back(f);
-                SignalScheduler(thread_state<scheduler_data*>());
+                // No scheduler of our own on the blocking thread, back to the one it is bound to
+                BASIS_ASSERT((unsigned)base->threadId < ThreadCount);
+                PushPrivateFiber(SchedulerList + base->threadId, f);
+                SignalScheduler(SchedulerList + base->threadId);
             }
         };
 
         FiberInvoke(FiberRoot());
     }
 
+    void SetBlockingThreadLimit(uint32_t limit)
+    {
+        BASIS_ASSERT(limit > 0);
+        BlockingPool.threadLimit.store(limit);
+
+        // Idle threads over a lowered limit exit, and a raised one lets queued sections start
+        BlockingPool.signal.notify_all();
+        uint32_t pending = BlockingPool.pending.load();
+        for (uint32_t i=BlockingPool.idle.load(); i<pending && StartBlockingThread(); i++)
+        {
+        }
+    }
+
     void SetTaskLocalData(void * data)
     {
         fiber_base * f = (fiber_base *) FiberCurrent();
@@ -597,6 +1904,12 @@ namespace taco
         return f->name;
     }
 
+    task_priority GetTaskPriority()
+    {
+        fiber_base  * f = (fiber_base *) FiberCurrent();
+        return f->priority;
+    }
+
     void Suspend()
     {
         FiberSwitch(GetNextFiber());
@@ -615,16 +1928,106 @@ namespace taco
         fiber_base * base = (fiber_base *) f;
         if (base->threadId < 0)
         {
-            thread_state<scheduler_data*>()->sharedFibers.push(f);
+            PushSharedFiber(thread_state<scheduler_data*>(), f);
         }
         else
         {
             BASIS_ASSERT(base->threadId >= 0 && (unsigned)base->threadId < ThreadCount);
-            SchedulerList[base->threadId].privateFibers.push_back(f);
+            PushPrivateFiber(SchedulerList + base->threadId, f);
             SignalScheduler(SchedulerList + base->threadId);
         }
     }
 
+    void AddTimer(timer_entry * timer, std::chrono::steady_clock::time_point time)
+    {
+        scheduler_data * s = thread_state<scheduler_data*>();
+        BASIS_ASSERT(s);
+
+        int64_t ns = std::max<int64_t>(DeadlineClock(time), 0);
+        timer->tick = (uint64_t(ns) + TIMER_TICK_NS - 1) / TIMER_TICK_NS;
+        timer->owner = s->threadId;
+
+        std::lock_guard<std::mutex> lock(s->timerMutex);
+        s->timers.add(timer);
+        UpdateTimers(s);
+    }
+
+    bool CancelTimer(timer_entry * timer)
+    {
+        BASIS_ASSERT(timer->owner < ThreadCount);
+        scheduler_data * s = SchedulerList + timer->owner;
+
+        std::lock_guard<std::mutex> lock(s->timerMutex);
+        bool removed = s->timers.remove(timer);
+        UpdateTimers(s);
+        return removed;
+    }
+
+    static void WaiterTimedOut(timer_entry * timer)
+    {
+        fiber_waiter * waiter = (fiber_waiter *) timer->context;
+        if (ClaimWaiter(waiter))
+        {
+            waiter->timedOut = true;
+            Resume(waiter->f);
+        }
+    }
+
+    bool WaitOn(fiber_waiter * waiter, std::chrono::steady_clock::time_point time, const std::function<void()> & on_suspend)
+    {
+        bool timed = (time != std::chrono::steady_clock::time_point::max());
+        waiter->timer.fn = &WaiterTimedOut;
+        waiter->timer.context = waiter;
+
+        Suspend([&]() -> void {
+            // Timer first, as soon as on_suspend has run a waker may resume us and cancel it
+            if (timed)
+            {
+                AddTimer(&waiter->timer, time);
+            }
+            on_suspend();
+        });
+
+        if (timed && !waiter->timedOut)
+        {
+            CancelTimer(&waiter->timer);
+        }
+        return !waiter->timedOut;
+    }
+
+    void SleepUntil(std::chrono::steady_clock::time_point time)
+    {
+        if (!IsSchedulerThread())
+        {
+            std::this_thread::sleep_until(time);
+            return;
+        }
+
+        if (time <= std::chrono::steady_clock::now())
+        {
+            return;
+        }
+
+        timer_entry timer = {};
+        timer.fn = &WakeSleeper;
+        timer.context = FiberCurrent();
+        Suspend([&]() -> void {
+            AddTimer(&timer, time);
+        });
+    }
+
+    io_ring * GetIoRing()
+    {
+        scheduler_data * s = thread_state<scheduler_data*>();
+        return s ? s->ring : nullptr;
+    }
+
+    reactor * GetReactor()
+    {
+        scheduler_data * s = thread_state<scheduler_data*>();
+        return s ? s->ioReactor : nullptr;
+    }
+
     bool IsSchedulerThread()
     {
         return thread_state<scheduler_data*>() != nullptr && thread_state<scheduler_data*>()->isActive;
@@ -637,11 +2040,54 @@ namespace taco
 
     uint64_t GetTaskId()
     {
-        return thread_state<task_entry*>()->id;
+        // Profiler events are also emitted from outside of any task
+        task_entry * task = thread_state<task_entry*>();
+        return task ? task->id : UINT64_MAX;
     }
 
     uint32_t GetThreadCount()
     {
         return ThreadCount;    
     }
+
+    scheduler_stats GetSchedulerStats()
+    {
+        scheduler_stats stats = {};
+        for (uint32_t i=0; i<ThreadCount; i++)
+        {
+            stats.steal_attempts += SchedulerList[i].stealAttempts.load(std::memory_order_relaxed);
+            stats.steal_successes += SchedulerList[i].stealSuccesses.load(std::memory_order_relaxed);
+            stats.tasks_stolen += SchedulerList[i].tasksStolen.load(std::memory_order_relaxed);
+            stats.fibers_stolen += SchedulerList[i].fibersStolen.load(std::memory_order_relaxed);
+            stats.deadline_tasks += SchedulerList[i].deadlineTasks.load(std::memory_order_relaxed);
+            stats.deadline_misses += SchedulerList[i].deadlineMisses.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+    blocking_stats GetBlockingStats()
+    {
+        blocking_stats stats = {};
+        stats.sections = BlockingPool.sections.load(std::memory_order_relaxed);
+        stats.queued = BlockingPool.queued.load(std::memory_order_relaxed);
+        stats.handoff_ns = BlockingPool.handoffNs.load(std::memory_order_relaxed);
+        stats.max_handoff_ns = BlockingPool.maxHandoffNs.load(std::memory_order_relaxed);
+        stats.blocked_ns = BlockingPool.blockedNs.load(std::memory_order_relaxed);
+        stats.max_blocked_ns = BlockingPool.maxBlockedNs.load(std::memory_order_relaxed);
+        stats.threads_started = BlockingPool.threadsStarted.load(std::memory_order_relaxed);
+        stats.threads_reaped = BlockingPool.threadsReaped.load(std::memory_order_relaxed);
+        stats.threads = BlockingPool.threadCount.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    cpu_mapping GetCpuMapping()
+    {
+        cpu_mapping mapping;
+        for (uint32_t i=0; i<ThreadCount; i++)
+        {
+            mapping.schedulers.push_back(SchedulerList[i].isPinned ? int(SchedulerList[i].cpu.cpu) : -1);
+        }
+        mapping.blocking = BlockingCpus;
+        return mapping;
+    }
 }
@@ -7,6 +7,8 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <thread>
 #include <mutex>
 #include <vector>
@@ -14,6 +16,8 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 
 #include <taco/taco_core.h>
 
+#include "timer_wheel.h"
+
 #define INVALID_SCHEDULER_ID 0xffffffff
 
 namespace taco
@@ -25,4 +29,47 @@ namespace taco
     
     void Resume(fiber * f);
     bool IsSchedulerThread();
+
+    struct io_ring;
+    /// The current scheduler's asynchronous I/O ring, nullptr if it doesn't have one
+    io_ring * GetIoRing();
+
+    struct reactor;
+    /// The current scheduler's socket readiness reactor, nullptr if it doesn't have one
+    reactor * GetReactor();
+
+    typedef timer_wheel::entry timer_entry;
+
+    /// Adds a timer to the current scheduler's wheel, it fires on that scheduler once time has
+    /// passed. Usually called from an on_suspend callback, the timer must outlive its firing or
+    /// be cancelled
+    void AddTimer(timer_entry * timer, std::chrono::steady_clock::time_point time);
+    /// Returns false if the timer has already fired, in which case fn has returned
+    bool CancelTimer(timer_entry * timer);
+
+    /// A fiber waiting to be woken, possibly with a timeout. The waker and the timeout race to
+    /// claim it and only the winner resumes the fiber
+    struct fiber_waiter
+    {
+        fiber_waiter(fiber * f)
+            :   f(f), claimed(false), timedOut(false), timer(), next(nullptr)
+        {}
+
+        fiber *             f;
+        std::atomic<bool>   claimed;
+        bool                timedOut;
+        timer_entry         timer;
+        fiber_waiter *      next;       ///< For the waker to collect claimed waiters with
+    };
+
+    inline bool ClaimWaiter(fiber_waiter * waiter)
+    {
+        return !waiter->claimed.exchange(true, std::memory_order_acq_rel);
+    }
+
+    /// Suspends the current fiber until waiter is claimed and resumed or until time, calling
+    /// on_suspend once it is suspended (to add waiter wherever wakers find it). Returns false
+    /// on timeout, the caller then still has to take waiter back out of wherever it put it.
+    /// No timeout if time is time_point::max()
+    bool WaitOn(fiber_waiter * waiter, std::chrono::steady_clock::time_point time, const std::function<void()> & on_suspend);
 }
@@ -0,0 +1,58 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <basis/assert.h>
+#include <taco/task_group.h>
+#include "fiber.h"
+#include "scheduler_priv.h"
+#include "profiler_priv.h"
+
+namespace taco
+{
+    static constexpr uint64_t waiting_bit = uint64_t(1) << 63;
+
+    void task_group::wait()
+    {
+        if ((m_state.load(std::memory_order_acquire) & ~waiting_bit) == 0)
+        {
+            return;
+        }
+
+        BASIS_ASSERT(IsSchedulerThread());
+        TACO_PROFILER_LOG("task_group::wait <%p>", this);
+
+        while ((m_state.load(std::memory_order_acquire) & ~waiting_bit) != 0)
+        {
+            if (internal::RunGroupTask(m_priority, this))
+            {
+                continue;
+            }
+
+            // The rest are running elsewhere, whoever completes the last one resumes us - unless
+            // that already happened by the time we are suspended, then there is nobody left to
+            m_waiter = FiberCurrent();
+            Suspend([this]() -> void {
+                uint64_t prev = m_state.fetch_or(waiting_bit, std::memory_order_acq_rel);
+                if (prev == 0)
+                {
+                    Resume(m_waiter);
+                }
+            });
+            m_state.fetch_and(~waiting_bit, std::memory_order_relaxed);
+        }
+    }
+
+    void task_group::done()
+    {
+        // Only we can resume a suspended waiter, so the group is still around to look at
+        uint64_t prev = m_state.fetch_sub(1, std::memory_order_acq_rel);
+        if (prev == (waiting_bit | 1))
+        {
+            Resume(m_waiter);
+        }
+    }
+}
@@ -0,0 +1,121 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <taco/task_name.h>
+#include "config.h"
+#include "thread_state.h"
+
+namespace taco
+{
+    struct name_table
+    {
+        std::shared_mutex                               mutex;
+        std::unordered_map<std::string_view, uint32_t>  ids;
+        std::vector<const char *>                       strings;
+    };
+
+    static name_table & NameTable()
+    {
+        // Entries live until the process exits, names may still be referenced by
+        // tasks and profiler listeners while statics are being torn down
+        static name_table * table = new name_table;
+        return *table;
+    }
+
+    // Recently interned strings, by address. The address alone isn't enough, a buffer can be
+    // reused for a different name, so hits are checked against the interned string
+    struct name_cache
+    {
+        struct entry
+        {
+            const char *    str = nullptr;
+            task_name       name;
+        };
+
+        entry   entries[TASK_NAME_CACHE_SIZE];
+
+        static size_t Slot(const char * str)
+        {
+            uintptr_t addr = uintptr_t(str);
+            return (addr ^ (addr >> 7)) & (TASK_NAME_CACHE_SIZE - 1);
+        }
+    };
+    static_assert((TASK_NAME_CACHE_SIZE & (TASK_NAME_CACHE_SIZE - 1)) == 0, "TASK_NAME_CACHE_SIZE must be a power of 2");
+
+    task_name task_name::Intern(const char * str)
+    {
+        if (!str)
+        {
+            return task_name();
+        }
+
+        name_cache::entry & entry = thread_state<name_cache>().entries[name_cache::Slot(str)];
+        if (entry.str == str && strcmp(str, entry.name.c_str()) == 0)
+        {
+            return entry.name;
+        }
+
+        task_name name = InternShared(str);
+        if (name.id() != 0)
+        {
+            entry.str = str;
+            entry.name = name;
+        }
+        return name;
+    }
+
+    task_name task_name::InternShared(const char * str)
+    {
+        name_table & table = NameTable();
+        std::string_view key(str);
+
+        {
+            std::shared_lock<std::shared_mutex> lock(table.mutex);
+            auto itr = table.ids.find(key);
+            if (itr != table.ids.end())
+            {
+                return task_name(table.strings[itr->second - 1], itr->second);
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(table.mutex);
+        auto itr = table.ids.find(key);
+        if (itr != table.ids.end())
+        {
+            return task_name(table.strings[itr->second - 1], itr->second);
+        }
+
+        if (table.strings.size() >= TASK_NAME_TABLE_LIMIT)
+        {
+            // Full, most likely of names that are never seen again
+            return task_name();
+        }
+
+        char * copy = new char[key.size() + 1];
+        memcpy(copy, str, key.size() + 1);
+
+        table.strings.push_back(copy);
+        uint32_t id = (uint32_t) table.strings.size();
+        table.ids.emplace(std::string_view(copy, key.size()), id);
+
+        return task_name(copy, id);
+    }
+
+    const char * task_name::Lookup(uint32_t id)
+    {
+        name_table & table = NameTable();
+        std::shared_lock<std::shared_mutex> lock(table.mutex);
+        return (id > 0 && id <= table.strings.size()) ? table.strings[id - 1] : nullptr;
+    }
+}
@@ -25,11 +25,18 @@ namespace taco
     ///                                                    // but still prints the same id
     ///     }
     /// Uses a volatile ptr to the thread local data to prevent optimization
+    /// and is kept out of line, otherwise gcc will happily hoist the thread
+    /// pointer read and reuse the address across a fiber switch
     /// Note this means there is only one global instance of the structure
     /// per thread - so it is intended for global state type things
     /// Tested as working on clang-1300.0.27.3 arm64
     /// May neeed to adjust as I expand testing to other targets
     template<class storage_t>
+#if defined(_MSC_VER)
+    __declspec(noinline)
+#else
+    __attribute__((noinline))
+#endif
     storage_t & thread_state()
     {
         static thread_local storage_t data;
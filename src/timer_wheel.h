@@ -0,0 +1,255 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <basis/assert.h>
+
+namespace taco
+{
+    /// @brief Hierarchical timing wheel
+    /// Time is counted in ticks. Each of the LEVELS wheels has SLOTS slots, a slot of level n
+    /// spanning SLOTS^n ticks, and a timer goes in the lowest level whose current span it falls
+    /// in. When a higher level slot comes up its timers cascade down to be placed more precisely,
+    /// so adding, removing and expiring timers are all constant time. Entries are intrusive and
+    /// owned by whoever added them. Not thread safe.
+    class timer_wheel
+    {
+        static constexpr uint32_t SLOT_BITS = 6;
+        static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+        static constexpr uint32_t LEVELS = 6;
+
+    public:
+        static constexpr uint64_t never = UINT64_MAX;
+
+        struct entry
+        {
+            uint64_t    tick;                   ///< Tick at which the timer expires, set before add
+            void      (*fn)(entry * e);         ///< Called when the timer expires
+            void *      context;
+            uint32_t    owner;                  ///< Free for the owner of the wheel to use
+
+            entry *     next;
+            entry *     prev;
+            uint8_t     level;
+            uint8_t     slot;
+            bool        linked;
+        };
+
+        explicit timer_wheel(uint64_t now)
+            :   m_now(now),
+                m_count(0)
+        {
+            std::fill(&m_slots[0][0], &m_slots[0][0] + LEVELS * SLOTS, nullptr);
+            std::fill(m_occupied, m_occupied + LEVELS, 0);
+        }
+
+        /// @brief Adds a timer, one whose tick has already passed expires on the next advance
+        void add(entry * e)
+        {
+            BASIS_ASSERT(!e->linked);
+            link(e);
+            m_count++;
+        }
+
+        /// @brief Removes a timer
+        /// @return false if it wasn't in the wheel, because it already expired
+        bool remove(entry * e)
+        {
+            if (!e->linked)
+            {
+                return false;
+            }
+
+            if (e->prev)
+            {
+                e->prev->next = e->next;
+            }
+            else
+            {
+                m_slots[e->level][e->slot] = e->next;
+                if (!e->next)
+                {
+                    m_occupied[e->level] &= ~(uint64_t(1) << e->slot);
+                }
+            }
+            if (e->next)
+            {
+                e->next->prev = e->prev;
+            }
+
+            e->linked = false;
+            m_count--;
+            return true;
+        }
+
+        /// @brief Expires every timer with a tick up to and including now, passing each to fire
+        /// Timers are removed before they are fired.
+        /// @return number of timers fired
+        template<class F>
+        size_t advance(uint64_t now, F && fire)
+        {
+            size_t fired = 0;
+            for (;;)
+            {
+                uint64_t tick = next_tick();
+                if (tick == never || tick > now)
+                {
+                    break;
+                }
+                m_now = tick;
+
+                // Slots coming up on the higher levels are spread out over the lower ones first,
+                // anything due on this very tick ends up back in level 0
+                for (uint32_t level=LEVELS - 1; level>0; level--)
+                {
+                    uint32_t slot = uint32_t(tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+                    for (entry * e = detach(level, slot); e; )
+                    {
+                        entry * next = e->next;
+                        link(e);
+                        e = next;
+                    }
+                }
+
+                for (entry * e = detach(0, uint32_t(tick) & (SLOTS - 1)); e; )
+                {
+                    entry * next = e->next;
+                    if (e->tick <= tick)
+                    {
+                        m_count--;
+                        fire(e);
+                        fired++;
+                    }
+                    else
+                    {
+                        // Was further out than the wheel reaches when it was added
+                        link(e);
+                    }
+                    e = next;
+                }
+
+                m_now = tick + 1;
+            }
+
+            // Nothing is due before now, so skipping ahead can't jump over a slot
+            m_now = std::max(m_now, now + 1);
+            return fired;
+        }
+
+        /// @brief Earliest tick at which advance has anything to do, never if the wheel is empty
+        /// This may be earlier than the next timer expires, when timers need cascading.
+        uint64_t next_tick() const
+        {
+            uint64_t best = never;
+            for (uint32_t level=0; level<LEVELS; level++)
+            {
+                uint64_t occupied = m_occupied[level];
+                if (!occupied)
+                {
+                    continue;
+                }
+
+                uint32_t shift = SLOT_BITS * level;
+                uint32_t current = uint32_t(m_now >> shift) & (SLOTS - 1);
+                uint64_t block = (m_now >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+
+                // Timers always sit at or ahead of the current slot in the current block of the
+                // level above, wrapped around slots would belong to the next one
+                uint64_t ahead = occupied & (~uint64_t(0) << current);
+                uint64_t tick = ahead ?
+                    block + (uint64_t(std::countr_zero(ahead)) << shift) :
+                    block + (uint64_t(SLOTS + std::countr_zero(occupied)) << shift);
+                best = std::min(best, std::max(tick, m_now));
+            }
+            return best;
+        }
+
+        size_t size() const
+        {
+            return m_count;
+        }
+
+        /// @brief Removes every timer without firing it, passing each to fn
+        template<class F>
+        void clear(F && fn)
+        {
+            for (uint32_t level=0; level<LEVELS; level++)
+            {
+                for (uint32_t slot=0; slot<SLOTS; slot++)
+                {
+                    for (entry * e = detach(level, slot); e; )
+                    {
+                        entry * next = e->next;
+                        fn(e);
+                        e = next;
+                    }
+                }
+            }
+            m_count = 0;
+        }
+
+    private:
+        timer_wheel(const timer_wheel &) = delete;
+        timer_wheel & operator = (const timer_wheel &) = delete;
+
+        void link(entry * e)
+        {
+            // The wheel only reaches so far, anything further out goes in the last slot it
+            // reaches and is placed again from there
+            uint64_t reach = m_now | ((uint64_t(1) << (SLOT_BITS * LEVELS)) - 1);
+            uint64_t tick = std::min(std::max(e->tick, m_now), reach);
+
+            uint32_t level = 0;
+            while (level < LEVELS - 1 && (tick >> (SLOT_BITS * (level + 1))) != (m_now >> (SLOT_BITS * (level + 1))))
+            {
+                level++;
+            }
+            uint32_t slot = uint32_t(tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+
+            e->level = uint8_t(level);
+            e->slot = uint8_t(slot);
+            e->prev = nullptr;
+            e->next = m_slots[level][slot];
+            if (e->next)
+            {
+                e->next->prev = e;
+            }
+            m_slots[level][slot] = e;
+            m_occupied[level] |= uint64_t(1) << slot;
+            e->linked = true;
+        }
+
+        entry * detach(uint32_t level, uint32_t slot)
+        {
+            uint64_t bit = uint64_t(1) << slot;
+            if ((m_occupied[level] & bit) == 0)
+            {
+                return nullptr;
+            }
+
+            entry * list = m_slots[level][slot];
+            m_slots[level][slot] = nullptr;
+            m_occupied[level] &= ~bit;
+            for (entry * e = list; e; e = e->next)
+            {
+                e->linked = false;
+            }
+            return list;
+        }
+
+        uint64_t    m_now;          // Every tick before this one has been processed
+        size_t      m_count;
+        entry *     m_slots[LEVELS][SLOTS];
+        uint64_t    m_occupied[LEVELS];
+    };
+}
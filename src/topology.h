@@ -0,0 +1,80 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#pragma once
+
+#include <thread>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace taco
+{
+    /// Levels of the cpu topology, from closest to furthest apart
+    enum class topology_level : uint32_t
+    {
+        core,       ///< hardware threads of the same physical core
+        cache,      ///< cores sharing a last level cache
+        node,       ///< cores on the same NUMA node
+        system,
+        count
+    };
+
+    struct cpu_info
+    {
+        uint32_t    cpu;        ///< OS cpu number
+        uint32_t    core;       ///< Lowest cpu number on the same physical core
+        uint32_t    cache;      ///< Lowest cpu number sharing the same last level cache
+        uint32_t    node;       ///< NUMA node
+        uint32_t    thread;     ///< Index of this cpu amongst the hardware threads of its core
+    };
+
+    struct cpu_topology
+    {
+        /// Ordered in the order schedulers are assigned to them - the first hardware thread of
+        /// every core comes first, grouped by node and cache, followed by the remaining SMT siblings
+        std::vector<cpu_info>   cpus;
+        uint32_t                nodeCount;
+    };
+
+    /// Reads the topology of the cpus available to the process. Falls back to a flat topology -
+    /// every cpu its own core, all on one cache and node - where it can't be determined
+    cpu_topology    ReadCpuTopology     ();
+
+    inline topology_level TopologyDistance(const cpu_info & a, const cpu_info & b)
+    {
+        if (a.core == b.core)
+        {
+            return topology_level::core;
+        }
+        if (a.cache == b.cache)
+        {
+            return topology_level::cache;
+        }
+        if (a.node == b.node)
+        {
+            return topology_level::node;
+        }
+        return topology_level::system;
+    }
+
+    /// Reserves size bytes of page aligned memory, nothing is committed until NodeCommit
+    void *          NodeReserve         (size_t size);
+    /// Node for NodeCommit that leaves it to the OS
+    static constexpr uint32_t any_node = UINT32_MAX;
+
+    /// Commits a page aligned range of reserved memory, preferring to back it with memory
+    /// from the given node
+    void            NodeCommit          (void * ptr, size_t size, uint32_t node);
+    void            NodeRelease         (void * ptr, size_t size);
+
+    /// Restricts a thread to the given cpus, returns false if the OS refused
+    bool            SetThreadAffinity   (std::thread & thread, const std::vector<uint32_t> & cpus);
+    bool            SetThreadAffinity   (const std::vector<uint32_t> & cpus);
+    /// The cpus the calling thread may currently run on, empty if unknown
+    std::vector<uint32_t> GetThreadAffinity();
+}
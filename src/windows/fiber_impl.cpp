@@ -8,6 +8,7 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 #include <Windows.h>
 #include <functional>
 #include <atomic>
+#include <new>
 
 #include <basis/assert.h>
 #include <basis/thread_util.h>
@@ -63,6 +64,11 @@ namespace taco
         ConvertThreadToFiber(ThreadFiber);
         ThreadFiber->base.threadId = -1;
         ThreadFiber->base.data = nullptr;
+        ThreadFiber->base.stack = stack_size::huge;
+        ThreadFiber->base.priority = task_priority::normal;
+        ThreadFiber->base.deadline = 0;
+        ThreadFiber->base.blockingSince = 0;
+        ThreadFiber->base.inlineDepth = 0;
         ThreadFiber->base.isBlocking = false;
         ThreadFiber->base.onEnter = ThreadFiber->base.onExit = nullptr;
         ThreadFiber->handle = GetCurrentFiber();
@@ -76,15 +82,25 @@ namespace taco
         ThreadFiber = nullptr;
     }
     
-    fiber * FiberCreate(const fiber_fn & fn)
+    fiber * FiberCreate(const fiber_fn & fn, stack_size size)
     {
         fiber * f = new fiber;
         f->base.fn = fn;
         f->base.threadId = -1;
         f->base.data = nullptr;
+        f->base.stack = size;
+        f->base.priority = task_priority::normal;
+        f->base.deadline = 0;
+        f->base.blockingSince = 0;
+        f->base.inlineDepth = 0;
         f->base.isBlocking = false;
         f->base.onEnter = f->base.onExit = nullptr;
-        f->handle = ::CreateFiber(FIBER_STACK_SIZE, &FiberMain, f);
+        f->handle = ::CreateFiber(FiberStackSize(size), &FiberMain, f);
+        if (!f->handle)
+        {
+            delete f;
+            throw std::bad_alloc();
+        }
         return f;
     }
 
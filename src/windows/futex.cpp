@@ -0,0 +1,35 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <Windows.h>
+#include <algorithm>
+
+#include <basis/assert.h>
+
+#include "../futex.h"
+
+#pragma comment(lib, "Synchronization.lib")
+
+namespace taco
+{
+    void FutexWait(std::atomic<uint32_t> * word, uint32_t expected, int64_t timeout)
+    {
+        // Rounded up so a timed wait never returns early because of the conversion
+        DWORD ms = (timeout < 0) ? INFINITE : DWORD((std::min<int64_t>)((timeout + 999999) / 1000000, INFINITE - 1));
+        WaitOnAddress(word, &expected, sizeof(expected), ms);
+    }
+
+    void FutexWakeOne(std::atomic<uint32_t> * word)
+    {
+        WakeByAddressSingle(word);
+    }
+
+    void FutexWakeAll(std::atomic<uint32_t> * word)
+    {
+        WakeByAddressAll(word);
+    }
+}
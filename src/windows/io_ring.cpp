@@ -0,0 +1,56 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <basis/assert.h>
+
+#include "../io_ring.h"
+
+// There is no taco::io on Windows, schedulers just never have a ring
+
+namespace taco
+{
+    io_ring * IoRingCreate(uint32_t entries, int notifyFd)
+    {
+        BASIS_UNUSED(entries);
+        BASIS_UNUSED(notifyFd);
+        return nullptr;
+    }
+
+    void IoRingDestroy(io_ring * ring)
+    {
+        BASIS_UNUSED(ring);
+    }
+
+    bool IoRingReserve(io_ring * ring)
+    {
+        BASIS_UNUSED(ring);
+        return false;
+    }
+
+    void IoRingQueue(io_ring * ring, io_request * request)
+    {
+        BASIS_UNUSED(ring);
+        BASIS_UNUSED(request);
+    }
+
+    void IoRingPoll(io_ring * ring)
+    {
+        BASIS_UNUSED(ring);
+    }
+
+    bool IoRingBusy(io_ring * ring)
+    {
+        BASIS_UNUSED(ring);
+        return false;
+    }
+
+    bool IoRingReady(io_ring * ring)
+    {
+        BASIS_UNUSED(ring);
+        return false;
+    }
+}
@@ -0,0 +1,59 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <basis/assert.h>
+
+#include "../reactor.h"
+
+// There is no taco::net on Windows, schedulers just never have a reactor
+
+namespace taco
+{
+    reactor * ReactorCreate()
+    {
+        return nullptr;
+    }
+
+    void ReactorDestroy(reactor * r)
+    {
+        BASIS_UNUSED(r);
+    }
+
+    int ReactorWakeFd(reactor * r)
+    {
+        BASIS_UNUSED(r);
+        return -1;
+    }
+
+    void ReactorAdd(reactor * r, reactor_waiter * waiter)
+    {
+        BASIS_UNUSED(r);
+        BASIS_UNUSED(waiter);
+    }
+
+    bool ReactorBusy(reactor * r)
+    {
+        BASIS_UNUSED(r);
+        return false;
+    }
+
+    void ReactorPoll(reactor * r)
+    {
+        BASIS_UNUSED(r);
+    }
+
+    void ReactorWait(reactor * r, int64_t deadline)
+    {
+        BASIS_UNUSED(r);
+        BASIS_UNUSED(deadline);
+    }
+
+    void ReactorWake(void * r)
+    {
+        BASIS_UNUSED(r);
+    }
+}
@@ -0,0 +1,175 @@
+/*
+Chris Lentini
+http://divergentcoder.io
+
+This source code is licensed under the MIT license (found in the LICENSE file in the root directory of the project)
+*/
+
+#include <Windows.h>
+#include <algorithm>
+#include <bit>
+#include <thread>
+
+#include <basis/assert.h>
+
+#include "../topology.h"
+
+// Only the processor group the process starts in is considered, so at most 64 cpus
+
+namespace taco
+{
+    static uint32_t LowestBit(ULONG_PTR mask)
+    {
+        for (uint32_t i=0; i<sizeof(mask) * 8; i++)
+        {
+            if (mask & (ULONG_PTR(1) << i))
+            {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    cpu_topology ReadCpuTopology()
+    {
+        cpu_topology topology;
+        topology.nodeCount = 1;
+
+        DWORD length = 0;
+        GetLogicalProcessorInformation(nullptr, &length);
+        std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infos(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+
+        if (infos.empty() || !GetLogicalProcessorInformation(infos.data(), &length))
+        {
+            uint32_t count = std::max<uint32_t>(1, std::thread::hardware_concurrency());
+            for (uint32_t i=0; i<count; i++)
+            {
+                topology.cpus.push_back({ i, i, 0, 0, 0 });
+            }
+            return topology;
+        }
+
+        DWORD_PTR process_mask = 0;
+        DWORD_PTR system_mask = 0;
+        GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask);
+        for (uint32_t i=0; i<sizeof(process_mask) * 8; i++)
+        {
+            if (process_mask & (DWORD_PTR(1) << i))
+            {
+                topology.cpus.push_back({ i, i, 0, 0, 0 });
+            }
+        }
+
+        for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION & info : infos)
+        {
+            for (cpu_info & cpu : topology.cpus)
+            {
+                ULONG_PTR bit = ULONG_PTR(1) << cpu.cpu;
+                if ((info.ProcessorMask & bit) == 0)
+                {
+                    continue;
+                }
+
+                switch (info.Relationship)
+                {
+                case RelationProcessorCore:
+                    cpu.core = LowestBit(info.ProcessorMask);
+                    cpu.thread = uint32_t(std::popcount(uint64_t(info.ProcessorMask & (bit - 1))));
+                    break;
+                case RelationCache:
+                    if (info.Cache.Level == 3)
+                    {
+                        cpu.cache = LowestBit(info.ProcessorMask);
+                    }
+                    break;
+                case RelationNumaNode:
+                    cpu.node = info.NumaNode.NodeNumber;
+                    topology.nodeCount = std::max(topology.nodeCount, uint32_t(info.NumaNode.NodeNumber + 1));
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+
+        std::stable_sort(topology.cpus.begin(), topology.cpus.end(), [](const cpu_info & a, const cpu_info & b) -> bool {
+            if (a.thread != b.thread) return a.thread < b.thread;
+            if (a.node != b.node) return a.node < b.node;
+            if (a.cache != b.cache) return a.cache < b.cache;
+            return a.core < b.core;
+        });
+
+        return topology;
+    }
+
+    void * NodeReserve(size_t size)
+    {
+        void * ptr = VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+        BASIS_ASSERT(ptr != nullptr);
+        return ptr;
+    }
+
+    void NodeCommit(void * ptr, size_t size, uint32_t node)
+    {
+        void * committed = (node == any_node) ? nullptr :
+            VirtualAllocExNuma(GetCurrentProcess(), ptr, size, MEM_COMMIT, PAGE_READWRITE, node);
+        if (!committed)
+        {
+            // Not a valid node for this machine, any memory will do
+            committed = VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE);
+        }
+        BASIS_ASSERT(committed != nullptr);
+    }
+
+    void NodeRelease(void * ptr, size_t size)
+    {
+        BASIS_UNUSED(size);
+        VirtualFree(ptr, 0, MEM_RELEASE);
+    }
+
+    static bool SetAffinity(HANDLE thread, const std::vector<uint32_t> & cpus)
+    {
+        DWORD_PTR mask = 0;
+        for (uint32_t cpu : cpus)
+        {
+            if (cpu >= sizeof(mask) * 8)
+            {
+                return false;
+            }
+            mask |= DWORD_PTR(1) << cpu;
+        }
+        return mask != 0 && SetThreadAffinityMask(thread, mask) != 0;
+    }
+
+    bool SetThreadAffinity(std::thread & thread, const std::vector<uint32_t> & cpus)
+    {
+        return SetAffinity(thread.native_handle(), cpus);
+    }
+
+    bool SetThreadAffinity(const std::vector<uint32_t> & cpus)
+    {
+        return SetAffinity(GetCurrentThread(), cpus);
+    }
+
+    std::vector<uint32_t> GetThreadAffinity()
+    {
+        // There is no GetThreadAffinityMask, setting it hands back the previous one
+        std::vector<uint32_t> cpus;
+        DWORD_PTR process_mask = 0;
+        DWORD_PTR system_mask = 0;
+        GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask);
+        DWORD_PTR mask = SetThreadAffinityMask(GetCurrentThread(), process_mask);
+        if (mask != 0)
+        {
+            SetThreadAffinityMask(GetCurrentThread(), mask);
+            for (uint32_t i=0; i<sizeof(mask) * 8; i++)
+            {
+                if (mask & (DWORD_PTR(1) << i))
+                {
+                    cpus.push_back(i);
+                }
+            }
+        }
+        return cpus;
+    }
+}
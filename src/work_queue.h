@@ -8,6 +8,11 @@ This source code is licensed under the MIT license (found in the LICENSE file in
 #pragma once
 
 #include <atomic>
+#include <vector>
+#include <type_traits>
+#include <stdint.h>
+
+#include <basis/assert.h>
 
 namespace taco
 {
@@ -86,4 +91,227 @@ namespace taco
         std::atomic<uint32_t> m_tail            { 0xffffffff };
         TYPE                  m_items[CAPACITY] {};
     };
-}
\ No newline at end of file
+
+    /// @brief Growable, single-producer, single-consumer (same thread) work stealing deque
+    /// Chase-Lev deque using the C11 memory model formulation from
+    /// "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al., PPoPP '13)
+    /// The owning thread pushes and pops at the bottom, any thread may steal from the top.
+    /// When full the circular buffer is doubled; thieves may still be reading from the old
+    /// buffer so it is retired rather than freed, and retired buffers are released when the
+    /// deque is destroyed (they sum to less than the size of the live buffer).
+    /// @tparam TYPE data type stored by the queue. Slots are read speculatively by thieves
+    /// so it must be trivially copyable (i.e. store pointers to anything more complex)
+    template<class TYPE>
+    class work_deque
+    {
+        static_assert(std::is_trivially_copyable<TYPE>::value, "work_deque items must be trivially copyable");
+
+        struct buffer
+        {
+            buffer(int64_t capacity)
+                :   capacity(capacity),
+                    items(new std::atomic<TYPE>[capacity])
+            {}
+
+            ~buffer()
+            {
+                delete [] items;
+            }
+
+            TYPE get(int64_t index) const
+            {
+                return items[index & (capacity - 1)].load(std::memory_order_relaxed);
+            }
+
+            void put(int64_t index, TYPE item)
+            {
+                items[index & (capacity - 1)].store(item, std::memory_order_relaxed);
+            }
+
+            buffer * grow(int64_t bottom, int64_t top, int64_t newCapacity) const
+            {
+                buffer * b = new buffer(newCapacity);
+                for (int64_t i=top; i<bottom; i++)
+                {
+                    b->put(i, get(i));
+                }
+                return b;
+            }
+
+            const int64_t        capacity;
+            std::atomic<TYPE> *  items;
+        };
+
+    public:
+        /// @param capacity initial number of slots. Must be a power of 2
+        explicit work_deque(int64_t capacity = 256)
+            :   m_buffer(new buffer(capacity))
+        {
+            BASIS_ASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0);
+        }
+
+        ~work_deque()
+        {
+            delete m_buffer.load(std::memory_order_relaxed);
+            for (buffer * b : m_retired)
+            {
+                delete b;
+            }
+        }
+
+        work_deque(const work_deque &) = delete;
+        work_deque & operator = (const work_deque &) = delete;
+
+        /// @brief Adds a single item to the bottom of the deque, growing it if needed
+        /// Must only be called by the owning thread
+        /// @param item
+        void push(TYPE item)
+        {
+            int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+            buffer * b = reserve(bottom, 1);
+
+            b->put(bottom, item);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        /// @brief Adds a number of items to the bottom of the deque in one go, they
+        /// only become visible to thieves once all of them have been written
+        /// Must only be called by the owning thread
+        /// @param items
+        /// @param count
+        void push(const TYPE * items, int64_t count)
+        {
+            int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+            buffer * b = reserve(bottom, count);
+
+            for (int64_t i=0; i<count; i++)
+            {
+                b->put(bottom + i, items[i]);
+            }
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bottom.store(bottom + count, std::memory_order_relaxed);
+        }
+
+        /// @brief Removes a single item from the bottom of the deque (LIFO)
+        /// Must only be called by the owning thread
+        /// @param item 
+        /// @return 
+        bool pop(TYPE & item)
+        {
+            int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+            buffer * b = m_buffer.load(std::memory_order_relaxed);
+            m_bottom.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t top = m_top.load(std::memory_order_relaxed);
+
+            if (top > bottom)
+            {
+                // empty
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            item = b->get(bottom);
+            if (top == bottom)
+            {
+                // last item, race any thieves for it
+                bool won = m_top.compare_exchange_strong(top, top + 1, 
+                    std::memory_order_seq_cst, std::memory_order_relaxed);
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+                return won;
+            }
+
+            return true;
+        }
+
+        /// @brief Removes a single item from the top of the deque (FIFO)
+        /// May be called from any thread. Returns false if the deque was empty
+        /// or we lost a race for the item with another thread
+        /// @param item 
+        /// @return 
+        bool steal(TYPE & item)
+        {
+            int64_t top = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+            if (top < bottom)
+            {
+                // consume ordering is what is actually required here, but compilers
+                // promote it to acquire anyway
+                buffer * b = m_buffer.load(std::memory_order_acquire);
+                TYPE tmp = b->get(top);
+                if (m_top.compare_exchange_strong(top, top + 1, 
+                    std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    item = tmp;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        /// @brief Steals up to half of the items in the deque, and no more than max, from the top
+        /// May be called from any thread. Items are still claimed one at a time - the owner pops
+        /// from the bottom without synchronizing unless a single item is left, so a thief can't
+        /// safely claim a whole range at once - but the victim is only looked up once per batch.
+        /// @param items receives the stolen items, oldest first
+        /// @param max 
+        /// @return the number of items stolen
+        int64_t steal_half(TYPE * items, int64_t max)
+        {
+            int64_t top = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+            int64_t count = (bottom - top + 1) / 2;
+            count = count < max ? count : max;
+
+            int64_t stolen = 0;
+            while (stolen < count && steal(items[stolen]))
+            {
+                stolen++;
+            }
+            return stolen;
+        }
+
+        /// @brief Approximate number of items in the deque
+        /// Only exact when called by the owning thread with no concurrent thieves
+        int64_t size() const
+        {
+            int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+            int64_t top = m_top.load(std::memory_order_relaxed);
+            return bottom > top ? (bottom - top) : 0;
+        }
+
+    private:
+        // Returns a buffer with room for count more items, growing if needed
+        buffer * reserve(int64_t bottom, int64_t count)
+        {
+            int64_t top = m_top.load(std::memory_order_acquire);
+            buffer * b = m_buffer.load(std::memory_order_relaxed);
+
+            if ((bottom - top + count) > b->capacity)
+            {
+                int64_t capacity = b->capacity * 2;
+                while ((bottom - top + count) > capacity)
+                {
+                    capacity *= 2;
+                }
+
+                m_retired.push_back(b);
+                b = b->grow(bottom, top, capacity);
+                m_buffer.store(b, std::memory_order_release);
+            }
+
+            return b;
+        }
+
+        alignas(64) std::atomic<int64_t>    m_top       { 0 };
+        alignas(64) std::atomic<int64_t>    m_bottom    { 0 };
+        std::atomic<buffer *>               m_buffer;
+        std::vector<buffer *>               m_retired;
+    };
+}
@@ -10,11 +10,32 @@ TACO_INCLUDE_DIR	:= $(TACO_ROOT)/include
 TACO_DEFINES		:=
 TACO_CPPFLAGS		:=
 
+# Fiber context switch implementation used on posix platforms
+#	asm      - hand written switch (x86_64 and arm64, other architectures fall back to ucontext)
+#	ucontext - getcontext/makecontext bootstrap with setjmp/longjmp switching
+TACO_FIBER_BACKEND	?= asm
+
 ifeq ($(PLATFORM),posix)
 	TACO_DEFINES += _XOPEN_SOURCE
 	TACO_SOURCES += src/posix/fiber_impl.cpp
+	TACO_SOURCES += src/posix/fiber_stack.cpp
+	TACO_SOURCES += src/posix/futex.cpp
+	TACO_SOURCES += src/posix/topology.cpp
+	TACO_SOURCES += src/posix/io.cpp
+	TACO_SOURCES += src/posix/io_ring.cpp
+	TACO_SOURCES += src/posix/net.cpp
+	TACO_SOURCES += src/posix/reactor.cpp
+	ifeq ($(TACO_FIBER_BACKEND),ucontext)
+		TACO_DEFINES += TACO_FIBER_USE_UCONTEXT
+	else ifneq ($(TACO_FIBER_BACKEND),asm)
+		$(error Unrecognized TACO_FIBER_BACKEND "$(TACO_FIBER_BACKEND)" - must be asm | ucontext)
+	endif
 else ifeq ($(PLATFORM),windows)
 	TACO_SOURCES += src/windows/fiber_impl.cpp
+	TACO_SOURCES += src/windows/futex.cpp
+	TACO_SOURCES += src/windows/topology.cpp
+	TACO_SOURCES += src/windows/io_ring.cpp
+	TACO_SOURCES += src/windows/reactor.cpp
 endif
 
 TACO_OBJECTS       	:= $(TACO_SOURCES:%.cpp=$(INTERMEDIATE_DIR)/taco/%.o)
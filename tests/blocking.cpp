@@ -2,7 +2,9 @@
 #include <basis/thread_util.h>
 #include <taco/taco.h>
 #include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <vector>
 
 #define TASK_MIN 128
 #define TASK_MAX 256
@@ -13,10 +15,14 @@
 
 void test_independent();
 void test_dependent();
+void test_thread_limit();
+void test_idle_reaping();
 
 BASIS_TEST_LIST_BEGIN()
     BASIS_DECLARE_TEST(test_independent)
     BASIS_DECLARE_TEST(test_dependent)
+    BASIS_DECLARE_TEST(test_thread_limit)
+    BASIS_DECLARE_TEST(test_idle_reaping)
 BASIS_TEST_LIST_END()
 
 void dependent(bool blocking, unsigned ntasks, unsigned sleeptime, unsigned cputime)
@@ -155,6 +161,77 @@ void test_independent()
     taco::Shutdown();
 }
 
+// Runs count blocking sections at once, returns the most that were ever inside at the same time
+uint32_t concurrent_sections(uint32_t count, std::chrono::milliseconds duration)
+{
+    std::atomic<uint32_t> inside(0);
+    std::atomic<uint32_t> peak(0);
+    std::vector<taco::future<void>> sections;
+    for (uint32_t i=0; i<count; i++)
+    {
+        sections.push_back(taco::Start([&]() -> void {
+            taco::BeginBlocking();
+            uint32_t now = ++inside;
+            uint32_t prev = peak.load();
+            while (prev < now && !peak.compare_exchange_weak(prev, now))
+            {
+            }
+            std::this_thread::sleep_for(duration);
+            inside--;
+            taco::EndBlocking();
+        }));
+    }
+    for (taco::future<void> & section : sections)
+    {
+        section.await();
+    }
+    return peak;
+}
+
+void test_thread_limit()
+{
+    taco::scheduler_options options;
+    options.blocking.thread_limit = 2;
+    taco::Initialize([&]() -> void {
+        uint32_t peak = concurrent_sections(16, std::chrono::milliseconds(10));
+        BASIS_TEST_VERIFY_MSG(peak <= 2, "%u sections ran at once with a limit of 2", peak);
+
+        taco::blocking_stats stats = taco::GetBlockingStats();
+        BASIS_TEST_VERIFY(stats.sections == 16);
+        BASIS_TEST_VERIFY(stats.threads_started <= 2);
+        BASIS_TEST_VERIFY(stats.queued > 0);
+        BASIS_TEST_VERIFY(stats.max_blocked_ns >= 10000000);
+        // Most of the sections had to wait for one of the two threads to free up
+        BASIS_TEST_VERIFY(stats.max_handoff_ns >= 10000000);
+
+        taco::SetBlockingThreadLimit(8);
+        peak = concurrent_sections(16, std::chrono::milliseconds(10));
+        BASIS_TEST_VERIFY_MSG(peak > 2 && peak <= 8, "%u sections ran at once with a limit of 8", peak);
+    }, options);
+    taco::Shutdown();
+}
+
+void test_idle_reaping()
+{
+    taco::scheduler_options options;
+    options.blocking.idle_timeout = std::chrono::milliseconds(20);
+    taco::Initialize([&]() -> void {
+        concurrent_sections(4, std::chrono::milliseconds(1));
+        taco::blocking_stats stats = taco::GetBlockingStats();
+        BASIS_TEST_VERIFY(stats.threads_started > 0);
+
+        taco::SleepFor(std::chrono::milliseconds(200));
+        stats = taco::GetBlockingStats();
+        BASIS_TEST_VERIFY_MSG(stats.threads == 0, "%u blocking threads still running", stats.threads);
+        BASIS_TEST_VERIFY(stats.threads_reaped == stats.threads_started);
+
+        // And started again when needed
+        concurrent_sections(4, std::chrono::milliseconds(1));
+        BASIS_TEST_VERIFY(taco::GetBlockingStats().sections == 8);
+    }, options);
+    taco::Shutdown();
+}
+
 int main(int argc, char * argv[])
 {
     BASIS_UNUSED(argc, argv);
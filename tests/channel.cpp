@@ -0,0 +1,287 @@
+#include <basis/unit_test.h>
+#include <taco/taco.h>
+#include <basis/timer.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <stdio.h>
+
+void test_mpmc();
+void test_close();
+void test_batch();
+void test_select();
+void test_move_only();
+
+BASIS_TEST_LIST_BEGIN()
+    BASIS_DECLARE_TEST(test_mpmc)
+    BASIS_DECLARE_TEST(test_close)
+    BASIS_DECLARE_TEST(test_batch)
+    BASIS_DECLARE_TEST(test_select)
+    BASIS_DECLARE_TEST(test_move_only)
+BASIS_TEST_LIST_END()
+
+static const uint32_t num_producers = 4;
+static const uint32_t num_consumers = 4;
+static const uint32_t num_values = 100000;
+
+// Every value sent by num_producers tasks is received exactly once by num_consumers tasks
+static void send_receive(const char * label, taco::channel<uint32_t> & ch)
+{
+    auto ts = basis::GetTimestamp();
+
+    std::atomic<uint64_t> sum(0);
+    std::atomic<uint32_t> received(0);
+    taco::task_group consumers;
+    for (uint32_t c=0; c<num_consumers; c++)
+    {
+        consumers.run([&]() -> void {
+            uint64_t local = 0;
+            uint32_t count = 0;
+            uint32_t value;
+            while (ch.receive(value))
+            {
+                local += value;
+                count++;
+            }
+            sum += local;
+            received += count;
+        });
+    }
+
+    taco::task_group producers;
+    for (uint32_t p=0; p<num_producers; p++)
+    {
+        producers.run([&]() -> void {
+            for (uint32_t i=0; i<num_values; i++)
+            {
+                ch.send(i);
+            }
+        });
+    }
+    producers.wait();
+    ch.close();
+    consumers.wait();
+
+    uint64_t ms = basis::GetTimeDeltaMS(ts, basis::GetTimestamp());
+    printf("  %s: %llu ms for %u values\n", label, (unsigned long long) ms, num_producers * num_values);
+
+    uint64_t expected = uint64_t(num_producers) * (uint64_t(num_values) * (num_values - 1) / 2);
+    BASIS_TEST_VERIFY_MSG(received == num_producers * num_values, "Received %u values", received.load());
+    BASIS_TEST_VERIFY_MSG(sum == expected, "Received values summed to %llu, expected %llu", (unsigned long long) sum.load(), (unsigned long long) expected);
+}
+
+void test_mpmc()
+{
+    taco::Initialize([]() -> void {
+        {
+            taco::channel<uint32_t> ch;
+            send_receive("unbounded channel", ch);
+        }
+        {
+            taco::channel<uint32_t> ch(64);
+            send_receive("channel, capacity 64", ch);
+        }
+        {
+            taco::channel<uint32_t> ch(1);
+            send_receive("channel, capacity 1", ch);
+        }
+    });
+    taco::Shutdown();
+}
+
+void test_close()
+{
+    taco::Initialize([]() -> void {
+        taco::channel<int> ch(2);
+        BASIS_TEST_VERIFY(ch.try_send(1) == taco::channel_status::ok);
+        BASIS_TEST_VERIFY(ch.try_send(2) == taco::channel_status::ok);
+        BASIS_TEST_VERIFY(ch.try_send(3) == taco::channel_status::would_block);
+
+        // Both wait for room, until the channel is closed on them
+        std::atomic<int> failed(0);
+        taco::task_group senders;
+        for (int i=0; i<2; i++)
+        {
+            senders.run([&]() -> void {
+                if (!ch.send(10))
+                {
+                    failed++;
+                }
+            });
+        }
+        taco::SleepFor(std::chrono::milliseconds(10));
+
+        BASIS_TEST_VERIFY(ch.close());
+        BASIS_TEST_VERIFY(!ch.close());
+        senders.wait();
+        BASIS_TEST_VERIFY(failed == 2);
+        BASIS_TEST_VERIFY(!ch.send(4));
+        BASIS_TEST_VERIFY(ch.try_send(4) == taco::channel_status::closed);
+
+        // What was sent before closing can still be received
+        int value = 0;
+        BASIS_TEST_VERIFY(ch.receive(value) && value == 1);
+        BASIS_TEST_VERIFY(ch.try_receive(value) == taco::channel_status::ok && value == 2);
+        BASIS_TEST_VERIFY(!ch.receive(value));
+        BASIS_TEST_VERIFY(ch.try_receive(value) == taco::channel_status::closed);
+
+        // A receiver waiting on an empty channel is woken by it closing
+        taco::channel<int> empty;
+        auto receiver = taco::Start([&]() -> bool {
+            int v;
+            return empty.receive(v);
+        });
+        taco::SleepFor(std::chrono::milliseconds(10));
+        empty.close();
+        BASIS_TEST_VERIFY(!receiver.await());
+    }, 2);
+    taco::Shutdown();
+}
+
+void test_batch()
+{
+    static const uint32_t count = 100000;
+
+    taco::Initialize([]() -> void {
+        taco::channel<uint32_t> ch(100);
+        taco::task_group group;
+        group.run([&]() -> void {
+            std::vector<uint32_t> values(1000);
+            for (uint32_t i=0; i<count; i+=1000)
+            {
+                for (uint32_t j=0; j<1000; j++)
+                {
+                    values[j] = i + j;
+                }
+                ch.send(values.begin(), values.end());
+            }
+            ch.close();
+        });
+
+        auto ts = basis::GetTimestamp();
+        uint32_t buffer[256];
+        uint32_t expected = 0;
+        bool ordered = true;
+        size_t n;
+        while ((n = ch.receive(buffer, 256)) > 0)
+        {
+            for (size_t i=0; i<n; i++)
+            {
+                ordered = ordered && buffer[i] == expected++;
+            }
+        }
+        group.wait();
+        uint64_t ms = basis::GetTimeDeltaMS(ts, basis::GetTimestamp());
+        printf("  batches of 1000 in, 256 out: %llu ms for %u values\n", (unsigned long long) ms, count);
+        BASIS_TEST_VERIFY_MSG(ordered && expected == count, "Received %u values, expected %u in order", expected, count);
+
+        // Only what was sent before closing
+        taco::channel<int> closed;
+        closed.close();
+        int values[] = { 1, 2, 3 };
+        BASIS_TEST_VERIFY(closed.send(values, values + 3) == 0);
+        BASIS_TEST_VERIFY(closed.receive(values, 3) == 0);
+    }, 2);
+    taco::Shutdown();
+}
+
+void test_select()
+{
+    taco::Initialize([]() -> void {
+        taco::channel<int> a;
+        taco::channel<int> b(1);
+        taco::channel<int> out(1);
+
+        int from_a = 0;
+        int from_b = 0;
+        BASIS_TEST_VERIFY(taco::try_select(taco::receive_from(a, from_a), taco::receive_from(b, from_b)).index == SIZE_MAX);
+
+        // The first ready case wins
+        b.send(20);
+        a.send(10);
+        taco::select_result r = taco::select(taco::receive_from(a, from_a), taco::receive_from(b, from_b));
+        BASIS_TEST_VERIFY(r.index == 0 && r.ok && from_a == 10);
+        r = taco::select(taco::receive_from(a, from_a), taco::receive_from(b, from_b));
+        BASIS_TEST_VERIFY(r.index == 1 && r.ok && from_b == 20);
+
+        // Sending as well as receiving, out has room
+        int value = 30;
+        r = taco::select(taco::receive_from(a, from_a), taco::send_to(out, value));
+        BASIS_TEST_VERIFY(r.index == 1 && r.ok);
+        BASIS_TEST_VERIFY(out.try_receive(value) == taco::channel_status::ok && value == 30);
+
+        // Waiting on two channels for many values from several tasks
+        static const int num_senders = 4;
+        static const int num_sent = 10000;
+        taco::task_group senders;
+        for (int s=0; s<num_senders; s++)
+        {
+            senders.run([&, s]() -> void {
+                for (int i=0; i<num_sent; i++)
+                {
+                    (s & 1 ? b : a).send(1);
+                }
+            });
+        }
+
+        int totals[2] = {};
+        for (int i=0; i<num_senders*num_sent; i++)
+        {
+            r = taco::select(taco::receive_from(a, from_a), taco::receive_from(b, from_b));
+            totals[r.index] += r.index ? from_b : from_a;
+        }
+        senders.wait();
+        BASIS_TEST_VERIFY_MSG(totals[0] == num_senders / 2 * num_sent && totals[1] == num_senders / 2 * num_sent,
+            "Received %d from a and %d from b", totals[0], totals[1]);
+
+        // Closing completes a case, without a value
+        b.close();
+        r = taco::select(taco::receive_from(a, from_a), taco::receive_from(b, from_b));
+        BASIS_TEST_VERIFY(r.index == 1 && !r.ok);
+    }, 2);
+    taco::Shutdown();
+}
+
+void test_move_only()
+{
+    taco::Initialize([]() -> void {
+        typedef std::unique_ptr<int> value;
+
+        taco::channel<value> bounded(4);
+        taco::channel<value> unbounded;
+        taco::task_group group;
+        group.run([&]() -> void {
+            for (int i=0; i<1000; i++)
+            {
+                bounded.send(std::make_unique<int>(i));
+            }
+            bounded.close();
+        });
+
+        value v;
+        int expected = 0;
+        while (bounded.receive(v))
+        {
+            BASIS_TEST_VERIFY(v && *v == expected);
+            expected++;
+            unbounded.send(std::move(v));
+        }
+        group.wait();
+        BASIS_TEST_VERIFY(expected == 1000);
+
+        // A send that doesn't complete leaves the value alone
+        value kept = std::make_unique<int>(-1);
+        bounded.try_send(std::move(kept));
+        BASIS_TEST_VERIFY(kept && *kept == -1);
+
+        // Whatever is left is destroyed with the channel
+        BASIS_TEST_VERIFY(unbounded.try_receive(v) == taco::channel_status::ok && *v == 0);
+    }, 2);
+    taco::Shutdown();
+}
+
+int main()
+{
+    BASIS_RUN_TESTS();
+    return 0;
+}
@@ -1,15 +1,25 @@
 #include <basis/unit_test.h>
 #include <taco/taco.h>
 #include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <string>
 #include <vector>
 
 void test_fib();
 void test_fibcollatz();
+void test_then();
+void test_when_all();
+void test_when_any();
+void test_await_inline();
 
 BASIS_TEST_LIST_BEGIN()
     BASIS_DECLARE_TEST(test_fibcollatz)
     BASIS_DECLARE_TEST(test_fib)
+    BASIS_DECLARE_TEST(test_then)
+    BASIS_DECLARE_TEST(test_when_all)
+    BASIS_DECLARE_TEST(test_when_any)
+    BASIS_DECLARE_TEST(test_await_inline)
 BASIS_TEST_LIST_END()
 
 void test_fibcollatz()
@@ -48,8 +58,8 @@ unsigned fibonacci(unsigned n)
 {
     if (n < 2) return 1;
 
-    auto a = taco::Start("fibonacci", [=](){ return fibonacci(n - 1); });
-    auto b = taco::Start("fibonacci", [=](){ return fibonacci(n - 2); });
+    auto a = taco::Start(TACO_TASK_NAME("fibonacci"), [=](){ return fibonacci(n - 1); });
+    auto b = taco::Start(TACO_TASK_NAME("fibonacci"), [=](){ return fibonacci(n - 2); });
 
     return a + b;
 }
@@ -77,6 +87,154 @@ void test_fib()
     taco::Shutdown();
 }
 
+void test_then()
+{
+    static const uint32_t pipeline_length = 10000;
+
+    taco::Initialize();
+
+    taco::Schedule([]() -> void {
+        taco::future<std::string> f = taco::Start([]() -> int { return 20; })
+            .then([](int v) -> int { return v + 1; })
+            .then([](int v) -> std::string { return std::to_string(v * 2); });
+        BASIS_TEST_VERIFY(f.await() == "42");
+
+        // Continuations added once the value is there are scheduled straight away
+        taco::future<int> ready = taco::Start([]() -> int { return 7; });
+        BASIS_TEST_VERIFY(ready == 7);
+        BASIS_TEST_VERIFY(ready.then([](int v) -> int { return v * 3; }) == 21);
+
+        std::atomic<bool> ran(false);
+        taco::future<void> done = taco::Start([]() -> void {}).then([&]() -> void { ran = true; });
+        done.await();
+        BASIS_TEST_VERIFY(ran);
+
+        // Nothing waits on the steps in between
+        taco::future<uint32_t> chain = taco::Start([]() -> uint32_t { return 0; });
+        for (uint32_t i=0; i<pipeline_length; i++)
+        {
+            chain = chain.then([](uint32_t v) -> uint32_t { return v + 1; });
+        }
+        BASIS_TEST_VERIFY_MSG(chain == pipeline_length, "Pipeline ended with %u", chain.await());
+
+        taco::ExitMain();
+    }, 0);
+
+    taco::EnterMain();
+    taco::Shutdown();
+}
+
+void test_when_all()
+{
+    taco::Initialize();
+
+    taco::Schedule([]() -> void {
+        std::vector<taco::future<uint32_t>> futures;
+        for (uint32_t i=0; i<100; i++)
+        {
+            futures.push_back(taco::Start([=]() -> uint32_t { return fibonacci(i % 10); }));
+        }
+        taco::future<uint32_t> sum = taco::when_all(std::move(futures)).then([](std::vector<taco::future<uint32_t>> all) -> uint32_t {
+            uint32_t total = 0;
+            for (taco::future<uint32_t> & f : all)
+            {
+                BASIS_TEST_VERIFY(f.ready());
+                total += f;
+            }
+            return total;
+        });
+        BASIS_TEST_VERIFY_MSG(sum == 1430, "Sum was %u", sum.await());
+
+        auto mixed = taco::when_all(
+            taco::Start([]() -> int { return 1; }),
+            taco::Start([]() -> std::string { return "two"; }),
+            taco::Start([]() -> void {})).await();
+        BASIS_TEST_VERIFY(std::get<0>(mixed) == 1);
+        BASIS_TEST_VERIFY(std::get<1>(mixed).await() == "two");
+        BASIS_TEST_VERIFY(std::get<2>(mixed).ready());
+
+        BASIS_TEST_VERIFY(taco::when_all(std::vector<taco::future<int>>()).ready());
+
+        taco::ExitMain();
+    }, 0);
+
+    taco::EnterMain();
+    taco::Shutdown();
+}
+
+void test_when_any()
+{
+    taco::Initialize();
+
+    taco::Schedule([]() -> void {
+        taco::event release;
+        std::vector<taco::future<int>> futures;
+        for (int i=0; i<8; i++)
+        {
+            futures.push_back(taco::Start([&release, i]() -> int {
+                if (i != 5)
+                {
+                    release.wait();
+                }
+                return i;
+            }));
+        }
+        auto first = taco::when_any(futures).await();
+        BASIS_TEST_VERIFY_MSG(first.index == 5, "First was %zu", first.index);
+        BASIS_TEST_VERIFY(first.futures[5] == 5);
+
+        release.signal();
+        taco::when_all(std::move(futures)).await();
+
+        auto pair = taco::when_any(taco::Start([]() -> int { return 1; }), taco::Start([]() -> bool { return true; })).await();
+        BASIS_TEST_VERIFY(pair.index < 2);
+
+        BASIS_TEST_VERIFY(taco::when_any(std::vector<taco::future<int>>()).await().index == SIZE_MAX);
+
+        taco::ExitMain();
+    }, 0);
+
+    taco::EnterMain();
+    taco::Shutdown();
+}
+
+void test_await_inline()
+{
+    // One thread, so nothing can start the tasks but us. The main task is bound to it, and bound
+    // tasks don't run others inline, so it all happens in one started from there
+    taco::Initialize([]() -> void {
+        taco::Start("parent", []() -> void {
+            int local = 0;
+            taco::SetTaskLocalData(&local);
+            uint64_t id = taco::GetTaskId();
+
+            std::vector<std::string> order;
+            auto child = [&](const char * name) -> uint64_t {
+                order.push_back(name);
+                BASIS_TEST_VERIFY(taco::GetTaskLocalData() == nullptr);
+                BASIS_TEST_VERIFY(std::string(taco::GetTaskName()) == name);
+                return taco::GetTaskId();
+            };
+            taco::future<uint64_t> first = taco::Start("first", [&]() -> uint64_t { return child("first"); });
+            taco::future<uint64_t> second = taco::Start("second", [&]() -> uint64_t { return child("second"); });
+
+            // Run right away by the await, ahead of second which would otherwise go first
+            uint64_t firstId = first;
+            BASIS_TEST_VERIFY(order.size() == 1 && order[0] == "first");
+            BASIS_TEST_VERIFY(firstId != id);
+            BASIS_TEST_VERIFY(taco::GetTaskId() == id);
+            BASIS_TEST_VERIFY(taco::GetTaskLocalData() == &local);
+            BASIS_TEST_VERIFY(std::string(taco::GetTaskName()) == "parent");
+
+            // Already run by the time it is taken off the queue
+            taco::Switch();
+            BASIS_TEST_VERIFY(order.size() == 2 && second.ready());
+            BASIS_TEST_VERIFY(second.await() != firstId);
+        }).await();
+    }, 1);
+    taco::Shutdown();
+}
+
 int main()
 {
     BASIS_RUN_TESTS();
@@ -1,12 +1,20 @@
 #include <basis/unit_test.h>
 #include <taco/taco.h>
+#include <basis/timer.h>
 #include <algorithm>
 #include <iostream>
+#include <memory>
+#include <vector>
+#include <stdio.h>
 
 void test_generators();
+void test_buffered();
+void test_move_only();
 
 BASIS_TEST_LIST_BEGIN()
     BASIS_DECLARE_TEST(test_generators)
+    BASIS_DECLARE_TEST(test_buffered)
+    BASIS_DECLARE_TEST(test_move_only)
 BASIS_TEST_LIST_END()
 
 void test_generators()
@@ -41,6 +49,88 @@ void test_generators()
     taco::Shutdown();
 }
 
+// Reads count values from a generator yielding 0, 1, 2, ... and returning count
+static void read_sequence(uint32_t count, uint32_t capacity, size_t batch)
+{
+    auto gen = taco::StartGenerator([=]() -> uint32_t {
+        for (uint32_t i=0; i<count; i++)
+        {
+            taco::YieldValue(i);
+        }
+        return count;
+    }, taco::generator_buffer { capacity });
+
+    auto ts = basis::GetTimestamp();
+    std::vector<uint32_t> values(batch);
+    uint32_t expected = 0;
+    bool ordered = true;
+    for (;;)
+    {
+        size_t n = gen.read(values.data(), batch);
+        if (n == 0)
+        {
+            break;
+        }
+        for (size_t i=0; i<n; i++)
+        {
+            ordered = ordered && values[i] == expected++;
+        }
+    }
+    uint64_t ms = basis::GetTimeDeltaMS(ts, basis::GetTimestamp());
+    printf("  capacity %u, batch %zu: %llu ms for %u values\n", capacity, batch, (unsigned long long) ms, count);
+
+    BASIS_TEST_VERIFY_MSG(ordered && expected == count, "Read %u values, expected %u in order", expected, count);
+    BASIS_TEST_VERIFY(gen.completed());
+    uint32_t returned = 0;
+    BASIS_TEST_VERIFY(!gen.read(returned) && returned == count);
+}
+
+void test_buffered()
+{
+    static const uint32_t num_values = 1000000;
+
+    taco::Initialize([]() -> void {
+        read_sequence(num_values, 0, 1);
+        read_sequence(num_values, 1, 1);
+        read_sequence(num_values, 256, 1);
+        read_sequence(num_values, 256, 256);
+        read_sequence(num_values, 1000, 64);
+    });
+    taco::Shutdown();
+}
+
+void test_move_only()
+{
+    taco::Initialize([]() -> void {
+        typedef std::unique_ptr<std::vector<int>> block;
+        auto gen = taco::StartGenerator([]() -> block {
+            for (int i=0; i<100; i++)
+            {
+                block b = std::make_unique<std::vector<int>>(1000, i);
+                taco::YieldValue(std::move(b));
+                taco::EmplaceValue<block>(new std::vector<int>(10, -i));
+            }
+            return nullptr;
+        }, taco::generator_buffer { 8 });
+
+        int count = 0;
+        bool matched = true;
+        while (gen.consume([&](block & b) -> void {
+            // Looked at where it sits in the buffer
+            int expected = (count & 1) ? -(count / 2) : (count / 2);
+            matched = matched && b && b->size() == ((count & 1) ? 10u : 1000u) && b->front() == expected;
+            count++;
+        }) > 0)
+        {
+        }
+        BASIS_TEST_VERIFY_MSG(matched && count == 200, "Consumed %d blocks", count);
+
+        block last = std::make_unique<std::vector<int>>();
+        BASIS_TEST_VERIFY(!gen.read(last) && !last);
+    }, 2);
+    taco::Shutdown();
+}
+
 int main()
 {
     BASIS_RUN_TESTS();
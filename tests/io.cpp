@@ -0,0 +1,146 @@
+#include <basis/unit_test.h>
+#include <taco/taco.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+void test_read_write();
+void test_read_write_blocking();
+void test_file_position();
+void test_errors();
+
+BASIS_TEST_LIST_BEGIN()
+    BASIS_DECLARE_TEST(test_read_write)
+    BASIS_DECLARE_TEST(test_read_write_blocking)
+    BASIS_DECLARE_TEST(test_file_position)
+    BASIS_DECLARE_TEST(test_errors)
+BASIS_TEST_LIST_END()
+
+static std::string TempPath()
+{
+    char path[] = "/tmp/taco_io_XXXXXX";
+    int fd = mkstemp(path);
+    BASIS_TEST_VERIFY(fd >= 0);
+    close(fd);
+    return path;
+}
+
+// More concurrent requests than a ring holds, so some of them overflow to blocking threads
+static void read_write(const taco::scheduler_options & options)
+{
+    static const uint32_t num_blocks = 1000;
+    static const uint32_t block_size = 4096;
+
+    std::string path = TempPath();
+    taco::Initialize([&]() -> void {
+        int fd = taco::io::open(path.c_str(), O_RDWR | O_TRUNC);
+        BASIS_TEST_VERIFY_MSG(fd >= 0, "Failed to open %s (%d)", path.c_str(), errno);
+
+        std::vector<taco::future<ssize_t>> writes;
+        for (uint32_t i=0; i<num_blocks; i++)
+        {
+            writes.push_back(taco::Start([=]() -> ssize_t {
+                std::vector<uint32_t> block(block_size / sizeof(uint32_t), i);
+                return taco::io::write(fd, block.data(), block_size, off_t(i) * block_size);
+            }));
+        }
+        for (taco::future<ssize_t> & write : writes)
+        {
+            BASIS_TEST_VERIFY(write == ssize_t(block_size));
+        }
+        BASIS_TEST_VERIFY(taco::io::fsync(fd) == 0);
+
+        std::atomic<uint32_t> mismatches(0);
+        std::vector<taco::future<ssize_t>> reads;
+        for (uint32_t i=0; i<num_blocks; i++)
+        {
+            reads.push_back(taco::Start([=, &mismatches]() -> ssize_t {
+                std::vector<uint32_t> block(block_size / sizeof(uint32_t));
+                ssize_t result = taco::io::read(fd, block.data(), block_size, off_t(i) * block_size);
+                for (uint32_t value : block)
+                {
+                    if (value != i)
+                    {
+                        mismatches++;
+                        break;
+                    }
+                }
+                return result;
+            }));
+        }
+        for (taco::future<ssize_t> & read : reads)
+        {
+            BASIS_TEST_VERIFY(read == ssize_t(block_size));
+        }
+        BASIS_TEST_VERIFY_MSG(mismatches == 0, "%u blocks read back wrong", mismatches.load());
+
+        close(fd);
+    }, options);
+    taco::Shutdown();
+    unlink(path.c_str());
+}
+
+void test_read_write()
+{
+    read_write(taco::scheduler_options());
+}
+
+void test_read_write_blocking()
+{
+    taco::scheduler_options options;
+    options.async_io = false;
+    read_write(options);
+}
+
+void test_file_position()
+{
+    std::string path = TempPath();
+    taco::Initialize([&]() -> void {
+        int fd = taco::io::open(path.c_str(), O_RDWR | O_TRUNC);
+        BASIS_TEST_VERIFY(fd >= 0);
+
+        const char * parts[] = { "hello", " ", "world" };
+        for (const char * part : parts)
+        {
+            ssize_t size = ssize_t(strlen(part));
+            BASIS_TEST_VERIFY(taco::io::write(fd, part, size_t(size)) == size);
+        }
+
+        char buffer[32] = {};
+        BASIS_TEST_VERIFY(lseek(fd, 0, SEEK_SET) == 0);
+        BASIS_TEST_VERIFY(taco::io::read(fd, buffer, 5) == 5);
+        BASIS_TEST_VERIFY(taco::io::read(fd, buffer + 5, sizeof(buffer) - 6) == 6);
+        BASIS_TEST_VERIFY_MSG(std::string(buffer) == "hello world", "Read back \"%s\"", buffer);
+        BASIS_TEST_VERIFY(taco::io::read(fd, buffer, sizeof(buffer)) == 0);
+
+        close(fd);
+    });
+    taco::Shutdown();
+    unlink(path.c_str());
+}
+
+void test_errors()
+{
+    taco::Initialize([]() -> void {
+        errno = 0;
+        BASIS_TEST_VERIFY(taco::io::open("/nonexistent/taco/file", O_RDONLY) == -1);
+        BASIS_TEST_VERIFY_MSG(errno == ENOENT, "Expected ENOENT, got %d", errno);
+
+        char buffer[16];
+        errno = 0;
+        BASIS_TEST_VERIFY(taco::io::read(-1, buffer, sizeof(buffer), 0) == -1);
+        BASIS_TEST_VERIFY_MSG(errno == EBADF, "Expected EBADF, got %d", errno);
+    });
+    taco::Shutdown();
+}
+
+int main()
+{
+    BASIS_RUN_TESTS();
+    return 0;
+}
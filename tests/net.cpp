@@ -0,0 +1,257 @@
+#include <basis/unit_test.h>
+#include <taco/taco.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <vector>
+
+void test_socketpair();
+void test_loopback();
+void test_errors();
+
+BASIS_TEST_LIST_BEGIN()
+    BASIS_DECLARE_TEST(test_socketpair)
+    BASIS_DECLARE_TEST(test_loopback)
+    BASIS_DECLARE_TEST(test_errors)
+BASIS_TEST_LIST_END()
+
+static void SetNonBlocking(int fd)
+{
+    BASIS_TEST_VERIFY(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0);
+}
+
+static bool SendAll(int fd, const void * buffer, size_t size)
+{
+    const char * data = (const char *) buffer;
+    while (size > 0)
+    {
+        ssize_t sent = taco::net::send(fd, data, size);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        data += sent;
+        size -= size_t(sent);
+    }
+    return true;
+}
+
+static bool RecvAll(int fd, void * buffer, size_t size)
+{
+    char * data = (char *) buffer;
+    while (size > 0)
+    {
+        ssize_t received = taco::net::recv(fd, data, size);
+        if (received <= 0)
+        {
+            return false;
+        }
+        data += received;
+        size -= size_t(received);
+    }
+    return true;
+}
+
+// Two tasks bounce a counter back and forth, each waiting on the other most of the time
+void test_socketpair()
+{
+    static const uint32_t num_pairs = 16;
+    static const uint32_t num_rounds = 1000;
+
+    taco::Initialize([]() -> void {
+        std::vector<taco::future<bool>> results;
+        std::vector<int> fds;
+        for (uint32_t i=0; i<num_pairs; i++)
+        {
+            int pair[2];
+            BASIS_TEST_VERIFY(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+            SetNonBlocking(pair[0]);
+            SetNonBlocking(pair[1]);
+            fds.push_back(pair[0]);
+            fds.push_back(pair[1]);
+
+            for (int side=0; side<2; side++)
+            {
+                int fd = pair[side];
+                results.push_back(taco::Start([=]() -> bool {
+                    uint32_t value = 0;
+                    if (side == 0 && !SendAll(fd, &value, sizeof(value)))
+                    {
+                        return false;
+                    }
+                    for (uint32_t round=0; round<num_rounds; round++)
+                    {
+                        if (!RecvAll(fd, &value, sizeof(value)) || value != round * 2 + uint32_t(1 - side))
+                        {
+                            return false;
+                        }
+                        value++;
+                        if (!SendAll(fd, &value, sizeof(value)))
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                }));
+            }
+        }
+
+        for (taco::future<bool> & result : results)
+        {
+            BASIS_TEST_VERIFY(result);
+        }
+        for (int fd : fds)
+        {
+            close(fd);
+        }
+    });
+    taco::Shutdown();
+}
+
+// Many clients connect to and echo a block through a server task per connection
+void test_loopback()
+{
+    static const uint32_t num_clients = 64;
+    static const uint32_t block_size = 256 * 1024;
+
+    taco::Initialize([]() -> void {
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        BASIS_TEST_VERIFY(listener >= 0);
+        SetNonBlocking(listener);
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        BASIS_TEST_VERIFY(bind(listener, (sockaddr *) &address, length) == 0);
+        BASIS_TEST_VERIFY(getsockname(listener, (sockaddr *) &address, &length) == 0);
+        // Room for every client, an overflowing backlog resets connections
+        BASIS_TEST_VERIFY(listen(listener, int(num_clients)) == 0);
+
+        taco::future<uint32_t> server = taco::Start([=]() -> uint32_t {
+            std::vector<taco::future<bool>> connections;
+            for (uint32_t i=0; i<num_clients; i++)
+            {
+                int fd = taco::net::accept(listener);
+                if (fd < 0)
+                {
+                    break;
+                }
+                connections.push_back(taco::Start([=]() -> bool {
+                    std::vector<char> block(block_size);
+                    bool echoed = RecvAll(fd, block.data(), block_size) && SendAll(fd, block.data(), block_size);
+                    close(fd);
+                    return echoed;
+                }));
+            }
+
+            uint32_t echoed = 0;
+            for (taco::future<bool> & connection : connections)
+            {
+                echoed += connection ? 1 : 0;
+            }
+            return echoed;
+        });
+
+        std::vector<taco::future<bool>> clients;
+        for (uint32_t i=0; i<num_clients; i++)
+        {
+            clients.push_back(taco::Start([=]() -> bool {
+                int fd = socket(AF_INET, SOCK_STREAM, 0);
+                SetNonBlocking(fd);
+                if (taco::net::connect(fd, (const sockaddr *) &address, sizeof(address)) != 0)
+                {
+                    close(fd);
+                    return false;
+                }
+
+                // Larger than the socket buffers, so both sides have to wait on each other
+                std::vector<char> sent(block_size);
+                for (uint32_t j=0; j<block_size; j++)
+                {
+                    sent[j] = char(i * 31 + j);
+                }
+                std::vector<char> received(block_size);
+                taco::future<bool> sender = taco::Start([&]() -> bool {
+                    return SendAll(fd, sent.data(), block_size);
+                });
+                bool ok = RecvAll(fd, received.data(), block_size);
+                ok = sender && ok && sent == received;
+
+                // Nothing more once the server has closed its end
+                char byte;
+                ok = ok && taco::net::recv(fd, &byte, 1) == 0;
+                close(fd);
+                return ok;
+            }));
+        }
+
+        uint32_t succeeded = 0;
+        for (taco::future<bool> & client : clients)
+        {
+            succeeded += client ? 1 : 0;
+        }
+        BASIS_TEST_VERIFY_MSG(succeeded == num_clients, "%u of %u clients succeeded", succeeded, num_clients);
+
+        // Wakes the server if it is still waiting on clients that failed to connect
+        shutdown(listener, SHUT_RDWR);
+        BASIS_TEST_VERIFY_MSG(server == num_clients, "Server echoed %u of %u", uint32_t(server), num_clients);
+        close(listener);
+    });
+    taco::Shutdown();
+}
+
+void test_errors()
+{
+    taco::Initialize([]() -> void {
+        char buffer[16];
+        errno = 0;
+        BASIS_TEST_VERIFY(taco::net::recv(-1, buffer, sizeof(buffer)) == -1);
+        BASIS_TEST_VERIFY_MSG(errno == EBADF, "Expected EBADF, got %d", errno);
+
+        // Nobody listening on the port we just gave up
+        int probe = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        BASIS_TEST_VERIFY(bind(probe, (sockaddr *) &address, length) == 0);
+        BASIS_TEST_VERIFY(getsockname(probe, (sockaddr *) &address, &length) == 0);
+        close(probe);
+
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        SetNonBlocking(fd);
+        errno = 0;
+        BASIS_TEST_VERIFY(taco::net::connect(fd, (const sockaddr *) &address, sizeof(address)) == -1);
+        BASIS_TEST_VERIFY_MSG(errno == ECONNREFUSED, "Expected ECONNREFUSED, got %d", errno);
+        close(fd);
+
+        // The other end going away wakes a waiting reader with end of file, and a writer with EPIPE
+        int pair[2];
+        BASIS_TEST_VERIFY(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+        SetNonBlocking(pair[0]);
+        taco::future<ssize_t> reader = taco::Start([=]() -> ssize_t {
+            char byte;
+            return taco::net::recv(pair[0], &byte, 1);
+        });
+        taco::SleepFor(std::chrono::milliseconds(10));
+        close(pair[1]);
+        BASIS_TEST_VERIFY(reader == 0);
+
+        errno = 0;
+        BASIS_TEST_VERIFY(taco::net::send(pair[0], buffer, sizeof(buffer)) == -1);
+        BASIS_TEST_VERIFY_MSG(errno == EPIPE, "Expected EPIPE, got %d", errno);
+        close(pair[0]);
+    });
+    taco::Shutdown();
+}
+
+int main()
+{
+    BASIS_RUN_TESTS();
+    return 0;
+}
@@ -0,0 +1,265 @@
+#include <basis/unit_test.h>
+#include <taco/taco.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+void test_parallel_for();
+void test_parallel_reduce();
+void test_parallel_invoke();
+void test_benchmarks();
+
+BASIS_TEST_LIST_BEGIN()
+    BASIS_DECLARE_TEST(test_parallel_for)
+    BASIS_DECLARE_TEST(test_parallel_reduce)
+    BASIS_DECLARE_TEST(test_parallel_invoke)
+    BASIS_DECLARE_TEST(test_benchmarks)
+BASIS_TEST_LIST_END()
+
+void test_parallel_for()
+{
+    taco::Initialize([]() -> void {
+        std::vector<uint32_t> values(1000000, 0);
+        taco::parallel_for(size_t(0), values.size(), [&](size_t i) -> void {
+            values[i] += uint32_t(i * 2);
+        });
+        bool matched = true;
+        for (size_t i=0; i<values.size(); i++)
+        {
+            matched = matched && values[i] == i * 2;
+        }
+        BASIS_TEST_VERIFY(matched);
+
+        // Sub-ranges cover every index once, none larger than the grain
+        std::vector<std::atomic<uint32_t>> visits(100000);
+        std::atomic<size_t> largest(0);
+        taco::parallel_for(0, int(visits.size()), [&](int begin, int end) -> void {
+            size_t size = size_t(end - begin);
+            size_t seen = largest.load();
+            while (size > seen && !largest.compare_exchange_weak(seen, size))
+            {
+            }
+            for (int i=begin; i<end; i++)
+            {
+                visits[i]++;
+            }
+        }, 4096);
+        BASIS_TEST_VERIFY(std::all_of(visits.begin(), visits.end(), [](const std::atomic<uint32_t> & v) -> bool { return v == 1; }));
+
+        // Only as finely as it takes to keep everyone busy, not down to the grain
+        std::atomic<size_t> pieces(0);
+        taco::parallel_for(0, 1 << 20, [&](int, int) -> void { pieces++; });
+        BASIS_TEST_VERIFY_MSG(pieces < (1 << 10), "Split in to %zu pieces", pieces.load());
+
+        int count = 0;
+        taco::parallel_for(10, 10, [&](int) -> void { count++; });
+        taco::parallel_for(10, 5, [&](int) -> void { count++; });
+        BASIS_TEST_VERIFY(count == 0);
+    });
+    taco::Shutdown();
+}
+
+void test_parallel_reduce()
+{
+    taco::Initialize([]() -> void {
+        static const uint64_t count = 10000000;
+        uint64_t sum = taco::parallel_reduce(uint64_t(0), count, uint64_t(0), [](uint64_t begin, uint64_t end, uint64_t init) -> uint64_t {
+            for (uint64_t i=begin; i<end; i++)
+            {
+                init += i;
+            }
+            return init;
+        }, [](uint64_t a, uint64_t b) -> uint64_t { return a + b; }, 1024);
+        BASIS_TEST_VERIFY(sum == count * (count - 1) / 2);
+
+        // Pieces are combined in order
+        std::string digits = taco::parallel_reduce(0, 1000, std::string(), [](int begin, int end, std::string init) -> std::string {
+            for (int i=begin; i<end; i++)
+            {
+                init += char('0' + i % 10);
+            }
+            return init;
+        }, [](std::string a, const std::string & b) -> std::string { return a + b; });
+        bool ordered = digits.size() == 1000;
+        for (size_t i=0; i<digits.size(); i++)
+        {
+            ordered = ordered && digits[i] == char('0' + i % 10);
+        }
+        BASIS_TEST_VERIFY(ordered);
+
+        int none = taco::parallel_reduce(5, 5, 7, [](int, int, int) -> int { return 0; }, [](int a, int b) -> int { return a + b; });
+        BASIS_TEST_VERIFY(none == 7);
+    });
+    taco::Shutdown();
+}
+
+static void quicksort(int * first, int * last, bool parallel = true)
+{
+    if (last - first < 2048)
+    {
+        std::sort(first, last);
+        return;
+    }
+
+    int pivot = first[(last - first) / 2];
+    int * mid1 = std::partition(first, last, [=](int v) -> bool { return v < pivot; });
+    int * mid2 = std::partition(mid1, last, [=](int v) -> bool { return v == pivot; });
+    if (!parallel)
+    {
+        quicksort(first, mid1, false);
+        quicksort(mid2, last, false);
+        return;
+    }
+    taco::parallel_invoke(
+        [=]() -> void { quicksort(first, mid1); },
+        [=]() -> void { quicksort(mid2, last); });
+}
+
+void test_parallel_invoke()
+{
+    taco::Initialize([]() -> void {
+        std::atomic<int> ran(0);
+        taco::parallel_invoke(
+            [&]() -> void { ran += 1; },
+            [&]() -> void { ran += 2; },
+            [&]() -> void { ran += 4; });
+        BASIS_TEST_VERIFY(ran == 7);
+
+        taco::parallel_invoke([&]() -> void { ran += 8; });
+        BASIS_TEST_VERIFY(ran == 15);
+
+        std::vector<int> values(1000000);
+        uint32_t seed = 1;
+        for (int & v : values)
+        {
+            seed = seed * 1664525 + 1013904223;
+            v = int(seed >> 8);
+        }
+        quicksort(values.data(), values.data() + values.size());
+        BASIS_TEST_VERIFY(std::is_sorted(values.begin(), values.end()));
+    });
+    taco::Shutdown();
+}
+
+// Runs fn serially and in parallel repeat times, printing the time for each
+template<class SERIAL, class PARALLEL>
+static void compare(const char * label, int repeat, SERIAL && serial, PARALLEL && parallel)
+{
+    typedef std::chrono::steady_clock clock;
+
+    auto ts = clock::now();
+    for (int i=0; i<repeat; i++)
+    {
+        serial();
+    }
+    auto serial_us = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - ts).count();
+
+    ts = clock::now();
+    for (int i=0; i<repeat; i++)
+    {
+        parallel();
+    }
+    auto parallel_us = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - ts).count();
+
+    printf("  %-40s serial %8llu us, parallel %8llu us (%.2fx)\n", label, (unsigned long long) serial_us,
+        (unsigned long long) parallel_us, parallel_us ? double(serial_us) / double(parallel_us) : 0.0);
+}
+
+static double work(int i, int amount)
+{
+    double v = 0.0;
+    for (int j=0; j<amount; j++)
+    {
+        v += sqrt(double(i + j));
+    }
+    return v;
+}
+
+void test_benchmarks()
+{
+    taco::Initialize([]() -> void {
+        printf("  %u schedulers\n", taco::GetThreadCount());
+
+        std::vector<double> out(1 << 20);
+        compare("parallel_for, 1M light iterations", 10, [&]() -> void {
+            for (size_t i=0; i<out.size(); i++)
+            {
+                out[i] = sqrt(double(i));
+            }
+        }, [&]() -> void {
+            taco::parallel_for(size_t(0), out.size(), [&](size_t begin, size_t end) -> void {
+                for (size_t i=begin; i<end; i++)
+                {
+                    out[i] = sqrt(double(i));
+                }
+            });
+        });
+
+        compare("parallel_for, 64 iterations x 10000", 10000, [&]() -> void {
+            for (int i=0; i<64; i++)
+            {
+                out[i] = sqrt(double(i));
+            }
+        }, [&]() -> void {
+            taco::parallel_for(0, 64, [&](int i) -> void {
+                out[i] = sqrt(double(i));
+            });
+        });
+
+        // Iteration i does i units of work, so the top of the range is most of it
+        compare("parallel_for, 4096 unbalanced iterations", 1, [&]() -> void {
+            for (int i=0; i<4096; i++)
+            {
+                out[i] = work(i, i);
+            }
+        }, [&]() -> void {
+            taco::parallel_for(0, 4096, [&](int i) -> void {
+                out[i] = work(i, i);
+            });
+        });
+
+        double serial_sum = 0.0;
+        double parallel_sum = 0.0;
+        compare("parallel_reduce, 16M light iterations", 1, [&]() -> void {
+            serial_sum = 0.0;
+            for (int i=0; i<(1 << 24); i++)
+            {
+                serial_sum += sqrt(double(i));
+            }
+        }, [&]() -> void {
+            parallel_sum = taco::parallel_reduce(0, 1 << 24, 0.0, [](int begin, int end, double init) -> double {
+                for (int i=begin; i<end; i++)
+                {
+                    init += sqrt(double(i));
+                }
+                return init;
+            }, [](double a, double b) -> double { return a + b; });
+        });
+        BASIS_TEST_VERIFY(fabs(serial_sum - parallel_sum) <= serial_sum * 1e-9);
+
+        std::vector<int> source(1 << 21);
+        std::iota(source.begin(), source.end(), 0);
+        std::reverse(source.begin() + source.size() / 3, source.end());
+        std::vector<int> values;
+        compare("parallel_invoke, quicksort 2M", 1, [&]() -> void {
+            values = source;
+            quicksort(values.data(), values.data() + values.size(), false);
+        }, [&]() -> void {
+            values = source;
+            quicksort(values.data(), values.data() + values.size());
+        });
+        BASIS_TEST_VERIFY(std::is_sorted(values.begin(), values.end()));
+    });
+    taco::Shutdown();
+}
+
+int main()
+{
+    BASIS_RUN_TESTS();
+    return 0;
+}
@@ -2,7 +2,14 @@
 #include <basis/unit_test.h>
 #include <taco/taco.h>
 #include <iostream>
+#include <atomic>
+#include <chrono>
 #include <mutex>
+#include <string>
+#include <string.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
 
 #define TEST_TIMEOUT_MS 2000
 
@@ -10,12 +17,28 @@ void test_initialize_shutdown();
 void test_basic();
 void test_schedule();
 void test_switch();
+void test_stack_size();
+void test_schedule_batch();
+void test_task_name();
+void test_steal_stats();
+void test_wake_latency();
+void test_cpu_mapping();
+void test_priority();
+void test_deadline();
 
 BASIS_TEST_LIST_BEGIN()
     BASIS_DECLARE_TEST(test_initialize_shutdown)
     BASIS_DECLARE_TEST(test_basic)
     BASIS_DECLARE_TEST(test_schedule)
     BASIS_DECLARE_TEST(test_switch)
+    BASIS_DECLARE_TEST(test_stack_size)
+    BASIS_DECLARE_TEST(test_schedule_batch)
+    BASIS_DECLARE_TEST(test_task_name)
+    BASIS_DECLARE_TEST(test_steal_stats)
+    BASIS_DECLARE_TEST(test_wake_latency)
+    BASIS_DECLARE_TEST(test_cpu_mapping)
+    BASIS_DECLARE_TEST(test_priority)
+    BASIS_DECLARE_TEST(test_deadline)
 BASIS_TEST_LIST_END()
 
 void test_initialize_shutdown()
@@ -123,8 +146,468 @@ void test_switch()
     BASIS_TEST_VERIFY_MSG(!timeout, "timeout after at leat %d ms.  Not all tasks were entered.", TEST_TIMEOUT_MS);
 }
 
+void test_stack_size()
+{
+    taco::Initialize([]() -> void {
+        constexpr uint32_t num_tasks = 8;
+        constexpr size_t buffer_size = 192 * 1024;
+
+        std::atomic<uint32_t> remaining(num_tasks);
+        std::atomic<uint32_t> total(0);
+
+        for (uint32_t i=0; i<num_tasks; i++)
+        {
+            // Would run off the end of a standard stack
+            taco::Schedule([&]() -> void {
+                volatile uint8_t buffer[buffer_size];
+                for (size_t j=0; j<buffer_size; j++)
+                {
+                    buffer[j] = 1;
+                }
+
+                uint32_t sum = 0;
+                for (size_t j=0; j<buffer_size; j++)
+                {
+                    sum += buffer[j];
+                }
+                total += sum;
+                remaining--;
+            }, taco::stack_size::huge);
+        }
+
+        while (remaining > 0)
+        {
+            taco::Switch();
+        }
+
+        BASIS_TEST_VERIFY_MSG(total == num_tasks * buffer_size, "Expected total of %u; got %u", 
+            uint32_t(num_tasks * buffer_size), uint32_t(total));
+    });
+    taco::Shutdown();
+}
+
+void test_schedule_batch()
+{
+    taco::Initialize([]() -> void {
+        constexpr uint32_t num_tasks = 10000;
+
+        std::vector<std::atomic<uint32_t>> runs(num_tasks);
+        std::atomic<uint32_t> remaining(num_tasks);
+
+        taco::ScheduleBatch("batch", num_tasks, [&](size_t i) -> taco::task_fn {
+            return [&, i]() -> void {
+                runs[i]++;
+                remaining--;
+            };
+        });
+
+        std::vector<taco::task_fn> fns;
+        for (uint32_t i=0; i<num_tasks; i++)
+        {
+            fns.push_back([&, i]() -> void {
+                runs[i]++;
+                remaining--;
+            });
+        }
+        remaining += num_tasks;
+        taco::ScheduleBatch(fns.begin(), fns.end());
+
+        while (remaining > 0)
+        {
+            taco::Switch();
+        }
+
+        uint32_t bad = 0;
+        for (uint32_t i=0; i<num_tasks; i++)
+        {
+            bad += (runs[i] != 2) ? 1 : 0;
+        }
+        BASIS_TEST_VERIFY_MSG(bad == 0, "%u of %u tasks did not run exactly once per batch", bad, num_tasks);
+    });
+    taco::Shutdown();
+}
+
+void test_task_name()
+{
+    taco::task_name a = taco::task_name::Intern("interned");
+    std::string dynamic = "interned";
+    taco::task_name b = dynamic.c_str();
+    BASIS_TEST_VERIFY_MSG(a.id() != 0 && a.id() == b.id(), "Expected equal strings to share an id (%u, %u)", a.id(), b.id());
+    BASIS_TEST_VERIFY(a.c_str() == b.c_str());
+    BASIS_TEST_VERIFY(strcmp(taco::task_name::Lookup(a.id()), "interned") == 0);
+    BASIS_TEST_VERIFY(taco::task_name().empty() && taco::task_name::literal("literal").id() == 0);
+
+    // Arrays might not be literals, they are interned like any other string
+    using namespace taco::literals;
+    char buffer[32] = "interned";
+    BASIS_TEST_VERIFY(taco::task_name(buffer).id() == a.id() && taco::task_name("interned").id() == a.id());
+    BASIS_TEST_VERIFY("literal"_task.id() == 0 && strcmp("literal"_task.c_str(), "literal") == 0);
+
+    // The same buffer holding a different name is still told apart
+    strcpy(buffer, "reused");
+    BASIS_TEST_VERIFY(taco::task_name(buffer).id() == taco::task_name::Intern("reused").id() && taco::task_name(buffer).id() != a.id());
+    for (int i=0; i<2; i++)
+    {
+        taco::task_name cached = TACO_TASK_NAME("interned");
+        BASIS_TEST_VERIFY(cached.id() == a.id() && cached.c_str() == a.c_str());
+    }
+
+    taco::Initialize([&]() -> void {
+        std::atomic<uint32_t> remaining(4);
+        std::string names[4];
+
+        {
+            std::string temp = "dynamic-name";
+            taco::Schedule(temp.c_str(), [&]() -> void {
+                names[0] = taco::GetTaskName();
+                remaining--;
+            });
+        }
+        taco::Schedule("literal-name"_task, [&]() -> void {
+            names[1] = taco::GetTaskName();
+            remaining--;
+        });
+        taco::Schedule([&]() -> void {
+            names[2] = taco::GetTaskName();
+            remaining--;
+        });
+        {
+            // Overwritten (and gone) before the task runs
+            char buffer[64];
+            snprintf(buffer, sizeof(buffer), "buffer-name-%d", 7);
+            taco::Schedule(buffer, [&]() -> void {
+                names[3] = taco::GetTaskName();
+                remaining--;
+            }, 0);
+            memset(buffer, 'x', sizeof(buffer) - 1);
+        }
+
+        while (remaining > 0)
+        {
+            taco::Switch();
+        }
+
+        BASIS_TEST_VERIFY_MSG(names[0] == "dynamic-name", "Unexpected task name %s", names[0].c_str());
+        BASIS_TEST_VERIFY_MSG(names[1] == "literal-name", "Unexpected task name %s", names[1].c_str());
+        BASIS_TEST_VERIFY_MSG(names[2] == "", "Unexpected task name %s", names[2].c_str());
+        BASIS_TEST_VERIFY_MSG(names[3] == "buffer-name-7", "Unexpected task name %s", names[3].c_str());
+    });
+    taco::Shutdown();
+}
+
+// Busy work the compiler can't optimize away
+static void spin(uint32_t iterations)
+{
+    for (uint32_t i=0; i<iterations; i++)
+    {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+}
+
+void test_steal_stats()
+{
+    static const uint32_t num_tasks = 20000;
+
+    taco::Initialize([&]() -> void {
+        std::atomic<uint32_t> remaining(num_tasks);
+        for (uint32_t i=0; i<num_tasks; i++)
+        {
+            taco::Schedule([&]() -> void {
+                spin(2000);
+                remaining--;
+            });
+        }
+
+        while (remaining > 0)
+        {
+            taco::Switch();
+        }
+
+        taco::scheduler_stats stats = taco::GetSchedulerStats();
+        printf("steal attempts: %llu, successes: %llu (%.1f%%), tasks stolen: %llu, fibers stolen: %llu\n",
+            (unsigned long long) stats.steal_attempts, (unsigned long long) stats.steal_successes,
+            stats.steal_attempts ? (100.0 * stats.steal_successes / stats.steal_attempts) : 0.0,
+            (unsigned long long) stats.tasks_stolen, (unsigned long long) stats.fibers_stolen);
+
+        BASIS_TEST_VERIFY(stats.steal_successes <= stats.steal_attempts);
+        BASIS_TEST_VERIFY(stats.tasks_stolen + stats.fibers_stolen >= stats.steal_successes);
+        BASIS_TEST_VERIFY_MSG(taco::GetThreadCount() < 2 || stats.tasks_stolen > 0, 
+            "Expected other schedulers to steal from the one scheduling every task");
+    });
+    taco::Shutdown();
+}
+
+// Measures the time from scheduling a task on another scheduler until it starts running, with the
+// tasks arriving in bursts far enough apart that an idle scheduler has already given up looking
+static void run_wake_latency(const char * label, taco::idle_policy idle)
+{
+    static const uint32_t num_bursts = 200;
+
+    taco::scheduler_options options;
+    options.thread_count = 2;
+    options.idle = idle;
+
+    taco::Initialize([&]() -> void {
+        uint64_t total = 0;
+        uint64_t worst = 0;
+
+        for (uint32_t i=0; i<num_bursts; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+
+            std::atomic<uint64_t> started(0);
+            auto scheduled = basis::GetTimestamp();
+            taco::Schedule([&]() -> void {
+                started = basis::GetTimestamp();
+            }, 1);
+
+            // Don't switch, leave the other scheduler to it
+            while (started == 0)
+            {
+                std::this_thread::yield();
+            }
+
+            uint64_t latency = started - scheduled;
+            total += latency;
+            worst = latency > worst ? latency : worst;
+        }
+
+        printf("%s\tavg %.2f us\tworst %.2f us\n", label, total / (1000.0 * num_bursts), worst / 1000.0);
+    }, options);
+    taco::Shutdown();
+}
+
+void test_wake_latency()
+{
+    run_wake_latency("park", { 0, 0 });
+    run_wake_latency("spin", { 20000, 0 });
+    run_wake_latency("spin+yield", { 2000, 200 });
+}
+
 int main()
 {
     BASIS_RUN_TESTS();
     return 0;
 }
+
+void test_cpu_mapping()
+{
+    uint32_t ncpus = std::thread::hardware_concurrency();
+
+    taco::Initialize(2);
+    taco::cpu_mapping mapping = taco::GetCpuMapping();
+    taco::Shutdown();
+
+    BASIS_TEST_VERIFY(mapping.schedulers.size() == 2 && mapping.blocking.empty());
+    for (int cpu : mapping.schedulers)
+    {
+        BASIS_TEST_VERIFY_MSG(cpu == -1, "Expected schedulers to be unpinned by default; one is on cpu %d", cpu);
+    }
+
+    // Everything on cpu 0 - pinning may still be refused (or unsupported) but never moved elsewhere
+    taco::scheduler_options options;
+    options.thread_count = 3;
+    options.affinity.mode = taco::affinity_mode::list;
+    options.affinity.cpus = { 0 };
+    options.affinity.blocking_cpus = { 0 };
+    taco::Initialize("pinned", []() -> void {
+        taco::Schedule([]() -> void {}, 1);
+    }, options);
+    mapping = taco::GetCpuMapping();
+    taco::Shutdown();
+
+    BASIS_TEST_VERIFY(mapping.schedulers.size() == 3 && mapping.blocking == std::vector<uint32_t>{ 0 });
+    for (int cpu : mapping.schedulers)
+    {
+        BASIS_TEST_VERIFY_MSG(cpu == 0 || cpu == -1, "Expected scheduler on cpu 0; got %d", cpu);
+    }
+
+    if (ncpus > 1)
+    {
+        options.thread_count = int(ncpus - 1);
+        options.affinity.mode = taco::affinity_mode::scatter;
+        options.affinity.exclude = { 0 };
+        options.affinity.blocking_cpus.clear();
+        taco::Initialize(options);
+        mapping = taco::GetCpuMapping();
+        taco::Shutdown();
+
+        for (size_t i=0; i<mapping.schedulers.size(); i++)
+        {
+            int cpu = mapping.schedulers[i];
+            BASIS_TEST_VERIFY_MSG(cpu != 0, "Scheduler %zu placed on excluded cpu 0", i);
+            for (size_t j=0; j<i; j++)
+            {
+                BASIS_TEST_VERIFY_MSG(cpu == -1 || mapping.schedulers[j] != cpu, "Schedulers %zu and %zu share cpu %d", j, i, cpu);
+            }
+        }
+    }
+
+    // Nothing left to pin to, schedulers still run but unpinned
+    options.thread_count = 2;
+    options.affinity.mode = taco::affinity_mode::list;
+    options.affinity.cpus = { 0 };
+    options.affinity.exclude = { 0 };
+    options.affinity.blocking_cpus.clear();
+    bool ran = false;
+    taco::Initialize("excluded", [&]() -> void {
+        ran = taco::Start([]() -> bool { return true; }).await();
+    }, options);
+    mapping = taco::GetCpuMapping();
+    taco::Shutdown();
+
+    BASIS_TEST_VERIFY(ran);
+    for (int cpu : mapping.schedulers)
+    {
+        BASIS_TEST_VERIFY_MSG(cpu == -1, "Expected schedulers to be unpinned with every cpu excluded; one is on cpu %d", cpu);
+    }
+}
+
+void test_priority()
+{
+    static const uint32_t per_level = 100;
+    static const uint32_t backlog = 10000;
+    static const taco::task_priority levels[] = { taco::task_priority::low, taco::task_priority::normal, taco::task_priority::high };
+
+    // A single scheduler, so the order tasks run in is down to their priority alone
+    taco::Initialize("priority", [&]() -> void {
+        std::vector<taco::task_priority> order;
+        uint32_t done = 0;
+        bool kept = true;
+
+        // Lowest first, so the private queue's plain FIFO order would start them first
+        for (taco::task_priority priority : levels)
+        {
+            for (uint32_t i=0; i<per_level; i++)
+            {
+                taco::Schedule([&order, &kept, &done, priority]() -> void {
+                    order.push_back(priority);
+                    kept = kept && taco::GetTaskPriority() == priority;
+                    taco::Switch();
+                    kept = kept && taco::GetTaskPriority() == priority;
+                    done++;
+                }, priority, taco::stack_size::standard, 0);
+            }
+        }
+
+        while (done < 3 * per_level)
+        {
+            taco::Switch();
+        }
+
+        double position[3] = {};
+        size_t first_low = order.size();
+        size_t last_high = 0;
+        for (size_t i=0; i<order.size(); i++)
+        {
+            position[size_t(order[i])] += double(i) / per_level;
+            first_low = (order[i] == taco::task_priority::low && i < first_low) ? i : first_low;
+            last_high = (order[i] == taco::task_priority::high) ? i : last_high;
+        }
+
+        BASIS_TEST_VERIFY_MSG(kept, "Expected tasks to keep their priority across a switch");
+        BASIS_TEST_VERIFY_MSG(order[0] == taco::task_priority::high, "Expected a high priority task to start first");
+        BASIS_TEST_VERIFY_MSG(position[0] < position[1] && position[1] < position[2], 
+            "Expected higher priorities to start earlier on average (%.1f, %.1f, %.1f)", position[0], position[1], position[2]);
+        BASIS_TEST_VERIFY_MSG(first_low < last_high, "Expected aging to let low priority tasks run before the high ones are done");
+
+        // How long a task waits behind a backlog of normal priority work in the same queue
+        for (taco::task_priority priority : { taco::task_priority::normal, taco::task_priority::high })
+        {
+            std::atomic<uint32_t> remaining(backlog);
+            for (uint32_t i=0; i<backlog; i++)
+            {
+                taco::Schedule([&]() -> void {
+                    spin(200);
+                    remaining--;
+                }, 0);
+            }
+
+            uint64_t latency = 0;
+            auto scheduled = basis::GetTimestamp();
+            taco::Schedule([&]() -> void {
+                latency = basis::GetTimestamp() - scheduled;
+            }, priority, taco::stack_size::standard, 0);
+
+            while (remaining > 0 || latency == 0)
+            {
+                taco::Switch();
+            }
+            printf("%s task behind %u tasks: %.2f us\n", priority == taco::task_priority::high ? "high" : "normal", backlog, latency / 1000.0);
+        }
+    }, 1);
+    taco::Shutdown();
+}
+
+void test_deadline()
+{
+    static const uint32_t num_tasks = 50;
+    static const uint32_t num_shared = 2000;
+
+    taco::scheduler_options options;
+    options.thread_count = 1;
+    options.mode = taco::scheduling_mode::deadline;
+
+    // One scheduler, so deadline order is the only order
+    taco::Initialize("deadline", [&]() -> void {
+        std::vector<uint32_t> order;
+        uint32_t done = 0;
+        auto now = std::chrono::steady_clock::now();
+
+        taco::Schedule([&]() -> void {
+            order.push_back(num_tasks);
+            done++;
+        }, 0);
+
+        // Latest deadline first, all of them already missed
+        for (uint32_t i=num_tasks; i-- > 0; )
+        {
+            taco::Schedule([&order, &done, i]() -> void {
+                order.push_back(i);
+                taco::Switch();
+                done++;
+            }, now - std::chrono::milliseconds(1) + std::chrono::microseconds(i), 0);
+        }
+
+        while (done < num_tasks + 1)
+        {
+            taco::Switch();
+        }
+
+        bool sorted = order.size() == num_tasks + 1;
+        for (uint32_t i=0; sorted && i<=num_tasks; i++)
+        {
+            sorted = order[i] == i;
+        }
+        BASIS_TEST_VERIFY_MSG(sorted, "Expected tasks with deadlines to start earliest deadline first and ahead of the one without");
+
+        taco::scheduler_stats stats = taco::GetSchedulerStats();
+        BASIS_TEST_VERIFY_MSG(stats.deadline_tasks == num_tasks && stats.deadline_misses == num_tasks, 
+            "Expected %u missed deadlines; got %llu of %llu", num_tasks,
+            (unsigned long long) stats.deadline_misses, (unsigned long long) stats.deadline_tasks);
+    }, options);
+    taco::Shutdown();
+
+    // Spread across every scheduler, plenty of time to meet them
+    options.thread_count = -1;
+    taco::Initialize("deadline", [&]() -> void {
+        std::atomic<uint32_t> remaining(num_shared);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        for (uint32_t i=0; i<num_shared; i++)
+        {
+            taco::Schedule([&]() -> void {
+                taco::Switch();
+                remaining--;
+            }, deadline);
+        }
+
+        while (remaining > 0)
+        {
+            taco::Switch();
+        }
+
+        taco::scheduler_stats stats = taco::GetSchedulerStats();
+        BASIS_TEST_VERIFY(stats.deadline_tasks == num_shared && stats.deadline_misses == 0);
+    }, options);
+    taco::Shutdown();
+}
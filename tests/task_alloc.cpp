@@ -0,0 +1,164 @@
+#include <basis/unit_test.h>
+#include <basis/timer.h>
+#include <taco/taco.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <stdio.h>
+#include <vector>
+
+static std::atomic<uint64_t> AllocationCount(0);
+
+void * operator new(size_t size)
+{
+    AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    void * ptr = malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void * ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void test_task_alloc();
+void test_future_alloc();
+
+BASIS_TEST_LIST_BEGIN()
+    BASIS_DECLARE_TEST(test_task_alloc)
+    BASIS_DECLARE_TEST(test_future_alloc)
+BASIS_TEST_LIST_END()
+
+struct capture_data
+{
+    uint64_t    values[5];
+};
+
+// Schedules num_tasks tasks via submit, lets them all run and returns the
+// number of allocations made per task along the way
+template<class SUBMIT>
+static double MeasureAllocations(uint32_t num_tasks, SUBMIT && submit)
+{
+    std::atomic<uint32_t> remaining(num_tasks);
+    uint64_t start = AllocationCount.load();
+    auto ts = basis::GetTimestamp();
+
+    for (uint32_t i=0; i<num_tasks; i++)
+    {
+        submit(remaining, i);
+    }
+    while (remaining > 0)
+    {
+        taco::Switch();
+    }
+
+    uint64_t ms = basis::GetTimeDeltaMS(ts, basis::GetTimestamp());
+    double per_task = double(AllocationCount.load() - start) / num_tasks;
+    printf("  %.3f allocations/task, %llu ms for %u tasks\n", per_task, (unsigned long long) ms, num_tasks);
+    return per_task;
+}
+
+void test_task_alloc()
+{
+    static const uint32_t num_tasks = 100000;
+
+    // A single worker keeps the count free of allocations made by other threads
+    taco::Initialize([]() -> void {
+        capture_data data = { { 1, 2, 3, 4, 5 } };
+        std::atomic<uint64_t> sum(0);
+
+        auto submit_function = [&](std::atomic<uint32_t> & remaining, uint32_t i) -> void {
+            taco::task_fn fn = [&remaining, &sum, data, i]() -> void {
+                sum += data.values[i % 5];
+                remaining--;
+            };
+            taco::Schedule(fn);
+        };
+        auto submit_closure = [&](std::atomic<uint32_t> & remaining, uint32_t i) -> void {
+            taco::Schedule(TACO_TASK_NAME("closure"), [&remaining, &sum, data, i]() -> void {
+                sum += data.values[i % 5];
+                remaining--;
+            });
+        };
+
+        // Warm up the task pools and the inactive fiber lists
+        MeasureAllocations(num_tasks, submit_closure);
+        MeasureAllocations(num_tasks, submit_function);
+
+        printf("std::function:\n");
+        MeasureAllocations(num_tasks, submit_function);
+        printf("closure:\n");
+        double per_task = MeasureAllocations(num_tasks, submit_closure);
+
+        BASIS_TEST_VERIFY_MSG(per_task < 0.01, "Expected no allocations per task; got %.3f", per_task);
+    }, 1);
+    taco::Shutdown();
+}
+
+void test_future_alloc()
+{
+    static const uint32_t num_futures = 100000;
+    static const uint32_t num_checks = 10000000;
+
+    taco::Initialize([]() -> void {
+        std::vector<taco::future<uint64_t>> futures;
+        futures.reserve(num_futures);
+
+        // Started and awaited in batches, most awaits find the value already there
+        auto run = [&]() -> double {
+            uint64_t start = AllocationCount.load();
+            auto ts = basis::GetTimestamp();
+            uint64_t sum = 0;
+            for (uint32_t batch=0; batch<num_futures; batch+=100)
+            {
+                for (uint32_t i=batch; i<batch+100; i++)
+                {
+                    futures.push_back(taco::Start([i]() -> uint64_t { return i; }));
+                }
+                for (taco::future<uint64_t> & f : futures)
+                {
+                    sum += f.await();
+                }
+                futures.clear();
+            }
+            uint64_t ms = basis::GetTimeDeltaMS(ts, basis::GetTimestamp());
+            double per_future = double(AllocationCount.load() - start) / num_futures;
+            printf("  %.3f allocations/future, %llu ms for %u futures\n", per_future, (unsigned long long) ms, num_futures);
+            BASIS_TEST_VERIFY(sum == uint64_t(num_futures) * (num_futures - 1) / 2);
+            return per_future;
+        };
+
+        // Warm up the pools
+        run();
+        printf("Start/await:\n");
+        double per_future = run();
+        BASIS_TEST_VERIFY_MSG(per_future < 0.01, "Expected no allocations per future; got %.3f", per_future);
+
+        taco::future<uint64_t> done = taco::Start([]() -> uint64_t { return 1; });
+        done.await();
+        uint64_t start = AllocationCount.load();
+        auto ts = basis::GetTimestamp();
+        uint64_t sum = 0;
+        for (uint32_t i=0; i<num_checks; i++)
+        {
+            sum += done.ready() ? done.await() : 0;
+        }
+        uint64_t ms = basis::GetTimeDeltaMS(ts, basis::GetTimestamp());
+        printf("Completed ready/await:\n  %llu ms for %u\n", (unsigned long long) ms, num_checks);
+        BASIS_TEST_VERIFY(sum == num_checks);
+        BASIS_TEST_VERIFY(AllocationCount.load() == start);
+    }, 1);
+    taco::Shutdown();
+}
+
+int main()
+{
+    BASIS_RUN_TESTS();
+    return 0;
+}
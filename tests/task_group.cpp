@@ -0,0 +1,118 @@
+#include <basis/unit_test.h>
+#include <taco/taco.h>
+#include <atomic>
+#include <vector>
+
+void test_fork_join();
+void test_fork_join_single();
+void test_many_children();
+void test_nested_run();
+
+BASIS_TEST_LIST_BEGIN()
+    BASIS_DECLARE_TEST(test_fork_join)
+    BASIS_DECLARE_TEST(test_fork_join_single)
+    BASIS_DECLARE_TEST(test_many_children)
+    BASIS_DECLARE_TEST(test_nested_run)
+BASIS_TEST_LIST_END()
+
+static unsigned fibonacci(unsigned n)
+{
+    if (n < 2) return 1;
+
+    unsigned a = 0;
+    unsigned b = 0;
+    taco::task_group group;
+    group.run(TACO_TASK_NAME("fibonacci"), [&]() -> void { a = fibonacci(n - 1); });
+    group.run(TACO_TASK_NAME("fibonacci"), [&]() -> void { b = fibonacci(n - 2); });
+    group.wait();
+    return a + b;
+}
+
+static void fork_join(int threads)
+{
+    taco::scheduler_options options;
+    options.thread_count = threads;
+    taco::Initialize([]() -> void {
+        // Deeper than children are ever nested inline, so some of the waits suspend
+        unsigned result = taco::Start([]() -> unsigned { return fibonacci(24); });
+        BASIS_TEST_VERIFY_MSG(result == 75025, "fibonacci(24) returned %u", result);
+    }, options);
+    taco::Shutdown();
+}
+
+void test_fork_join()
+{
+    fork_join(-1);
+}
+
+// Waits on a single scheduler have nobody to steal their children, everything is run inline
+void test_fork_join_single()
+{
+    fork_join(1);
+}
+
+void test_many_children()
+{
+    static const uint32_t num_children = 10000;
+
+    taco::Initialize([]() -> void {
+        std::atomic<uint32_t> count(0);
+        taco::task_group group;
+        for (int round=1; round<=3; round++)
+        {
+            for (uint32_t i=0; i<num_children; i++)
+            {
+                group.run([&]() -> void {
+                    count++;
+                });
+            }
+            group.wait();
+            BASIS_TEST_VERIFY_MSG(count == round * num_children, "Round %d ended with %u children done", round, count.load());
+        }
+
+        // Nothing to wait for
+        group.wait();
+
+        // The destructor waits for whatever was left running
+        std::atomic<uint32_t> slow(0);
+        {
+            taco::task_group scoped;
+            for (int i=0; i<8; i++)
+            {
+                scoped.run([&]() -> void {
+                    taco::SleepFor(std::chrono::milliseconds(5));
+                    slow++;
+                });
+            }
+        }
+        BASIS_TEST_VERIFY(slow == 8);
+    });
+    taco::Shutdown();
+}
+
+// Children add more children to the group they belong to while it is being waited on
+void test_nested_run()
+{
+    taco::Initialize([]() -> void {
+        std::atomic<uint32_t> count(0);
+        taco::task_group group(taco::task_priority::high);
+        std::function<void(uint32_t)> spread = [&](uint32_t depth) -> void {
+            count++;
+            if (depth > 0)
+            {
+                group.run([&, depth]() -> void { spread(depth - 1); });
+                group.run([&, depth]() -> void { spread(depth - 1); });
+            }
+        };
+        group.run([&]() -> void { spread(12); });
+        group.wait();
+        BASIS_TEST_VERIFY_MSG(count == (1u << 13) - 1, "%u of %u children ran", count.load(), (1u << 13) - 1);
+    });
+    taco::Shutdown();
+}
+
+int main()
+{
+    BASIS_RUN_TESTS();
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include <basis/unit_test.h>
+#include <taco/taco.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+typedef std::chrono::steady_clock clock_type;
+
+void test_sleep_for();
+void test_many_sleepers();
+void test_sleep_does_not_block();
+void test_event_timeout();
+void test_condition_timeout();
+
+BASIS_TEST_LIST_BEGIN()
+    BASIS_DECLARE_TEST(test_sleep_for)
+    BASIS_DECLARE_TEST(test_many_sleepers)
+    BASIS_DECLARE_TEST(test_sleep_does_not_block)
+    BASIS_DECLARE_TEST(test_event_timeout)
+    BASIS_DECLARE_TEST(test_condition_timeout)
+BASIS_TEST_LIST_END()
+
+void test_sleep_for()
+{
+    // Spans several levels of the wheel, a sleep must never come back early
+    static const int64_t durations[] = { 0, 1, 7, 65, 450, 4200, 30000, 300000 };
+
+    taco::Initialize([]() -> void {
+        std::vector<taco::future<int64_t>> sleeps;
+        for (int64_t us : durations)
+        {
+            sleeps.push_back(taco::Start([=]() -> int64_t {
+                auto start = clock_type::now();
+                taco::SleepFor(std::chrono::microseconds(us));
+                return std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start).count();
+            }));
+        }
+
+        for (size_t i=0; i<sleeps.size(); i++)
+        {
+            int64_t slept = sleeps[i];
+            BASIS_TEST_VERIFY_MSG(slept >= durations[i], "Asked to sleep for %lldus, slept for %lldus",
+                (long long)durations[i], (long long)slept);
+        }
+    });
+    taco::Shutdown();
+}
+
+void test_many_sleepers()
+{
+    static const uint32_t num_tasks = 10000;
+
+    taco::Initialize([]() -> void {
+        std::atomic<uint32_t> early(0);
+        std::atomic<uint32_t> woken(0);
+        taco::event done;
+
+        for (uint32_t i=0; i<num_tasks; i++)
+        {
+            taco::Schedule([&, i]() -> void {
+                auto until = clock_type::now() + std::chrono::microseconds((i * 7919) % 50000);
+                taco::SleepUntil(until);
+                if (clock_type::now() < until)
+                {
+                    early++;
+                }
+                if (++woken == num_tasks)
+                {
+                    done.signal();
+                }
+            });
+        }
+
+        done.wait();
+        BASIS_TEST_VERIFY_MSG(early == 0, "%u of %u sleepers woke up early", early.load(), num_tasks);
+    });
+    taco::Shutdown();
+}
+
+void test_sleep_does_not_block()
+{
+    // With one scheduler, other tasks only get to run if sleeping gives up the thread
+    taco::scheduler_options options;
+    options.thread_count = 1;
+
+    taco::Initialize([]() -> void {
+        std::atomic<bool> sleeping(true);
+        uint32_t ran = 0;
+
+        auto sleeper = taco::Start([&]() -> void {
+            taco::SleepFor(std::chrono::milliseconds(20));
+            sleeping = false;
+        });
+
+        while (sleeping)
+        {
+            ran++;
+            taco::Switch();
+        }
+        sleeper.await();
+        BASIS_TEST_VERIFY_MSG(ran > 0, "Nothing ran while the task slept");
+    }, options);
+    taco::Shutdown();
+}
+
+void test_event_timeout()
+{
+    taco::Initialize([]() -> void {
+        taco::event never;
+        auto start = clock_type::now();
+        bool signaled = never.wait_for(std::chrono::milliseconds(5));
+        BASIS_TEST_VERIFY_MSG(!signaled, "Expected wait on an unsignaled event to time out");
+        BASIS_TEST_VERIFY(clock_type::now() - start >= std::chrono::milliseconds(5));
+
+        taco::event soon;
+        taco::Schedule([&]() -> void {
+            taco::SleepFor(std::chrono::milliseconds(1));
+            soon.signal();
+        });
+        signaled = soon.wait_for(std::chrono::seconds(10));
+        BASIS_TEST_VERIFY_MSG(signaled, "Expected wait to see the signal");
+
+        // Timeouts racing the signal, every waiter must come back exactly once either way
+        static const uint32_t num_waiters = 1000;
+        taco::event racing;
+        std::atomic<uint32_t> returned(0);
+        std::vector<taco::future<bool>> waits;
+        for (uint32_t i=0; i<num_waiters; i++)
+        {
+            waits.push_back(taco::Start([&, i]() -> bool {
+                bool result = racing.wait_for(std::chrono::microseconds(i * 4));
+                returned++;
+                return result;
+            }));
+        }
+        taco::SleepFor(std::chrono::milliseconds(2));
+        racing.signal();
+
+        for (taco::future<bool> & wait : waits)
+        {
+            wait.await();
+        }
+        BASIS_TEST_VERIFY_MSG(returned == num_waiters, "%u of %u waits returned", returned.load(), num_waiters);
+        BASIS_TEST_VERIFY(racing.wait_for(std::chrono::seconds(0)));
+    });
+    taco::Shutdown();
+}
+
+void test_condition_timeout()
+{
+    taco::Initialize([]() -> void {
+        taco::mutex mutex;
+        taco::condition condition;
+        bool ready = false;
+
+        {
+            std::unique_lock<taco::mutex> lock(mutex);
+            std::cv_status status = condition.wait_for(lock, std::chrono::milliseconds(5));
+            BASIS_TEST_VERIFY_MSG(status == std::cv_status::timeout, "Expected wait without a notify to time out");
+        }
+
+        taco::Schedule([&]() -> void {
+            taco::SleepFor(std::chrono::milliseconds(1));
+            std::unique_lock<taco::mutex> lock(mutex);
+            ready = true;
+            condition.notify_one();
+        });
+
+        std::unique_lock<taco::mutex> lock(mutex);
+        auto until = clock_type::now() + std::chrono::seconds(10);
+        while (!ready && condition.wait_until(lock, until) == std::cv_status::no_timeout)
+        {
+        }
+        BASIS_TEST_VERIFY_MSG(ready, "Expected to be notified before the timeout");
+    });
+    taco::Shutdown();
+}
+
+int main()
+{
+    BASIS_RUN_TESTS();
+    return 0;
+}
@@ -1,14 +1,30 @@
 #include <time.h>
+#include <memory>
+#include <vector>
 #include <basis/unit_test.h>
+#include <basis/timer.h>
 #include <taco/taco.h>
 #include "../src/work_queue.h"
+#include "../src/availability_mask.h"
 
 #define TEST_TIMEOUT_MS 2000
 
 void test_work_queue();
+void test_work_deque();
+void test_work_deque_stress();
+void test_work_deque_steal_half();
+void test_work_deque_throughput();
+void test_availability_mask();
+void test_availability_contention();
 
 BASIS_TEST_LIST_BEGIN()
     BASIS_DECLARE_TEST(test_work_queue)
+    BASIS_DECLARE_TEST(test_work_deque)
+    BASIS_DECLARE_TEST(test_work_deque_stress)
+    BASIS_DECLARE_TEST(test_work_deque_steal_half)
+    BASIS_DECLARE_TEST(test_work_deque_throughput)
+    BASIS_DECLARE_TEST(test_availability_mask)
+    BASIS_DECLARE_TEST(test_availability_contention)
 BASIS_TEST_LIST_END()
 
 void test_work_queue()
@@ -89,6 +105,313 @@ void test_work_queue()
     }
 }
 
+void test_work_deque()
+{
+    srand(time(NULL));
+
+    constexpr uint32_t num_items = 1037;
+    constexpr uint32_t num_threads = 8;
+    constexpr uint32_t target_value = 16;
+
+    uint32_t items[num_items] = {};
+
+    std::atomic<uint32_t> total_completed = 0;
+    std::unique_ptr<taco::work_deque<uint32_t *>> queue[num_threads];
+
+    // Start tiny so the deques have to grow while other threads are stealing from them
+    for (uint32_t i=0; i<num_threads; i++)
+    {
+        queue[i].reset(new taco::work_deque<uint32_t *>(4));
+    }
+
+    for (uint32_t i=0; i<num_items; i++)
+    {
+        queue[0]->push(items + i);
+    }
+
+    std::thread thr[num_threads];
+    for (uint32_t i=0; i<num_threads; i++)
+    {
+        thr[i] = std::thread([&, i]() -> void {
+            while (total_completed < num_items) 
+            {
+                uint32_t * ptr = nullptr;
+                bool try_steal = !!(rand() & 1);
+
+                if (try_steal || !queue[i]->pop(ptr))
+                {
+                    uint32_t index = rand() % num_threads;
+                    if ((index == i) || !queue[index]->steal(ptr)) 
+                    {
+                        continue;
+                    }
+                }
+
+                // Same scheme as test_work_queue - an item handed out twice will
+                // eventually trip over the flag bit and fail the check below
+                uint32_t val = ++(*ptr);
+                if (val < target_value) 
+                {
+                    ptr[0] |= 0x80000000;
+                    std::this_thread::yield();
+                    ptr[0] ^= 0x80000000;
+                    queue[i]->push(ptr);
+                } 
+                else
+                {
+                    BASIS_TEST_VERIFY_MSG(val == target_value, 
+                        "Thread %u: Unexpected value %u", i, val);
+                    total_completed++;
+                }
+            }
+        });
+    }
+
+    for (uint32_t i=0; i<num_threads; i++)
+    {
+        thr[i].join();
+    }
+
+    for (uint32_t i=0; i<num_items; i++)
+    {
+        BASIS_TEST_VERIFY_MSG(items[i] == target_value, "Item %u: Unexpected value %u", i, items[i]);
+    }
+}
+
+// One owner pushing (and occasionally popping) while every other thread steals.
+// Every item must be claimed exactly once.
+static uint64_t run_deque_owner_vs_thieves(uint32_t num_threads, uint32_t num_items, uint64_t & stolen, uint32_t batch = 1)
+{
+    std::vector<std::atomic<uint32_t>> claims(num_items);
+    for (auto & c : claims)
+    {
+        c = 0;
+    }
+
+    taco::work_deque<std::atomic<uint32_t> *> queue(16);
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> steal_count(0);
+
+    auto start = basis::GetTimestamp();
+
+    std::vector<std::thread> thieves;
+    for (uint32_t i=1; i<num_threads; i++)
+    {
+        thieves.emplace_back([&]() -> void {
+            uint64_t count = 0;
+            std::vector<std::atomic<uint32_t> *> items(batch);
+            for (;;)
+            {
+                bool was_done = done;
+                int64_t n = (batch > 1) ? queue.steal_half(items.data(), batch) : int64_t(queue.steal(items[0]));
+                for (int64_t j=0; j<n; j++)
+                {
+                    items[j]->fetch_add(1);
+                }
+                count += n;
+
+                // once the owner has drained the deque a failed steal means it is empty
+                if (n == 0 && was_done)
+                {
+                    break;
+                }
+            }
+            steal_count += count;
+        });
+    }
+
+    std::atomic<uint32_t> * ptr = nullptr;
+    for (uint32_t i=0; i<num_items; i++)
+    {
+        queue.push(&claims[i]);
+        if ((i % 3) == 0 && queue.pop(ptr))
+        {
+            ptr->fetch_add(1);
+        }
+    }
+    while (queue.size() > 0)
+    {
+        if (queue.pop(ptr))
+        {
+            ptr->fetch_add(1);
+        }
+    }
+    done = true;
+
+    for (auto & t : thieves)
+    {
+        t.join();
+    }
+
+    auto elapsed = basis::GetTimeDeltaMS(start, basis::GetTimestamp());
+
+    uint32_t bad = 0;
+    for (uint32_t i=0; i<num_items; i++)
+    {
+        bad += (claims[i] != 1) ? 1 : 0;
+    }
+    BASIS_TEST_VERIFY_MSG(bad == 0, "%u threads: %u of %u items not claimed exactly once", 
+        num_threads, bad, num_items);
+
+    stolen = steal_count;
+    return elapsed;
+}
+
+void test_work_deque_stress()
+{
+    for (uint32_t threads=1; threads<=64; threads*=2)
+    {
+        for (uint32_t pass=0; pass<4; pass++)
+        {
+            uint64_t stolen = 0;
+            run_deque_owner_vs_thieves(threads, 1 << 14, stolen);
+        }
+    }
+}
+
+void test_work_deque_steal_half()
+{
+    for (uint32_t threads=2; threads<=64; threads*=2)
+    {
+        for (uint32_t pass=0; pass<4; pass++)
+        {
+            uint64_t stolen = 0;
+            run_deque_owner_vs_thieves(threads, 1 << 14, stolen, 16);
+        }
+    }
+}
+
+void test_work_deque_throughput()
+{
+    constexpr uint32_t num_items = 1 << 20;
+
+    printf("Threads\tBatch\tItems\tms\tstolen\n");
+    for (uint32_t batch=1; batch<=16; batch*=16)
+    {
+        for (uint32_t threads=1; threads<=64; threads*=2)
+        {
+            uint64_t stolen = 0;
+            uint64_t ms = run_deque_owner_vs_thieves(threads, num_items, stolen, batch);
+            printf("%u\t%u\t%u\t%llu\t%llu\n", threads, batch, num_items, (unsigned long long) ms, (unsigned long long) stolen);
+        }
+    }
+}
+
+void test_availability_mask()
+{
+    taco::availability_mask mask(130);
+    taco::work_deque<uint32_t> queue(16);
+    auto is_empty = [&]() -> bool { return queue.size() == 0; };
+
+    BASIS_TEST_VERIFY(!mask.any());
+
+    queue.push(1);
+    mask.mark(129);
+    BASIS_TEST_VERIFY(mask.test(129) && !mask.test(1) && mask.any());
+
+    // still has an item, so clearing must leave the bit set
+    mask.clear(129, is_empty);
+    BASIS_TEST_VERIFY(mask.test(129));
+
+    uint32_t item = 0;
+    queue.pop(item);
+    mask.clear(129, is_empty);
+    BASIS_TEST_VERIFY(!mask.test(129) && !mask.any());
+}
+
+// Each thread repeatedly pushes an item to its own deque, checks whether there is work
+// anywhere and pops the item back off, every so often probing a neighbour like an idle
+// thief would. Tracked either with one shared count or with an availability_mask.
+static uint64_t run_availability_contention(uint32_t num_threads, uint32_t iterations, bool use_mask)
+{
+    std::vector<std::unique_ptr<taco::work_deque<uint32_t>>> queues;
+    for (uint32_t i=0; i<num_threads; i++)
+    {
+        queues.emplace_back(new taco::work_deque<uint32_t>(16));
+    }
+
+    taco::availability_mask mask(num_threads);
+    std::atomic<uint32_t> count(0);
+    std::atomic<uint32_t> ready(0);
+    std::atomic<uint64_t> found(0);
+
+    auto start = basis::GetTimestamp();
+
+    std::vector<std::thread> threads;
+    for (uint32_t t=0; t<num_threads; t++)
+    {
+        threads.emplace_back([&, t]() -> void {
+            taco::work_deque<uint32_t> & queue = *queues[t];
+            uint64_t local_found = 0;
+            uint32_t item = 0;
+
+            ready++;
+            while (ready < num_threads);
+
+            for (uint32_t i=0; i<iterations; i++)
+            {
+                queue.push(i);
+                if (use_mask)
+                {
+                    mask.mark(t);
+                    local_found += mask.any() ? 1 : 0;
+                    if (queue.pop(item))
+                    {
+                        local_found += item & 1;
+                    }
+                }
+                else
+                {
+                    count.fetch_add(1, std::memory_order_relaxed);
+                    local_found += (count.load(std::memory_order_relaxed) > 0) ? 1 : 0;
+                    if (queue.pop(item))
+                    {
+                        count.fetch_sub(1, std::memory_order_relaxed);
+                        local_found += item & 1;
+                    }
+                }
+
+                if ((i & 15) == 0 && num_threads > 1)
+                {
+                    uint32_t victim = (t + 1 + (i >> 4) % (num_threads - 1)) % num_threads;
+                    if (use_mask)
+                    {
+                        if (mask.test(victim) && !queues[victim]->steal(item))
+                        {
+                            mask.clear(victim, [&]() -> bool { return queues[victim]->size() == 0; });
+                        }
+                    }
+                    else if (count.load(std::memory_order_relaxed) > 0 && queues[victim]->steal(item))
+                    {
+                        count.fetch_sub(1, std::memory_order_relaxed);
+                    }
+                }
+            }
+            found += local_found;
+        });
+    }
+
+    for (auto & t : threads)
+    {
+        t.join();
+    }
+
+    return basis::GetTimeDeltaMS(start, basis::GetTimestamp());
+}
+
+void test_availability_contention()
+{
+    constexpr uint32_t iterations = 1 << 20;
+
+    printf("Threads\tIterations\tcount ms\tmask ms\n");
+    for (uint32_t threads=1; threads<=64; threads*=2)
+    {
+        uint64_t count_ms = run_availability_contention(threads, iterations, false);
+        uint64_t mask_ms = run_availability_contention(threads, iterations, true);
+        printf("%u\t%u\t\t%llu\t\t%llu\n", threads, iterations, (unsigned long long) count_ms, (unsigned long long) mask_ms);
+    }
+}
+
 int main(int argc, char ** argv)
 {
     BASIS_RUN_TESTS();